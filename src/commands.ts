@@ -0,0 +1,81 @@
+import {
+  BodyCommandType,
+  COMMAND_HEADER_WORDS,
+  COMMAND_STRIDE,
+  type PhysicsWorldInstance,
+} from "./types";
+
+const HEAD = 0;
+const TAIL = 1;
+
+// Writes per-body edits into the world's command ring, so a frame's worth of input
+// crosses into WASM as one pass at the start of the next step instead of one call per
+// edit. Bodies are addressed by handle.
+export class CommandWriter {
+  private words = new Uint32Array(0);
+  private floats = new Float32Array(0);
+  private capacity = 0;
+
+  constructor(private world: PhysicsWorldInstance) {}
+
+  force(handle: number, x: number, y: number, z: number) {
+    this.push(BodyCommandType.Force, handle, x, y, z);
+  }
+
+  impulse(handle: number, x: number, y: number, z: number) {
+    this.push(BodyCommandType.Impulse, handle, x, y, z);
+  }
+
+  torque(handle: number, x: number, y: number, z: number) {
+    this.push(BodyCommandType.Torque, handle, x, y, z);
+  }
+
+  velocity(handle: number, x: number, y: number, z: number) {
+    this.push(BodyCommandType.Velocity, handle, x, y, z);
+  }
+
+  angularVelocity(handle: number, x: number, y: number, z: number) {
+    this.push(BodyCommandType.AngularVelocity, handle, x, y, z);
+  }
+
+  friction(handle: number, friction: number) {
+    this.push(BodyCommandType.Friction, handle, friction);
+  }
+
+  restitution(handle: number, restitution: number) {
+    this.push(BodyCommandType.Restitution, handle, restitution);
+  }
+
+  wake(handle: number) {
+    this.push(BodyCommandType.Wake, handle);
+  }
+
+  sleep(handle: number) {
+    this.push(BodyCommandType.Sleep, handle);
+  }
+
+  push(type: BodyCommandType, handle: number, x = 0, y = 0, z = 0) {
+    // Heap growth detaches the view; setCommandCapacity replaces the ring
+    if (this.words.length === 0 || this.words[2] !== this.capacity) this.attach();
+    const head = this.words[HEAD];
+    if (((head - this.words[TAIL]) >>> 0) >= this.capacity) {
+      // Full: have the engine apply what is queued, then carry on
+      this.world.applyCommands();
+      this.attach();
+    }
+    const at = COMMAND_HEADER_WORDS + (head % this.capacity) * COMMAND_STRIDE;
+    this.words[at] = type;
+    this.words[at + 1] = handle;
+    this.floats[at + 2] = x;
+    this.floats[at + 3] = y;
+    this.floats[at + 4] = z;
+    this.words[HEAD] = (head + 1) >>> 0;
+  }
+
+  private attach() {
+    const ring = this.world.getCommandRing();
+    this.words = ring;
+    this.floats = new Float32Array(ring.buffer, ring.byteOffset, ring.length);
+    this.capacity = ring[2];
+  }
+}
@@ -19,16 +19,32 @@ export const MouseHandler = ({ worldRef }: { worldRef: React.MutableRefObject<Ph
             mouse.current.y = -((e.clientY - rect.top) / rect.height) * 2 + 1;
 
             raycaster.current.setFromCamera(mouse.current, camera);
-            const intersects = raycaster.current.intersectObjects(scene.children, true);
 
+            const startDrag = (id: number, point: THREE.Vector3) => {
+                draggedObject.current = id;
+                const normal = new THREE.Vector3();
+                camera.getWorldDirection(normal);
+                dragPlane.current.setFromNormalAndCoplanarPoint(normal, point);
+                // eslint-disable-next-line @typescript-eslint/no-explicit-any
+                if ((scene as any).userData.controls) (scene as any).userData.controls.enabled = false;
+            };
+
+            // Pick against the physics shapes when the world supports scene queries
+            const world = worldRef.current;
+            if (world && world.raycast) {
+                const { origin, direction } = raycaster.current.ray;
+                const hit = world.raycast(origin.x, origin.y, origin.z, direction.x, direction.y, direction.z, 1000);
+                if (hit) {
+                    const index = world.getBodyIndex(hit.handle);
+                    if (index >= 0) startDrag(index, new THREE.Vector3(hit.point.x, hit.point.y, hit.point.z));
+                }
+                return;
+            }
+
+            const intersects = raycaster.current.intersectObjects(scene.children, true);
             for (const hit of intersects) {
                 if (hit.object.userData.physicsId !== undefined) {
-                    draggedObject.current = hit.object.userData.physicsId;
-                    const normal = new THREE.Vector3();
-                    camera.getWorldDirection(normal);
-                    dragPlane.current.setFromNormalAndCoplanarPoint(normal, hit.point);
-                    // eslint-disable-next-line @typescript-eslint/no-explicit-any
-                    if ((scene as any).userData.controls) (scene as any).userData.controls.enabled = false;
+                    startDrag(hit.object.userData.physicsId, hit.point);
                     break;
                 }
             }
@@ -57,7 +73,7 @@ export const MouseHandler = ({ worldRef }: { worldRef: React.MutableRefObject<Ph
             window.removeEventListener('mouseup', handleUp);
             window.removeEventListener('mousemove', handleMove);
         };
-    }, [camera, scene, gl]);
+    }, [camera, scene, gl, worldRef]);
 
     useFrame(() => {
         if (draggedObject.current !== null && worldRef.current) {
@@ -1,8 +1,8 @@
-import { forwardRef, useImperativeHandle, useRef, useEffect, useState } from "react";
+import { forwardRef, useImperativeHandle, useRef, useEffect, useMemo, useState } from "react";
 import { useFrame, useThree } from "@react-three/fiber";
 import { Sphere, Box, Cylinder, Plane, OrbitControls, useTexture, Grid } from "@react-three/drei";
 import * as THREE from "three";
-import { TEXTURES, type PhysicsWorldInstance, type SimulationObject, type TextureType, type ShapeType, type InputMode, type PhysicsModule } from "../types";
+import { TEXTURES, DEBUG_VERTEX_STRIDE, DebugDrawFlag, type PhysicsWorldInstance, type SimulationObject, type TextureType, type ShapeType, type InputMode, type PhysicsModule } from "../types";
 import { GamepadHandler } from "./GamepadHandler";
 import { KeyboardHandler } from "./KeyboardHandler";
 import { MouseHandler } from "./MouseHandler";
@@ -23,6 +23,10 @@ interface PhysicsSceneProps {
     gridColor: string;
 }
 
+// Everything the engine can draw, shown while debugMode is on
+const DEBUG_DRAW_FLAGS =
+    DebugDrawFlag.Contacts | DebugDrawFlag.Aabbs | DebugDrawFlag.Constraints | DebugDrawFlag.Islands;
+
 export interface PhysicsSceneRef {
     spawn: (type?: ShapeType) => void;
 }
@@ -48,6 +52,15 @@ export const PhysicsScene = forwardRef<PhysicsSceneRef, PhysicsSceneProps>(({
     const maps = useTexture(TEXTURES);
     const [orbitEnabled, setOrbitEnabled] = useState(true);
 
+    // Engine debug geometry: lines and points read the same interleaved buffer through two
+    // draw ranges. The buffer only grows, by replacing the geometries.
+    const debugLines = useMemo(() => new THREE.LineSegments(
+        new THREE.BufferGeometry(), new THREE.LineBasicMaterial({ vertexColors: true })), []);
+    const debugPoints = useMemo(() => new THREE.Points(
+        new THREE.BufferGeometry(),
+        new THREE.PointsMaterial({ vertexColors: true, size: 5, sizeAttenuation: false })), []);
+    const debugBuffer = useRef<THREE.InterleavedBuffer | null>(null);
+
     const performSpawn = (type?: ShapeType) => {
         const shapeType = type || selectedShape;
         
@@ -85,6 +98,45 @@ export const PhysicsScene = forwardRef<PhysicsSceneRef, PhysicsSceneProps>(({
         }
     }, [gravity, restitution, friction]);
 
+    useEffect(() => {
+        worldRef.current?.setDebugDrawFlags(debugMode ? DEBUG_DRAW_FLAGS : 0);
+    }, [debugMode, physicsModule]);
+
+    useEffect(() => () => {
+        for (const object of [debugLines, debugPoints]) {
+            object.geometry.dispose();
+            object.material.dispose();
+        }
+    }, [debugLines, debugPoints]);
+
+    const uploadDebugGeometry = (world: PhysicsWorldInstance) => {
+        const lineCount = world.getDebugLineVertexCount();
+        const pointCount = world.getDebugPointCount();
+        // View into the WASM heap; copied once into the GPU-side buffer below
+        const vertices = world.getDebugVertices();
+        let buffer = debugBuffer.current;
+        if (!buffer || buffer.array.length < vertices.length) {
+            const capacity = Math.max(vertices.length, 2 * (buffer?.array.length ?? 0), 4096);
+            buffer = new THREE.InterleavedBuffer(new Float32Array(capacity), DEBUG_VERTEX_STRIDE);
+            buffer.setUsage(THREE.DynamicDrawUsage);
+            for (const object of [debugLines, debugPoints]) {
+                object.geometry.dispose();
+                object.geometry = new THREE.BufferGeometry();
+                object.geometry.setAttribute('position', new THREE.InterleavedBufferAttribute(buffer, 3, 0));
+                object.geometry.setAttribute('color', new THREE.InterleavedBufferAttribute(buffer, 3, 3));
+                // Bounds change every frame
+                object.frustumCulled = false;
+            }
+            debugBuffer.current = buffer;
+        }
+        (buffer.array as Float32Array).set(vertices);
+        buffer.clearUpdateRanges();
+        buffer.addUpdateRange(0, vertices.length);
+        buffer.needsUpdate = true;
+        debugLines.geometry.setDrawRange(0, lineCount);
+        debugPoints.geometry.setDrawRange(lineCount, pointCount);
+    };
+
     useEffect(() => {
         if (!worldRef.current) return;
         const world = worldRef.current;
@@ -133,6 +185,8 @@ export const PhysicsScene = forwardRef<PhysicsSceneRef, PhysicsSceneProps>(({
                 if (bodyData.rot) mesh.quaternion.set(bodyData.rot.x, bodyData.rot.y, bodyData.rot.z, bodyData.rot.w);
             }
         }
+
+        if (debugMode) uploadDebugGeometry(worldRef.current);
     });
 
     return (
@@ -187,6 +241,13 @@ export const PhysicsScene = forwardRef<PhysicsSceneRef, PhysicsSceneProps>(({
                 }
             })}
 
+            {debugMode && (
+                <>
+                    <primitive object={debugLines} />
+                    <primitive object={debugPoints} />
+                </>
+            )}
+
             {/* Shadow-receiving infinite floor */}
             <Plane args={[50000, 50000]} rotation={[-Math.PI / 2, 0, 0]} receiveShadow position={[0, -0.01, 0]}>
                 <meshStandardMaterial color={planeColor} roughness={0.8} />
@@ -0,0 +1,292 @@
+// Native benchmark for the physics core. Build and run with `make bench`.
+//
+// Spawns a large scene in shuffled order (so storage order has nothing to do with
+// position, as after minutes of play) and times step() with and without Morton-order
+// storage sorting, then times granular particle pits, a batch of small worlds
+// stepped on one thread and on all cores, and building a large level through the add
+// calls against loading it from a saved scene file. On Linux, hardware cache counters
+// are read through perf_event_open; where they are unavailable (containers,
+// perf_event_paranoid > 2) only timings print.
+#include "core/PhysicsWorld.h"
+#include "core/WorldBatch.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfCounter
+{
+public:
+    PerfCounter(uint32_t type, uint64_t config)
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        (void)type;
+        (void)config;
+#endif
+    }
+
+    ~PerfCounter()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    bool valid() const { return fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd < 0)
+            return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    uint64_t stop()
+    {
+        uint64_t value = 0;
+#ifdef __linux__
+        if (fd < 0)
+            return 0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &value, sizeof(value)) != sizeof(value))
+            value = 0;
+#endif
+        return value;
+    }
+
+private:
+    int fd = -1;
+};
+
+struct Result
+{
+    double msPerStep;
+    uint64_t cacheMisses;
+    uint64_t cacheReferences;
+    uint64_t l1Misses;
+};
+
+static void populate(PhysicsWorld& world, int count, unsigned seed)
+{
+    // A wide field of debris two layers deep, spawned in random order
+    int side = (int)std::ceil(std::sqrt(count / 2.0));
+    std::vector<int> cells(count);
+    for (int i = 0; i < count; i++)
+        cells[i] = i;
+    std::mt19937 rng(seed);
+    std::shuffle(cells.begin(), cells.end(), rng);
+
+    for (int cell : cells)
+    {
+        float x = (float)(cell % side) * 1.5f;
+        float z = (float)((cell / side) % side) * 1.5f;
+        float y = 0.6f + (float)(cell / (side * side)) * 1.2f;
+        if (cell % 3 == 0)
+            world.addBox(x, y, z, 1.0f, 1.0f, 1.0f, 1.0f);
+        else if (cell % 3 == 1)
+            world.addSphere(x, y, z, 0.5f, 1.0f);
+        else
+            world.addCylinder(x, y, z, 0.5f, 1.0f, 1.0f);
+    }
+}
+
+static Result run(int count, bool spatialSort, int warmup, int frames)
+{
+    PhysicsWorld world;
+    populate(world, count, 1234);
+    world.setSpatialSortEnabled(spatialSort);
+    // One pass settles in a few frames of the warm-up
+    world.setSpatialSortRate(120, 2048);
+
+    const float dt = 1.0f / 60.0f;
+    for (int i = 0; i < warmup; i++)
+        world.step(dt);
+
+    PerfCounter misses(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    PerfCounter references(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    PerfCounter l1(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+    misses.start();
+    references.start();
+    l1.start();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        world.step(dt);
+    auto end = std::chrono::steady_clock::now();
+    Result r;
+    r.l1Misses = l1.stop();
+    r.cacheReferences = references.stop();
+    r.cacheMisses = misses.stop();
+    r.msPerStep = std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+    return r;
+}
+
+// Grains settled in a walled pit about 0.3 m deep, with a few bodies resting on them
+static Result runParticles(int count, int warmup, int frames)
+{
+    PhysicsWorld world;
+    float width = std::sqrt(count * 0.001f / 0.3f);
+    int side = (int)(width / 0.1f);
+    world.addBox(-0.2f, 1.0f, width / 2, 0.4f, 2.0f, width + 0.8f, 0.0f);
+    world.addBox(width + 0.2f, 1.0f, width / 2, 0.4f, 2.0f, width + 0.8f, 0.0f);
+    world.addBox(width / 2, 1.0f, -0.2f, width + 0.8f, 2.0f, 0.4f, 0.0f);
+    world.addBox(width / 2, 1.0f, width + 0.2f, width + 0.8f, 2.0f, 0.4f, 0.0f);
+    world.addParticleBlock(0.05f, 0.05f, 0.05f, side, (count + side * side - 1) / (side * side),
+                           side, 0.1f);
+    for (int i = 0; i < 4; i++)
+        world.addSphere(width * (0.2f + 0.2f * i), 2.0f, width / 2, 0.3f, 1.0f);
+
+    const float dt = 1.0f / 60.0f;
+    for (int i = 0; i < warmup; i++)
+        world.step(dt);
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        world.step(dt);
+    auto end = std::chrono::steady_clock::now();
+    Result r = {};
+    r.msPerStep = std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+    return r;
+}
+
+// Many copies of a small scene, stepped together; ms per step of the whole batch
+static Result runBatch(int worlds, int bodies, int threads, int frames)
+{
+    WorldBatch batch(threads);
+    populate(*batch.getSeed(), bodies, 1234);
+    batch.clone(worlds);
+
+    const float dt = 1.0f / 60.0f;
+    batch.step(dt, 30);
+    auto begin = std::chrono::steady_clock::now();
+    batch.step(dt, frames);
+    auto end = std::chrono::steady_clock::now();
+    Result r = {};
+    r.msPerStep = std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+    return r;
+}
+
+static double msSince(std::chrono::steady_clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+        .count();
+}
+
+// A level built body by body, saved, and loaded back from the file: mapped and used in
+// place where mmap is available, else from memory
+static void runScene(int count)
+{
+    auto begin = std::chrono::steady_clock::now();
+    PhysicsWorld built;
+    populate(built, count, 1234);
+    double buildMs = msSince(begin);
+    const std::vector<uint8_t>& file = built.saveSceneData();
+
+    PhysicsWorld loaded;
+    double loadMs = 0.0;
+    int bodies = -1;
+#ifdef __linux__
+    char path[] = "/tmp/physics_scene_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0 && write(fd, file.data(), file.size()) == (ssize_t)file.size())
+    {
+        begin = std::chrono::steady_clock::now();
+        void* mapped = mmap(nullptr, file.size(), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED)
+        {
+            bodies = loaded.loadSceneData((const uint8_t*)mapped, file.size(), false);
+            loadMs = msSince(begin);
+            // Primitive shapes only, so nothing borrows from the mapping
+            munmap(mapped, file.size());
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(path);
+    }
+#endif
+    if (bodies < 0)
+    {
+        begin = std::chrono::steady_clock::now();
+        bodies = loaded.loadSceneData(file.data(), file.size(), false);
+        loadMs = msSince(begin);
+    }
+    std::printf("  add calls  %8.3f ms\n", buildMs);
+    std::printf("  scene file %8.3f ms  (%d bodies, %.1f MB)\n", loadMs, bodies,
+                file.size() / 1e6);
+}
+
+static void print(const char* label, const Result& r, int frames, bool counters)
+{
+    std::printf("  %-10s %8.3f ms/step", label, r.msPerStep);
+    if (counters)
+    {
+        std::printf("  LLC misses/step %10.0f  refs/step %10.0f  L1D read misses/step %10.0f",
+                    (double)r.cacheMisses / frames, (double)r.cacheReferences / frames,
+                    (double)r.l1Misses / frames);
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    int frames = argc > 1 ? std::atoi(argv[1]) : 120;
+    const int warmup = 150;
+    const int counts[] = {500, 2000, 8000};
+
+    bool counters = PerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES).valid();
+    if (!counters)
+        std::printf("hardware cache counters unavailable; reporting timings only\n");
+
+    for (int count : counts)
+    {
+        std::printf("%d bodies, %d frames\n", count, frames);
+        print("spawn", run(count, false, warmup, frames), frames, counters);
+        print("morton", run(count, true, warmup, frames), frames, counters);
+    }
+
+    const int particleCounts[] = {25000, 100000};
+    for (int count : particleCounts)
+    {
+        std::printf("%d particles, %d frames\n", count, frames);
+        print("pit", runParticles(count, warmup, frames), frames, false);
+    }
+
+    const int worlds = 256, bodiesPerWorld = 50;
+    std::printf("%d worlds of %d bodies, %d frames\n", worlds, bodiesPerWorld, frames);
+    print("1 thread", runBatch(worlds, bodiesPerWorld, 1, frames), frames, false);
+    print("all cores", runBatch(worlds, bodiesPerWorld, 0, frames), frames, false);
+
+    const int sceneBodies = 50000;
+    std::printf("%d-body level\n", sceneBodies);
+    runScene(sceneBodies);
+    return 0;
+}
@@ -0,0 +1,62 @@
+// Checks the sensor event stream over a sensor's whole life. Build and run with
+// `make sensor-check`; it prints one line per case and exits non-zero on the first failure.
+//
+// A ball rests inside a static sensor box. The sensor then goes away, by removal or by
+// turning back into a normal body: the next step must report one EXIT for the pair, and
+// every step after it must report nothing, even though the sensor pass no longer runs.
+#include "core/PhysicsWorld.h"
+#include <cstdio>
+
+static bool check(const char* name, bool remove)
+{
+    PhysicsWorld world;
+    uint32_t sensor = world.addBox(0.0f, 1.0f, 0.0f, 4.0f, 2.0f, 4.0f, 0.0f);
+    world.setBodySensor(sensor, true);
+    uint32_t ball = world.addSphere(0.0f, 0.5f, 0.0f, 0.5f, 1.0f);
+
+    world.step(1.0f / 60.0f);
+    const SensorEvent* enter = world.getSensorEventData();
+    if (world.getSensorEventCount() != 1 || enter[0].type != SENSOR_ENTER ||
+        enter[0].sensor != sensor || enter[0].body != ball)
+    {
+        std::printf("%s: no ENTER on the first step\n", name);
+        return false;
+    }
+    for (int i = 0; i < 10; i++)
+        world.step(1.0f / 60.0f);
+
+    if (remove)
+        world.removeBody(sensor);
+    else
+        world.setBodySensor(sensor, false);
+
+    world.step(1.0f / 60.0f);
+    const SensorEvent* exit = world.getSensorEventData();
+    if (world.getSensorEventCount() != 1 || exit[0].type != SENSOR_EXIT ||
+        exit[0].sensor != sensor || exit[0].body != ball)
+    {
+        std::printf("%s: no EXIT on the step after\n", name);
+        return false;
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        world.step(1.0f / 60.0f);
+        if (world.getSensorEventCount() != 0)
+        {
+            std::printf("%s: %d stale events %d steps after the EXIT\n", name,
+                        world.getSensorEventCount(), i + 1);
+            return false;
+        }
+    }
+    std::printf("%s: ok\n", name);
+    return true;
+}
+
+int main()
+{
+    if (!check("sensor removed", true))
+        return 1;
+    if (!check("sensor turned off", false))
+        return 1;
+    return 0;
+}
@@ -0,0 +1,200 @@
+// End-to-end check of the transform stream through a pipe or file. Build with
+// `make stream`, then
+//
+//   ./bench/physics_stream encode [frames] > stream.bin
+//   ./bench/physics_stream decode < stream.bin
+//
+// or `make stream-check`, which pipes one into the other and compares their output.
+//
+// The encoder runs a scene of falling, settling, removed and added bodies and writes one
+// length-prefixed packet per frame. Acknowledgements cannot travel back up a pipe, so it
+// assumes the viewer acknowledges every packet it receives ACK_DELAY frames later, and
+// drops every DROP_EVERY-th packet as lost. Both sides print one line per delivered frame
+// with a digest of the dequantized transforms: the encoder from its own quantization, the
+// decoder from the packets. Lines starting with '#' are statistics.
+#include "core/PhysicsWorld.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const int ACK_DELAY = 6;
+static const int DROP_EVERY = 7;
+
+static const float BOUND_MIN[3] = {-20.0f, -1.0f, -20.0f};
+static const float BOUND_MAX[3] = {20.0f, 30.0f, 20.0f};
+static const int POSITION_BITS = 16;
+
+// FNV-1a over [handle, px, py, pz, qw, qx, qy, qz] records in slot order
+static uint64_t digest(const float* states, size_t count)
+{
+    uint64_t h = 1469598103934665603ull;
+    const uint8_t* bytes = (const uint8_t*)states;
+    for (size_t i = 0; i < count * TransformDecoder::STATE_STRIDE * sizeof(float); i++)
+    {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static void spawn(PhysicsWorld& world, int i)
+{
+    float x = (float)(i % 10) * 1.3f - 6.0f;
+    float z = (float)((i / 10) % 10) * 1.3f - 6.0f;
+    float y = 1.0f + (float)(i / 100) * 1.5f;
+    if (i % 2 == 0)
+        world.addBox(x, y, z, 1.0f, 1.0f, 1.0f, 1.0f);
+    else
+        world.addSphere(x, y, z, 0.5f, 1.0f);
+}
+
+static int encode(int frames)
+{
+    PhysicsWorld world;
+    world.setStreamBounds(BOUND_MIN[0], BOUND_MIN[1], BOUND_MIN[2], BOUND_MAX[0], BOUND_MAX[1],
+                          BOUND_MAX[2], POSITION_BITS);
+    // Same bound, for the expected transforms
+    TransformEncoder grid;
+    grid.setBounds(AABB(Vector3(BOUND_MIN[0], BOUND_MIN[1], BOUND_MIN[2]),
+                        Vector3(BOUND_MAX[0], BOUND_MAX[1], BOUND_MAX[2])),
+                   POSITION_BITS);
+
+    int spawned = 0;
+    for (; spawned < 300; spawned++)
+        spawn(world, spawned);
+
+    std::vector<uint32_t> sequences;
+    std::vector<bool> delivered;
+    std::vector<float> expected;
+    size_t totalBytes = 0, rawBytes = 0;
+    int packets = 0;
+    float maxPositionError = 0.0f, maxAngleError = 0.0f;
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        // Churn: some bodies go, new ones arrive
+        if (frame % 90 == 45)
+        {
+            for (int k = 0; k < 10 && world.getBodyCount() > 0; k++)
+                world.removeBody(world.getBodyHandle((k * 37 + frame) % world.getBodyCount()));
+            for (int k = 0; k < 5; k++)
+                spawn(world, spawned++ % 300);
+        }
+        world.step(1.0f / 60.0f);
+        uint32_t sequence = world.captureTransforms();
+        sequences.push_back(sequence);
+        delivered.push_back(frame % DROP_EVERY != DROP_EVERY - 1);
+
+        // Newest delivered packet whose acknowledgement has arrived
+        uint32_t baseline = 0;
+        for (int f = frame - ACK_DELAY; f >= 0 && f > frame - TransformStream::HISTORY; f--)
+        {
+            if (delivered[f])
+            {
+                baseline = sequences[f];
+                break;
+            }
+        }
+        int size = world.encodeTransforms(baseline);
+        if (!delivered[frame])
+            continue;
+
+        uint32_t length = (uint32_t)size;
+        std::fwrite(&length, sizeof(length), 1, stdout);
+        std::fwrite(world.getTransformPacketData().data(), 1, length, stdout);
+        totalBytes += length;
+        rawBytes += (size_t)world.getBodyCount() * (4 + 7 * sizeof(float));
+        packets++;
+
+        // What the viewer should now hold, in slot order
+        struct Body
+        {
+            uint32_t handle;
+            int index;
+        };
+        std::vector<Body> order;
+        for (int i = 0; i < world.getBodyCount(); i++)
+            order.push_back({world.getBodyHandle(i), i});
+        std::sort(order.begin(), order.end(),
+                  [](const Body& a, const Body& b)
+                  {
+                      return TransformStream::slotOf(a.handle) <
+                             TransformStream::slotOf(b.handle);
+                  });
+        std::vector<float> states((size_t)world.getBodyCount() * PhysicsWorld::BODY_STATE_STRIDE);
+        world.readBodyStates(states.data(), world.getBodyCount());
+        expected.clear();
+        for (const Body& body : order)
+        {
+            const float* s = &states[(size_t)body.index * PhysicsWorld::BODY_STATE_STRIDE];
+            Quaternion q(s[3], s[4], s[5], s[6]);
+            Quaternion r = TransformStream::unpackRotation(TransformStream::packRotation(q));
+            float record[TransformDecoder::STATE_STRIDE];
+            std::memcpy(&record[0], &body.handle, sizeof(float));
+            for (int axis = 0; axis < 3; axis++)
+            {
+                record[1 + axis] = grid.dequantize(grid.quantize(s[axis], axis), axis);
+                maxPositionError = std::max(maxPositionError, std::abs(record[1 + axis] - s[axis]));
+            }
+            record[4] = r.w;
+            record[5] = r.x;
+            record[6] = r.y;
+            record[7] = r.z;
+            float dot = std::abs(q.w * r.w + q.x * r.x + q.y * r.y + q.z * r.z) /
+                        std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+            maxAngleError = std::max(maxAngleError, 2.0f * std::acos(std::min(dot, 1.0f)));
+            expected.insert(expected.end(), record, record + TransformDecoder::STATE_STRIDE);
+        }
+        std::fprintf(stderr, "seq %u bodies %zu digest %016llx\n", sequence, order.size(),
+                     (unsigned long long)digest(expected.data(), order.size()));
+    }
+    std::fflush(stdout);
+    std::fprintf(stderr, "# encoder: %d packets, %.1f bytes/packet (%.1f as raw floats)\n", packets,
+                 (double)totalBytes / packets, (double)rawBytes / packets);
+    std::fprintf(stderr, "# encoder: max error %.5f m, %.5f rad\n", maxPositionError,
+                 maxAngleError);
+    return 0;
+}
+
+static int decode()
+{
+    TransformDecoder decoder;
+    std::vector<uint8_t> packet;
+    uint32_t length;
+    int packets = 0;
+    while (std::fread(&length, sizeof(length), 1, stdin) == 1)
+    {
+        packet.resize(length);
+        if (std::fread(packet.data(), 1, length, stdin) != length)
+        {
+            std::fprintf(stderr, "truncated packet\n");
+            return 1;
+        }
+        uint32_t sequence = decoder.decode(packet.data(), packet.size());
+        if (sequence == 0)
+        {
+            std::fprintf(stderr, "packet %d rejected\n", packets);
+            return 1;
+        }
+        const std::vector<float>& states = decoder.getStateList();
+        std::printf("seq %u bodies %d digest %016llx\n", sequence, decoder.getBodyCount(),
+                    (unsigned long long)digest(states.data(), decoder.getBodyCount()));
+        packets++;
+    }
+    std::printf("# decoder: %d packets\n", packets);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::strcmp(argv[1], "encode") == 0)
+        return encode(argc > 2 ? std::atoi(argv[2]) : 600);
+    if (argc > 1 && std::strcmp(argv[1], "decode") == 0)
+        return decode();
+    std::fprintf(stderr, "usage: %s encode [frames] > stream.bin\n       %s decode < stream.bin\n",
+                 argv[0], argv[0]);
+    return 2;
+}
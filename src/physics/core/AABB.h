@@ -0,0 +1,75 @@
+#pragma once
+#include "Vector3.h"
+#include <algorithm>
+
+// Axis-aligned bounding box
+struct AABB
+{
+    Vector3 min;
+    Vector3 max;
+
+    AABB() {}
+    AABB(const Vector3& mn, const Vector3& mx) : min(mn), max(mx) {}
+
+    static AABB fromCenter(const Vector3& center, const Vector3& halfExtents)
+    {
+        return AABB(center - halfExtents, center + halfExtents);
+    }
+
+    bool overlaps(const AABB& o) const
+    {
+        return min.x <= o.max.x && max.x >= o.min.x && min.y <= o.max.y && max.y >= o.min.y &&
+               min.z <= o.max.z && max.z >= o.min.z;
+    }
+
+    bool contains(const AABB& o) const
+    {
+        return min.x <= o.min.x && min.y <= o.min.y && min.z <= o.min.z && max.x >= o.max.x &&
+               max.y >= o.max.y && max.z >= o.max.z;
+    }
+
+    AABB merged(const AABB& o) const
+    {
+        return AABB(Vector3(std::min(min.x, o.min.x), std::min(min.y, o.min.y),
+                            std::min(min.z, o.min.z)),
+                    Vector3(std::max(max.x, o.max.x), std::max(max.y, o.max.y),
+                            std::max(max.z, o.max.z)));
+    }
+
+    // Half the surface area; only used to compare insertion costs
+    float perimeter() const
+    {
+        Vector3 d = max - min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    Vector3 center() const { return (min + max) * 0.5f; }
+    Vector3 halfExtents() const { return (max - min) * 0.5f; }
+
+    // Reciprocal of a ray direction for raycast(), with zero components mapped to a huge
+    // value instead of infinity so the slab test never produces NaN
+    static Vector3 inverseDirection(const Vector3& d)
+    {
+        auto inv = [](float v)
+        { return std::abs(v) > 1e-12f ? 1.0f / v : (v < 0 ? -1e30f : 1e30f); };
+        return Vector3(inv(d.x), inv(d.y), inv(d.z));
+    }
+
+    // Slab test; returns the entry distance along dir, or -1 when the ray misses
+    float raycast(const Vector3& origin, const Vector3& invDir, float maxT) const
+    {
+        float t1 = (min.x - origin.x) * invDir.x, t2 = (max.x - origin.x) * invDir.x;
+        float tmin = std::min(t1, t2), tmax = std::max(t1, t2);
+        t1 = (min.y - origin.y) * invDir.y;
+        t2 = (max.y - origin.y) * invDir.y;
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+        t1 = (min.z - origin.z) * invDir.z;
+        t2 = (max.z - origin.z) * invDir.z;
+        tmin = std::max(tmin, std::min(t1, t2));
+        tmax = std::min(tmax, std::max(t1, t2));
+        if (tmax < std::max(tmin, 0.0f) || tmin > maxT)
+            return -1.0f;
+        return std::max(tmin, 0.0f);
+    }
+};
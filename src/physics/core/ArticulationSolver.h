@@ -0,0 +1,552 @@
+#pragma once
+#include "Constraint.h"
+#include "FrameAllocator.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Direct solver for tree-shaped groups of distance constraints such as ropes and
+// ragdolls. Each group is solved with Baraff's linear-time sparse factorization
+// ("Linear-Time Dynamics using Lagrange Multipliers", 1996) applied to the XPBD system
+//
+//     [ M   J^T ] [  dx  ]   [       0        ]
+//     [ J   -a  ] [ -dl  ] = [ -C - a * lambda ]
+//
+// Bodies and constraints are the nodes of a tree, so eliminating children before
+// parents produces no fill-in and the whole chain converges in one O(n) pass instead
+// of one link per Gauss-Seidel iteration. Groups with loops, or attached to the static
+// world more than once, are handed back to the iterative ConstraintSolver.
+class ArticulationSolver
+{
+public:
+    // Newton iterations per substep; the system is re-linearized each time
+    int maxIterations = 2;
+    float tolerance = 1e-4f;
+    // Smaller groups are cheap enough for the iterative solver
+    int minConstraints = 2;
+
+    int iterationsUsed = 0;
+    float maxError = 0.0f;
+
+    // Splits the constraint graph into articulations and returns everything that has
+    // to stay on the iterative solver. Only needed when the set of constraints changes.
+    // The graph scratch comes from arena; articulations keep their node storage between
+    // builds.
+    void build(Constraint* const* constraints, size_t count, std::vector<Constraint*>& iterative,
+               FrameAllocator& arena)
+    {
+        iterative.clear();
+
+        // Dense ids for the dynamic bodies: their index in the sorted, unique pointer list
+        FrameVector<RigidBody*> byId{FrameAllocatorAdapter<RigidBody*>(arena)};
+        byId.reserve(count * 2);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (constraints[i]->bodyA->hasFiniteMass())
+                byId.push_back(constraints[i]->bodyA);
+            if (constraints[i]->bodyB->hasFiniteMass())
+                byId.push_back(constraints[i]->bodyB);
+        }
+        std::sort(byId.begin(), byId.end());
+        byId.erase(std::unique(byId.begin(), byId.end()), byId.end());
+        const size_t bodyCount = byId.size();
+        auto idOf = [&](RigidBody* body)
+        { return (int)(std::lower_bound(byId.begin(), byId.end(), body) - byId.begin()); };
+
+        auto ints = [&](size_t n, int value)
+        { return FrameVector<int>(n, value, FrameAllocatorAdapter<int>(arena)); };
+        auto flags = [&](size_t n)
+        { return FrameVector<char>(n, 0, FrameAllocatorAdapter<char>(arena)); };
+
+        FrameVector<int> parent = ints(bodyCount, 0);
+        for (size_t i = 0; i < bodyCount; i++)
+            parent[i] = (int)i;
+        auto find = [&](int i)
+        {
+            while (parent[i] != i)
+            {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        };
+
+        // Union dynamic bodies through constraints, noting every edge that closes a loop
+        FrameVector<int> edgeBody = ints(count, -1);
+        FrameVector<char> closesLoop = flags(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            Constraint* c = constraints[i];
+            bool dynA = c->bodyA->hasFiniteMass();
+            bool dynB = c->bodyB->hasFiniteMass();
+            if (c->bodyA == c->bodyB || (!dynA && !dynB))
+            {
+                iterative.push_back(c);
+                continue;
+            }
+            if (dynA && dynB)
+            {
+                int ra = find(idOf(c->bodyA));
+                int rb = find(idOf(c->bodyB));
+                if (ra == rb)
+                    closesLoop[i] = 1;
+                else
+                    parent[ra] = rb;
+                edgeBody[i] = idOf(c->bodyA);
+            }
+            else
+            {
+                edgeBody[i] = idOf(dynA ? c->bodyA : c->bodyB);
+            }
+        }
+
+        FrameVector<char> hasLoop = flags(bodyCount);
+        FrameVector<int> worldLinks = ints(bodyCount, 0);
+        FrameVector<int> linkCount = ints(bodyCount, 0);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (edgeBody[i] < 0)
+                continue;
+            Constraint* c = constraints[i];
+            int root = find(edgeBody[i]);
+            hasLoop[root] |= closesLoop[i];
+            linkCount[root]++;
+            if (!c->bodyA->hasFiniteMass() || !c->bodyB->hasFiniteMass())
+                worldLinks[root]++;
+        }
+
+        // Constraints of every body that belongs to a tree, as one list per body:
+        // adjacency[adjacencyStart[id] .. adjacencyStart[id + 1])
+        FrameVector<int> adjacencyStart = ints(bodyCount + 1, 0);
+        FrameVector<int> rootToGroup = ints(bodyCount, -1);
+        FrameVector<int> groupRoots{FrameAllocatorAdapter<int>(arena)};
+        for (size_t i = 0; i < count; i++)
+        {
+            if (edgeBody[i] < 0)
+                continue;
+            int root = find(edgeBody[i]);
+            if (hasLoop[root] || worldLinks[root] > 1 || linkCount[root] < minConstraints)
+            {
+                iterative.push_back(constraints[i]);
+                edgeBody[i] = -1;
+                continue;
+            }
+            Constraint* c = constraints[i];
+            if (c->bodyA->hasFiniteMass())
+                adjacencyStart[idOf(c->bodyA) + 1]++;
+            if (c->bodyB->hasFiniteMass())
+                adjacencyStart[idOf(c->bodyB) + 1]++;
+            if (rootToGroup[root] < 0)
+            {
+                rootToGroup[root] = (int)groupRoots.size();
+                groupRoots.push_back((int)i);
+            }
+            else if (!c->bodyA->hasFiniteMass() || !c->bodyB->hasFiniteMass())
+            {
+                // Root the tree at its world link so that constraint is never a leaf
+                groupRoots[rootToGroup[root]] = (int)i;
+            }
+        }
+        for (size_t b = 0; b < bodyCount; b++)
+            adjacencyStart[b + 1] += adjacencyStart[b];
+        FrameVector<int> adjacency = ints(adjacencyStart[bodyCount], 0);
+        FrameVector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1,
+                              FrameAllocatorAdapter<int>(arena));
+        for (size_t i = 0; i < count; i++)
+        {
+            if (edgeBody[i] < 0)
+                continue;
+            Constraint* c = constraints[i];
+            if (c->bodyA->hasFiniteMass())
+                adjacency[fill[idOf(c->bodyA)]++] = (int)i;
+            if (c->bodyB->hasFiniteMass())
+                adjacency[fill[idOf(c->bodyB)]++] = (int)i;
+        }
+
+        // Breadth-first walk per group; order[] lists parents before children
+        struct Visit
+        {
+            int body;       // body id, or -1 for a constraint
+            int constraint; // constraint index; for a body, one attached to it
+            int parent;     // position of the parent in order[]
+        };
+        FrameVector<Visit> order{FrameAllocatorAdapter<Visit>(arena)};
+        FrameVector<char> visited = flags(count);
+        size_t groups = 0;
+        for (int rootConstraint : groupRoots)
+        {
+            Constraint* first = constraints[rootConstraint];
+            bool worldRooted = !first->bodyA->hasFiniteMass() || !first->bodyB->hasFiniteMass();
+
+            order.clear();
+            if (worldRooted)
+            {
+                order.push_back({-1, rootConstraint, -1});
+                visited[rootConstraint] = 1;
+            }
+            else
+            {
+                order.push_back({idOf(first->bodyA), rootConstraint, -1});
+            }
+
+            for (size_t k = 0; k < order.size(); k++)
+            {
+                Visit v = order[k];
+                if (v.body < 0)
+                {
+                    Constraint* c = constraints[v.constraint];
+                    RigidBody* ends[2] = {c->bodyA, c->bodyB};
+                    for (RigidBody* end : ends)
+                    {
+                        if (!end->hasFiniteMass())
+                            continue;
+                        int id = idOf(end);
+                        if (v.parent >= 0 && order[v.parent].body == id)
+                            continue;
+                        order.push_back({id, v.constraint, (int)k});
+                    }
+                }
+                else
+                {
+                    for (int a = adjacencyStart[v.body]; a < adjacencyStart[v.body + 1]; a++)
+                    {
+                        int ci = adjacency[a];
+                        if (visited[ci])
+                            continue;
+                        visited[ci] = 1;
+                        order.push_back({-1, ci, (int)k});
+                    }
+                }
+            }
+
+            // Store children before parents
+            if (groups == articulations.size())
+                articulations.emplace_back();
+            Articulation& art = articulations[groups++];
+            int n = (int)order.size();
+            art.nodes.assign(n, Node());
+            for (int k = 0; k < n; k++)
+            {
+                Node& node = art.nodes[n - 1 - k];
+                const Visit& v = order[k];
+                node.parent = v.parent >= 0 ? n - 1 - v.parent : -1;
+                node.constraint = constraints[v.constraint];
+                if (v.body >= 0)
+                {
+                    node.isBody = true;
+                    node.onA = node.constraint->bodyA == byId[v.body];
+                }
+            }
+        }
+        articulations.resize(groups);
+    }
+
+    // Articulations sleep and wake as one unit: a partially awake group is woken fully
+    // and every body shares the largest motion so they all reach the sleep threshold
+    // together.
+    void syncSleep()
+    {
+        for (auto& art : articulations)
+        {
+            bool anyAwake = false;
+            float motion = 0.0f;
+            for (Node& node : art.nodes)
+            {
+                if (node.isBody && node.body()->isAwake)
+                {
+                    anyAwake = true;
+                    motion = std::max(motion, node.body()->motion);
+                }
+            }
+            if (!anyAwake)
+                continue;
+            for (Node& node : art.nodes)
+            {
+                if (!node.isBody)
+                    continue;
+                RigidBody* body = node.body();
+                if (!body->isAwake)
+                    body->setAwake(true);
+                body->motion = std::max(motion, body->motion);
+            }
+        }
+    }
+
+    void solve(float dt)
+    {
+        iterationsUsed = 0;
+        maxError = 0.0f;
+        for (auto& art : articulations)
+        {
+            if (!wakeGroup(art))
+                continue;
+            for (int i = 0; i < maxIterations; i++)
+            {
+                float error = solveOnce(art, dt, i == 0);
+                iterationsUsed = std::max(iterationsUsed, i + 1);
+                if (error < tolerance)
+                {
+                    maxError = std::max(maxError, error);
+                    break;
+                }
+                if (i == maxIterations - 1)
+                    maxError = std::max(maxError, error);
+            }
+        }
+    }
+
+    bool empty() const { return articulations.empty(); }
+
+private:
+    struct Node
+    {
+        // A constraint node's own constraint, or for a body node one attached to the body.
+        // Bodies are reached through their constraints because body storage may move.
+        Constraint* constraint = nullptr;
+        bool isBody = false;
+        bool onA = false;
+        int parent = -1;
+
+        RigidBody* body() const { return onA ? constraint->bodyA : constraint->bodyB; }
+
+        float D[36]; // body: 6x6 block (then its Cholesky factor), constraint: D[0]
+        float J[6];  // D^-1 times the block linking this node to its parent
+        float h[6];  // constraint Jacobian block linking this node and its parent
+        float x[6];
+
+        // Linearization of a constraint node
+        Vector3 n, rA, rB;
+        float error;
+    };
+
+    struct Articulation
+    {
+        std::vector<Node> nodes; // children before parents
+    };
+
+    std::vector<Articulation> articulations;
+
+    static bool wakeGroup(Articulation& art)
+    {
+        bool anyAwake = false;
+        for (Node& node : art.nodes)
+            anyAwake |= node.isBody && node.body()->isAwake;
+        if (!anyAwake)
+            return false;
+        for (Node& node : art.nodes)
+        {
+            if (node.isBody && !node.body()->isAwake)
+                node.body()->setAwake(true);
+        }
+        return true;
+    }
+
+    static void jacobian(const Node& c, RigidBody* body, float out[6])
+    {
+        bool isA = body == c.constraint->bodyA;
+        Vector3 r = isA ? c.rA : c.rB;
+        Vector3 lin = isA ? c.n : c.n * -1.0f;
+        Vector3 ang = r.cross(lin);
+        out[0] = lin.x;
+        out[1] = lin.y;
+        out[2] = lin.z;
+        out[3] = ang.x;
+        out[4] = ang.y;
+        out[5] = ang.z;
+    }
+
+    static bool choleskyFactor(float A[36])
+    {
+        for (int j = 0; j < 6; j++)
+        {
+            float d = A[j * 6 + j];
+            for (int k = 0; k < j; k++)
+                d -= A[j * 6 + k] * A[j * 6 + k];
+            if (d <= 0.0f)
+                return false;
+            d = std::sqrt(d);
+            A[j * 6 + j] = d;
+            float inv = 1.0f / d;
+            for (int i = j + 1; i < 6; i++)
+            {
+                float s = A[i * 6 + j];
+                for (int k = 0; k < j; k++)
+                    s -= A[i * 6 + k] * A[j * 6 + k];
+                A[i * 6 + j] = s * inv;
+            }
+        }
+        return true;
+    }
+
+    static void choleskySolve(const float L[36], const float b[6], float out[6])
+    {
+        float y[6];
+        for (int i = 0; i < 6; i++)
+        {
+            float s = b[i];
+            for (int k = 0; k < i; k++)
+                s -= L[i * 6 + k] * y[k];
+            y[i] = s / L[i * 6 + i];
+        }
+        for (int i = 5; i >= 0; i--)
+        {
+            float s = y[i];
+            for (int k = i + 1; k < 6; k++)
+                s -= L[k * 6 + i] * out[k];
+            out[i] = s / L[i * 6 + i];
+        }
+    }
+
+    // One linearized solve of the whole tree. Returns the largest error before it.
+    float solveOnce(Articulation& art, float dt, bool firstIteration)
+    {
+        std::vector<Node>& nodes = art.nodes;
+        float alphaScale = 1.0f / (dt * dt);
+        float error = 0.0f;
+
+        for (Node& node : nodes)
+        {
+            if (node.isBody)
+                continue;
+            Constraint* c = node.constraint;
+            if (firstIteration)
+                c->lambda = 0.0f;
+            node.rA = c->bodyA->orientation.rotate(c->anchorA);
+            node.rB = c->bodyB->orientation.rotate(c->anchorB);
+            Vector3 delta = (c->bodyA->position + node.rA) - (c->bodyB->position + node.rB);
+            float len = delta.magnitude();
+            node.n = len > 0.0f ? delta * (1.0f / len) : Vector3(0, 1, 0);
+            node.error = len - c->length;
+            error = std::max(error, std::abs(node.error));
+        }
+        if (error < tolerance)
+            return error;
+
+        // Diagonal blocks and right-hand side
+        for (Node& node : nodes)
+        {
+            if (node.isBody)
+            {
+                RigidBody* b = node.body();
+                Matrix3 inertia;
+                inertia.setInverse(b->inverseInertiaTensorWorld);
+                float m = 1.0f / b->inverseMass;
+                for (int i = 0; i < 36; i++)
+                    node.D[i] = 0.0f;
+                node.D[0] = node.D[7] = node.D[14] = m;
+                for (int r = 0; r < 3; r++)
+                    for (int col = 0; col < 3; col++)
+                        node.D[(r + 3) * 6 + col + 3] = inertia.data[r * 3 + col];
+                for (int i = 0; i < 6; i++)
+                    node.x[i] = 0.0f;
+                if (node.parent >= 0)
+                    jacobian(nodes[node.parent], b, node.h);
+            }
+            else
+            {
+                Constraint* c = node.constraint;
+                float alpha = c->compliance * alphaScale;
+                node.D[0] = -alpha;
+                node.x[0] = -node.error - alpha * c->lambda;
+                if (node.parent >= 0)
+                    jacobian(node, nodes[node.parent].body(), node.h);
+            }
+        }
+
+        // Factor and forward substitution, children first
+        for (Node& node : nodes)
+        {
+            if (node.isBody)
+            {
+                if (!choleskyFactor(node.D))
+                    return error;
+                if (node.parent < 0)
+                    continue;
+                Node& p = nodes[node.parent];
+                choleskySolve(node.D, node.h, node.J);
+                float hJ = 0.0f, Jx = 0.0f;
+                for (int i = 0; i < 6; i++)
+                {
+                    hJ += node.h[i] * node.J[i];
+                    Jx += node.J[i] * node.x[i];
+                }
+                p.D[0] -= hJ;
+                p.x[0] -= Jx;
+            }
+            else
+            {
+                if (node.D[0] == 0.0f)
+                    return error;
+                if (node.parent < 0)
+                    continue;
+                Node& p = nodes[node.parent];
+                float invD = 1.0f / node.D[0];
+                for (int i = 0; i < 6; i++)
+                    node.J[i] = node.h[i] * invD;
+                for (int r = 0; r < 6; r++)
+                {
+                    for (int col = 0; col < 6; col++)
+                        p.D[r * 6 + col] -= node.h[r] * node.J[col];
+                    p.x[r] -= node.J[r] * node.x[0];
+                }
+            }
+        }
+
+        // Diagonal solve
+        for (Node& node : nodes)
+        {
+            if (node.isBody)
+            {
+                float b[6];
+                for (int i = 0; i < 6; i++)
+                    b[i] = node.x[i];
+                choleskySolve(node.D, b, node.x);
+            }
+            else
+            {
+                node.x[0] /= node.D[0];
+            }
+        }
+
+        // Back substitution, parents first
+        for (int k = (int)nodes.size() - 1; k >= 0; k--)
+        {
+            Node& node = nodes[k];
+            if (node.parent < 0)
+                continue;
+            const Node& p = nodes[node.parent];
+            if (node.isBody)
+            {
+                for (int i = 0; i < 6; i++)
+                    node.x[i] -= node.J[i] * p.x[0];
+            }
+            else
+            {
+                float s = 0.0f;
+                for (int i = 0; i < 6; i++)
+                    s += node.J[i] * p.x[i];
+                node.x[0] -= s;
+            }
+        }
+
+        // Apply the corrections; velocity follows from the position change
+        float invDt = 1.0f / dt;
+        for (Node& node : nodes)
+        {
+            if (!node.isBody)
+            {
+                node.constraint->lambda -= node.x[0];
+                continue;
+            }
+            RigidBody* b = node.body();
+            Vector3 dx(node.x[0], node.x[1], node.x[2]);
+            Vector3 dTheta(node.x[3], node.x[4], node.x[5]);
+            b->position += dx;
+            b->orientation.addScaledVector(dTheta, 1.0f);
+            b->orientation.normalize();
+            b->velocity += dx * invDt;
+            b->angularVelocity += dTheta * invDt;
+        }
+        return error;
+    }
+};
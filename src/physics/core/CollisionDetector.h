@@ -1,14 +1,19 @@
 #pragma once
 #include "../geometry/Box.h"
+#include "../geometry/Capsule.h"
+#include "../geometry/ConvexHull.h"
 #include "../geometry/Cylinder.h"
+#include "../geometry/Heightfield.h"
 #include "../geometry/Sphere.h"
+#include "../geometry/TriangleMesh.h"
 #include "Contact.h"
 #include "math.h"
+#include <algorithm>
 
 class CollisionDetector
 {
 public:
-    static Vector3 toLocal(RigidBody* body, const Vector3& worldPt)
+    static Vector3 toLocal(const RigidBody* body, const Vector3& worldPt)
     {
         Vector3 rel = worldPt - body->position;
         Quaternion invQ = body->orientation;
@@ -16,14 +21,21 @@ public:
         return invQ.rotate(rel);
     }
 
-    static Vector3 toWorld(RigidBody* body, const Vector3& localPt)
+    static Vector3 toLocalDirection(const RigidBody* body, const Vector3& worldDir)
+    {
+        Quaternion invQ = body->orientation;
+        invQ.invert();
+        return invQ.rotate(worldDir);
+    }
+
+    static Vector3 toWorld(const RigidBody* body, const Vector3& localPt)
     {
         return body->position + body->orientation.rotate(localPt);
     }
 
     static bool checkSpherePlane(RigidBody* sphereBody, float planeY, Contact& contact)
     {
-        Sphere* sphere = (Sphere*)sphereBody->shape;
+        const Sphere* sphere = (const Sphere*)sphereBody->shape;
 
         float distance = sphereBody->position.y - planeY;
         if (distance < sphere->radius)
@@ -43,52 +55,14 @@ public:
 
     static bool checkBoxPlane(RigidBody* boxBody, float planeY, Contact& contact)
     {
-        Box* box = (Box*)boxBody->shape;
-
-        Vector3 corners[8] = {
-            Vector3(box->halfExtents.x, box->halfExtents.y, box->halfExtents.z),
-            Vector3(-box->halfExtents.x, box->halfExtents.y, box->halfExtents.z),
-            Vector3(box->halfExtents.x, -box->halfExtents.y, box->halfExtents.z),
-            Vector3(-box->halfExtents.x, -box->halfExtents.y, box->halfExtents.z),
-            Vector3(box->halfExtents.x, box->halfExtents.y, -box->halfExtents.z),
-            Vector3(-box->halfExtents.x, box->halfExtents.y, -box->halfExtents.z),
-            Vector3(box->halfExtents.x, -box->halfExtents.y, -box->halfExtents.z),
-            Vector3(-box->halfExtents.x, -box->halfExtents.y, -box->halfExtents.z)};
-
-        float maxPenetration = 0;
-        Vector3 avgPoint(0, 0, 0);
-        int contactCount = 0;
-
-        for (int i = 0; i < 8; i++)
-        {
-            Vector3 worldPos = boxBody->position + boxBody->orientation.rotate(corners[i]);
-
-            if (worldPos.y < planeY)
-            {
-                float pen = planeY - worldPos.y;
-                if (pen > maxPenetration)
-                    maxPenetration = pen;
-                avgPoint += worldPos;
-                contactCount++;
-            }
-        }
-
-        if (contactCount > 0)
-        {
-            contact.a = boxBody;
-            contact.b = nullptr;
-            contact.normal = Vector3(0, 1, 0);
-            contact.penetration = maxPenetration;
-            contact.point = avgPoint * (1.0f / contactCount);
-            return true;
-        }
-        return false;
+        const Box* box = (const Box*)boxBody->shape;
+        return pointsPlane(boxBody, box->corners, 8, planeY, contact);
     }
 
     static bool checkSphereSphere(RigidBody* a, RigidBody* b, Contact& contact)
     {
-        Sphere* sA = (Sphere*)a->shape;
-        Sphere* sB = (Sphere*)b->shape;
+        const Sphere* sA = (const Sphere*)a->shape;
+        const Sphere* sB = (const Sphere*)b->shape;
 
         Vector3 midLine = a->position - b->position;
         float distance = midLine.magnitude();
@@ -109,8 +83,8 @@ public:
 
     static bool checkBoxBox(RigidBody* a, RigidBody* b, Contact& contact)
     {
-        Box* boxA = (Box*)a->shape;
-        Box* boxB = (Box*)b->shape;
+        const Box* boxA = (const Box*)a->shape;
+        const Box* boxB = (const Box*)b->shape;
 
         Vector3 posA = a->position;
         Vector3 posB = b->position;
@@ -160,8 +134,8 @@ public:
 
     static bool checkSphereBox(RigidBody* sphereBody, RigidBody* boxBody, Contact& contact)
     {
-        Sphere* sphere = (Sphere*)sphereBody->shape;
-        Box* box = (Box*)boxBody->shape;
+        const Sphere* sphere = (const Sphere*)sphereBody->shape;
+        const Box* box = (const Box*)boxBody->shape;
 
         Vector3 center = sphereBody->position;
         Vector3 boxPos = boxBody->position;
@@ -203,68 +177,26 @@ public:
 
     static bool checkCylinderPlane(RigidBody* cylBody, float planeY, Contact& contact)
     {
-        Cylinder* cylinder = (Cylinder*)cylBody->shape;
-
-        const int segments = 16;
-        float angleStep = (3.14159f * 2.0f) / segments;
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
 
         float maxPenetration = 0;
         Vector3 avgPoint(0, 0, 0);
         int contactCount = 0;
 
-        for (int i = 0; i < segments; i++)
+        for (int i = 0; i < Cylinder::POINT_COUNT; i++)
         {
-            float theta = i * angleStep;
-            float x = cylinder->radius * std::cos(theta);
-            float z = cylinder->radius * std::sin(theta);
-
-            // Bottom rim
-            Vector3 worldBottom = cylBody->position +
-                                  cylBody->orientation.rotate(Vector3(x, -cylinder->halfHeight, z));
-            if (worldBottom.y < planeY)
-            {
-                float pen = planeY - worldBottom.y;
-                if (pen > maxPenetration)
-                    maxPenetration = pen;
-                avgPoint += worldBottom;
-                contactCount++;
-            }
-
-            // Top rim
-            Vector3 worldTop = cylBody->position +
-                               cylBody->orientation.rotate(Vector3(x, cylinder->halfHeight, z));
-            if (worldTop.y < planeY)
+            Vector3 worldPt =
+                cylBody->position + cylBody->orientation.rotate(cylinder->supportPoints[i]);
+            if (worldPt.y < planeY)
             {
-                float pen = planeY - worldTop.y;
+                float pen = planeY - worldPt.y;
                 if (pen > maxPenetration)
                     maxPenetration = pen;
-                avgPoint += worldTop;
+                avgPoint += worldPt;
                 contactCount++;
             }
         }
 
-        // Cap centers
-        Vector3 worldCenterBottom =
-            cylBody->position + cylBody->orientation.rotate(Vector3(0, -cylinder->halfHeight, 0));
-        if (worldCenterBottom.y < planeY)
-        {
-            float pen = planeY - worldCenterBottom.y;
-            if (pen > maxPenetration)
-                maxPenetration = pen;
-            avgPoint += worldCenterBottom;
-            contactCount++;
-        }
-        Vector3 worldCenterTop =
-            cylBody->position + cylBody->orientation.rotate(Vector3(0, cylinder->halfHeight, 0));
-        if (worldCenterTop.y < planeY)
-        {
-            float pen = planeY - worldCenterTop.y;
-            if (pen > maxPenetration)
-                maxPenetration = pen;
-            avgPoint += worldCenterTop;
-            contactCount++;
-        }
-
         if (contactCount > 0)
         {
             contact.a = cylBody;
@@ -282,28 +214,10 @@ public:
         return Vector3(std::cos(angle) * radius, 0, std::sin(angle) * radius);
     }
 
-    static void generateCylinderPoints(Cylinder* cylinder, std::vector<Vector3>& outPoints)
-    {
-        int segments = 16;
-        float step = 6.28318f / segments;
-        for (int i = 0; i < segments; i++)
-        {
-            float angle = i * step;
-            float x = std::cos(angle) * cylinder->radius;
-            float z = std::sin(angle) * cylinder->radius;
-
-            outPoints.push_back(Vector3(x, cylinder->halfHeight, z));
-            outPoints.push_back(Vector3(x, -cylinder->halfHeight, z));
-        }
-        // Cap centers
-        outPoints.push_back(Vector3(0, cylinder->halfHeight, 0));
-        outPoints.push_back(Vector3(0, -cylinder->halfHeight, 0));
-    }
-
     static bool checkSphereCylinder(RigidBody* sphereBody, RigidBody* cylBody, Contact& contact)
     {
-        Sphere* sphere = (Sphere*)sphereBody->shape;
-        Cylinder* cylinder = (Cylinder*)cylBody->shape;
+        const Sphere* sphere = (const Sphere*)sphereBody->shape;
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
 
         Vector3 localSphere = toLocal(cylBody, sphereBody->position);
         float clampedY =
@@ -376,18 +290,15 @@ public:
 
     static bool checkCylinderBox(RigidBody* cylBody, RigidBody* boxBody, Contact& contact)
     {
-        Cylinder* cylinder = (Cylinder*)cylBody->shape;
-        Box* box = (Box*)boxBody->shape;
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
+        const Box* box = (const Box*)boxBody->shape;
 
         float deepestPenetration = -1000.0f;
         Vector3 collisionPoint;
         Vector3 collisionNormal;
         bool hit = false;
 
-        std::vector<Vector3> cylPoints;
-        generateCylinderPoints(cylinder, cylPoints);
-
-        for (const auto& localPt : cylPoints)
+        for (const auto& localPt : cylinder->supportPoints)
         {
             Vector3 worldPt = toWorld(cylBody, localPt);
             Vector3 boxLocal = toLocal(boxBody, worldPt);
@@ -440,8 +351,8 @@ public:
 
     static bool checkCylinderCylinder(RigidBody* a, RigidBody* b, Contact& contact)
     {
-        Cylinder* cylA = (Cylinder*)a->shape;
-        Cylinder* cylB = (Cylinder*)b->shape;
+        const Cylinder* cylA = (const Cylinder*)a->shape;
+        const Cylinder* cylB = (const Cylinder*)b->shape;
 
         float deepestPenetration = -1000.0f;
         Vector3 collisionPoint;
@@ -450,9 +361,7 @@ public:
 
         // Test A's points against B (normal from B toward A = correct convention)
         {
-            std::vector<Vector3> ptsA;
-            generateCylinderPoints(cylA, ptsA);
-            for (auto& lp : ptsA)
+            for (auto& lp : cylA->supportPoints)
             {
                 Vector3 wp = toWorld(a, lp);
                 Vector3 localB = toLocal(b, wp);
@@ -489,9 +398,7 @@ public:
 
         // Test B's points against A (normal from A toward B, negate for B->A convention)
         {
-            std::vector<Vector3> ptsB;
-            generateCylinderPoints(cylB, ptsB);
-            for (auto& lp : ptsB)
+            for (auto& lp : cylB->supportPoints)
             {
                 Vector3 wp = toWorld(b, lp);
                 Vector3 localA = toLocal(a, wp);
@@ -537,4 +444,838 @@ public:
         }
         return false;
     }
+
+    // Capsule tests. Each finds the closest points between the capsule's core segment and
+    // the other shape in closed form, then makes a sphere-style contact from them, so a
+    // capsule pair costs about as much as a sphere pair.
+
+    // World-space end points of a capsule's core segment
+    static void capsuleSegment(const RigidBody* body, Vector3& p0, Vector3& p1)
+    {
+        const Capsule* capsule = (const Capsule*)body->shape;
+        Vector3 axis = body->orientation.rotate(Vector3(0, capsule->halfLength, 0));
+        p0 = body->position - axis;
+        p1 = body->position + axis;
+    }
+
+    static Vector3 closestPointOnSegment(const Vector3& p, const Vector3& a, const Vector3& b)
+    {
+        Vector3 ab = b - a;
+        float len2 = ab.magnitudeSquared();
+        if (len2 < 1e-12f)
+            return a;
+        float t = std::max(0.0f, std::min((p - a).dot(ab) / len2, 1.0f));
+        return a + ab * t;
+    }
+
+    // Closest points c1 on segment p1q1 and c2 on p2q2 (Ericson, Real-Time Collision
+    // Detection 5.1.9)
+    static void closestPointsSegments(const Vector3& p1, const Vector3& q1, const Vector3& p2,
+                                      const Vector3& q2, Vector3& c1, Vector3& c2)
+    {
+        auto clamp01 = [](float v) { return std::max(0.0f, std::min(v, 1.0f)); };
+        Vector3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+        float a = d1.dot(d1), e = d2.dot(d2), f = d2.dot(r);
+        float s = 0.0f, t = 0.0f;
+        if (a > 1e-12f && e <= 1e-12f)
+        {
+            s = clamp01(-d1.dot(r) / a);
+        }
+        else if (a <= 1e-12f && e > 1e-12f)
+        {
+            t = clamp01(f / e);
+        }
+        else if (a > 1e-12f)
+        {
+            float b = d1.dot(d2), c = d1.dot(r);
+            float denom = a * e - b * b;
+            // Parallel segments: any s works, start from p1
+            s = denom > 1e-6f * a * e ? clamp01((b * f - c * e) / denom) : 0.0f;
+            t = (b * s + f) / e;
+            if (t < 0.0f)
+            {
+                t = 0.0f;
+                s = clamp01(-c / a);
+            }
+            else if (t > 1.0f)
+            {
+                t = 1.0f;
+                s = clamp01((b - c) / a);
+            }
+        }
+        c1 = p1 + d1 * s;
+        c2 = p2 + d2 * t;
+    }
+
+    static bool checkCapsulePlane(RigidBody* capsuleBody, float planeY, Contact& contact)
+    {
+        float r = ((const Capsule*)capsuleBody->shape)->radius;
+        Vector3 ends[2];
+        capsuleSegment(capsuleBody, ends[0], ends[1]);
+
+        float maxPenetration = 0;
+        Vector3 avgPoint(0, 0, 0);
+        int contactCount = 0;
+        for (const Vector3& end : ends)
+        {
+            float pen = planeY - (end.y - r);
+            if (pen > 0.0f)
+            {
+                maxPenetration = std::max(maxPenetration, pen);
+                avgPoint += end - Vector3(0, r, 0);
+                contactCount++;
+            }
+        }
+
+        if (contactCount > 0)
+        {
+            contact.a = capsuleBody;
+            contact.b = nullptr;
+            contact.normal = Vector3(0, 1, 0);
+            contact.penetration = maxPenetration;
+            contact.point = avgPoint * (1.0f / contactCount);
+            return true;
+        }
+        return false;
+    }
+
+    static bool checkCapsuleSphere(RigidBody* capsuleBody, RigidBody* sphereBody,
+                                   Contact& contact)
+    {
+        Vector3 p0, p1;
+        capsuleSegment(capsuleBody, p0, p1);
+        Vector3 c = closestPointOnSegment(sphereBody->position, p0, p1);
+        return sphereContact(capsuleBody, c, ((const Capsule*)capsuleBody->shape)->radius,
+                             sphereBody, sphereBody->position,
+                             ((const Sphere*)sphereBody->shape)->radius, contact);
+    }
+
+    static bool checkSphereCapsule(RigidBody* sphereBody, RigidBody* capsuleBody,
+                                   Contact& contact)
+    {
+        Vector3 p0, p1;
+        capsuleSegment(capsuleBody, p0, p1);
+        Vector3 c = closestPointOnSegment(sphereBody->position, p0, p1);
+        return sphereContact(sphereBody, sphereBody->position,
+                             ((const Sphere*)sphereBody->shape)->radius, capsuleBody, c,
+                             ((const Capsule*)capsuleBody->shape)->radius, contact);
+    }
+
+    static bool checkCapsuleCapsule(RigidBody* a, RigidBody* b, Contact& contact)
+    {
+        Vector3 a0, a1, b0, b1, ca, cb;
+        capsuleSegment(a, a0, a1);
+        capsuleSegment(b, b0, b1);
+        closestPointsSegments(a0, a1, b0, b1, ca, cb);
+        // Crossing core segments: separate along their common perpendicular
+        Vector3 fallback = (a1 - a0).cross(b1 - b0);
+        if ((a->position - b->position).dot(fallback) < 0.0f)
+            fallback.invert();
+        fallback.normalize();
+        if (fallback.magnitudeSquared() == 0.0f)
+            fallback = Vector3(0, 1, 0);
+        return sphereContact(a, ca, ((const Capsule*)a->shape)->radius, b, cb,
+                             ((const Capsule*)b->shape)->radius, contact, fallback);
+    }
+
+    // The squared distance from the segment to the box is convex and piecewise quadratic in
+    // the segment parameter, with breaks where the segment crosses a face plane; each piece
+    // is minimized exactly.
+    static bool checkCapsuleBox(RigidBody* capsuleBody, RigidBody* boxBody, Contact& contact)
+    {
+        float r = ((const Capsule*)capsuleBody->shape)->radius;
+        Vector3 h = ((const Box*)boxBody->shape)->halfExtents;
+        Vector3 p0, p1;
+        capsuleSegment(capsuleBody, p0, p1);
+        Vector3 a = toLocal(boxBody, p0);
+        Vector3 d = toLocal(boxBody, p1) - a;
+        const float* ac = &a.x;
+        const float* dc = &d.x;
+        const float* hc = &h.x;
+
+        // At most six crossings between 0 and 1, kept sorted as they go in
+        float breaks[8] = {0.0f, 1.0f};
+        int breakCount = 2;
+        for (int i = 0; i < 3; i++)
+        {
+            if (std::abs(dc[i]) < 1e-9f)
+                continue;
+            for (float side : {-hc[i], hc[i]})
+            {
+                float t = (side - ac[i]) / dc[i];
+                if (!(t > 0.0f && t < 1.0f))
+                    continue;
+                int k = breakCount++;
+                for (; breaks[k - 1] > t; k--)
+                    breaks[k] = breaks[k - 1];
+                breaks[k] = t;
+            }
+        }
+
+        float bestT = 0.0f;
+        float bestDist2 = 1e30f;
+        for (int k = 0; k + 1 < breakCount; k++)
+        {
+            float t0 = breaks[k], t1 = breaks[k + 1];
+            float mid = 0.5f * (t0 + t1);
+            // Axes clamped on this piece contribute (e + d t)^2
+            float qa = 0.0f, qb = 0.0f, qc = 0.0f;
+            for (int i = 0; i < 3; i++)
+            {
+                float p = ac[i] + dc[i] * mid;
+                if (p > -hc[i] && p < hc[i])
+                    continue;
+                float e = ac[i] - (p >= hc[i] ? hc[i] : -hc[i]);
+                qa += dc[i] * dc[i];
+                qb += 2.0f * dc[i] * e;
+                qc += e * e;
+            }
+            float t = qa > 1e-12f ? std::max(t0, std::min(-qb / (2.0f * qa), t1)) : t0;
+            float dist2 = std::max((qa * t + qb) * t + qc, 0.0f);
+            if (dist2 < bestDist2)
+            {
+                bestDist2 = dist2;
+                bestT = t;
+            }
+        }
+        if (bestDist2 >= r * r)
+            return false;
+
+        contact.a = capsuleBody;
+        contact.b = boxBody;
+        Vector3 s = a + d * bestT;
+        Vector3 q(std::max(-h.x, std::min(s.x, h.x)), std::max(-h.y, std::min(s.y, h.y)),
+                  std::max(-h.z, std::min(s.z, h.z)));
+        float dist = std::sqrt(bestDist2);
+        if (dist > 1e-6f)
+        {
+            contact.normal = boxBody->orientation.rotate((s - q) * (1.0f / dist));
+            contact.penetration = r - dist;
+            contact.point = toWorld(boxBody, q);
+            return true;
+        }
+
+        // Core segment inside the box: leave along the box axis that needs the least travel
+        float best = 1e30f;
+        int axis = 0;
+        float sign = 1.0f;
+        Vector3 b = a + d;
+        const float* bc = &b.x;
+        for (int i = 0; i < 3; i++)
+        {
+            float lo = std::min(ac[i], bc[i]), hi = std::max(ac[i], bc[i]);
+            float up = hc[i] - lo + r;
+            float down = hi + hc[i] + r;
+            if (up < best)
+            {
+                best = up;
+                axis = i;
+                sign = 1.0f;
+            }
+            if (down < best)
+            {
+                best = down;
+                axis = i;
+                sign = -1.0f;
+            }
+        }
+        Vector3 n(0, 0, 0);
+        (&n.x)[axis] = sign;
+        // Deepest end along the exit direction, moved onto that face
+        Vector3 deepest = ((&a.x)[axis] * sign < bc[axis] * sign) ? a : b;
+        (&deepest.x)[axis] = sign * hc[axis];
+        contact.normal = boxBody->orientation.rotate(n);
+        contact.penetration = best;
+        contact.point = toWorld(boxBody, deepest);
+        return true;
+    }
+
+    // The distance from the core segment to the solid cylinder is convex along the segment,
+    // but has no closed form near the rim, so its minimum is found by bisecting on the sign
+    // of its slope: a fixed 12 steps, within 1/4096 of the segment length.
+    static bool checkCapsuleCylinder(RigidBody* capsuleBody, RigidBody* cylBody,
+                                     Contact& contact)
+    {
+        float r = ((const Capsule*)capsuleBody->shape)->radius;
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
+        Vector3 p0, p1;
+        capsuleSegment(capsuleBody, p0, p1);
+        Vector3 a = toLocal(cylBody, p0);
+        Vector3 d = toLocal(cylBody, p1) - a;
+
+        float lo = 0.0f, hi = 1.0f;
+        Vector3 s, q;
+        bool inside = false;
+        for (int i = 0; i < 12; i++)
+        {
+            float mid = 0.5f * (lo + hi);
+            s = a + d * mid;
+            q = closestOnCylinder(cylinder, s, inside);
+            if (inside)
+                break;
+            float slope = (s - q).dot(d);
+            if (slope > 0.0f)
+                hi = mid;
+            else if (slope < 0.0f)
+                lo = mid;
+            else
+                break;
+        }
+        // The ends are not reached by the midpoints
+        for (float t : {0.0f, 1.0f})
+        {
+            if (inside || (t == 0.0f ? lo : 1.0f - hi) > 0.0f)
+                continue;
+            Vector3 end = a + d * t;
+            bool endInside;
+            Vector3 endQ = closestOnCylinder(cylinder, end, endInside);
+            if (endInside || (end - endQ).magnitudeSquared() < (s - q).magnitudeSquared())
+            {
+                s = end;
+                q = endQ;
+                inside = endInside;
+            }
+        }
+
+        Vector3 diff = inside ? q - s : s - q;
+        float dist = diff.magnitude();
+        if (!inside && dist >= r)
+            return false;
+        contact.a = capsuleBody;
+        contact.b = cylBody;
+        Vector3 n = dist > 1e-6f ? diff * (1.0f / dist) : Vector3(0, 1, 0);
+        contact.normal = cylBody->orientation.rotate(n);
+        contact.penetration = inside ? r + dist : r - dist;
+        contact.point = toWorld(cylBody, q);
+        return true;
+    }
+
+    // Terrain tests. Like the plane tests they produce one aggregated contact per body,
+    // and only look at the cells under the body's footprint.
+
+    static bool checkSphereHeightfield(RigidBody* sphereBody, const Heightfield& terrain,
+                                       Contact& contact)
+    {
+        float r = ((const Sphere*)sphereBody->shape)->radius;
+        contact.a = sphereBody;
+        contact.b = nullptr;
+        return sphereHeightfield(sphereBody->position, r, terrain, contact);
+    }
+
+    static bool checkBoxHeightfield(RigidBody* boxBody, const Heightfield& terrain,
+                                    Contact& contact)
+    {
+        const Box* box = (const Box*)boxBody->shape;
+        Vector3 h = box->halfExtents;
+        auto inside = [&](const Vector3& p)
+        { return std::abs(p.x) <= h.x && std::abs(p.y) <= h.y && std::abs(p.z) <= h.z; };
+        return checkHullHeightfield(boxBody, box->corners, 8, inside, terrain, contact);
+    }
+
+    static bool checkCylinderHeightfield(RigidBody* cylBody, const Heightfield& terrain,
+                                         Contact& contact)
+    {
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
+        float r2 = cylinder->radius * cylinder->radius;
+        auto inside = [&](const Vector3& p)
+        { return std::abs(p.y) <= cylinder->halfHeight && p.x * p.x + p.z * p.z <= r2; };
+        return checkHullHeightfield(cylBody, cylinder->supportPoints, Cylinder::POINT_COUNT,
+                                    inside, terrain, contact);
+    }
+
+    // Spheres along the core segment, about a radius apart, aggregated like the hull tests
+    static bool checkCapsuleHeightfield(RigidBody* capsuleBody, const Heightfield& terrain,
+                                        Contact& contact)
+    {
+        return capsuleSamples(capsuleBody, nullptr, contact,
+                              [&](const Vector3& c, float r, Contact& sample)
+                              { return sphereHeightfield(c, r, terrain, sample); });
+    }
+
+    // Closest point to p on triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+    static Vector3 closestPointOnTriangle(const Vector3& p, const Vector3& a, const Vector3& b,
+                                          const Vector3& c)
+    {
+        Vector3 ab = b - a, ac = c - a, ap = p - a;
+        float d1 = ab.dot(ap), d2 = ac.dot(ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return a;
+        Vector3 bp = p - b;
+        float d3 = ab.dot(bp), d4 = ac.dot(bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return b;
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return a + ab * (d1 / (d1 - d3));
+        Vector3 cp = p - c;
+        float d5 = ab.dot(cp), d6 = ac.dot(cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return c;
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return a + ac * (d2 / (d2 - d6));
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        float denom = 1.0f / (va + vb + vc);
+        return a + ab * (vb * denom) + ac * (vc * denom);
+    }
+
+    // Triangle mesh tests. The mesh body is static; contacts push the other body out along
+    // the mesh's faces, aggregated into one contact per pair like the terrain tests.
+    // Triangles are two-sided, so winding does not matter: a body is pushed back to the
+    // side of each triangle its centre is on.
+
+    static bool checkSphereMesh(RigidBody* sphereBody, RigidBody* meshBody, Contact& contact)
+    {
+        const TriangleMesh* mesh = (const TriangleMesh*)meshBody->shape;
+        float r = ((const Sphere*)sphereBody->shape)->radius;
+        Vector3 point, normal;
+        float penetration;
+        if (!sphereMesh(mesh, toLocal(meshBody, sphereBody->position),
+                        toLocalDirection(meshBody, sphereBody->velocity), r, point, normal,
+                        penetration))
+            return false;
+        contact.a = sphereBody;
+        contact.b = meshBody;
+        contact.normal = meshBody->orientation.rotate(normal);
+        contact.penetration = penetration;
+        contact.point = toWorld(meshBody, point);
+        return true;
+    }
+
+    static bool checkBoxMesh(RigidBody* boxBody, RigidBody* meshBody, Contact& contact)
+    {
+        const Box* box = (const Box*)boxBody->shape;
+        return checkHullMesh(boxBody, box->corners, 8, meshBody, contact);
+    }
+
+    static bool checkCylinderMesh(RigidBody* cylBody, RigidBody* meshBody, Contact& contact)
+    {
+        const Cylinder* cylinder = (const Cylinder*)cylBody->shape;
+        return checkHullMesh(cylBody, cylinder->supportPoints, Cylinder::POINT_COUNT, meshBody,
+                             contact);
+    }
+
+    static bool checkCapsuleMesh(RigidBody* capsuleBody, RigidBody* meshBody, Contact& contact)
+    {
+        const TriangleMesh* mesh = (const TriangleMesh*)meshBody->shape;
+        Vector3 motion = toLocalDirection(meshBody, capsuleBody->velocity);
+        return capsuleSamples(capsuleBody, meshBody, contact,
+                              [&](const Vector3& c, float r, Contact& sample)
+                              {
+                                  Vector3 point, normal;
+                                  if (!sphereMesh(mesh, toLocal(meshBody, c), motion, r, point,
+                                                  normal, sample.penetration))
+                                      return false;
+                                  sample.normal = meshBody->orientation.rotate(normal);
+                                  sample.point = toWorld(meshBody, point);
+                                  return true;
+                              });
+    }
+
+    // Pyramid and hull tests against the static world. Both are plain polyhedra here, so
+    // they reuse the box's point tests over their vertices; pairs between bodies go
+    // through ConvexCollider.
+
+    static bool checkPolyhedronPlane(RigidBody* body, float planeY, Contact& contact)
+    {
+        Polyhedron poly;
+        Polyhedron::of(body->shape, poly);
+        return pointsPlane(body, poly.vertices, poly.vertexCount, planeY, contact);
+    }
+
+    static bool checkPolyhedronHeightfield(RigidBody* body, const Heightfield& terrain,
+                                           Contact& contact)
+    {
+        Polyhedron poly;
+        Polyhedron::of(body->shape, poly);
+        auto inside = [&](const Vector3& p)
+        {
+            for (int i = 0; i < poly.faceCount; i++)
+            {
+                if (poly.normals[i].dot(p) > poly.offsets[i])
+                    return false;
+            }
+            return true;
+        };
+        return checkHullHeightfield(body, poly.vertices, poly.vertexCount, inside, terrain,
+                                    contact);
+    }
+
+    static bool checkPolyhedronMesh(RigidBody* body, RigidBody* meshBody, Contact& contact)
+    {
+        Polyhedron poly;
+        Polyhedron::of(body->shape, poly);
+        return checkHullMesh(body, poly.vertices, poly.vertexCount, meshBody, contact);
+    }
+
+private:
+    // Shared box/polyhedron plane test: the average of the points below the plane, at the
+    // deepest point's depth
+    static bool pointsPlane(RigidBody* body, const Vector3* localPoints, int count, float planeY,
+                            Contact& contact)
+    {
+        float maxPenetration = 0;
+        Vector3 avgPoint(0, 0, 0);
+        int contactCount = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            Vector3 worldPos = body->position + body->orientation.rotate(localPoints[i]);
+
+            if (worldPos.y < planeY)
+            {
+                float pen = planeY - worldPos.y;
+                if (pen > maxPenetration)
+                    maxPenetration = pen;
+                avgPoint += worldPos;
+                contactCount++;
+            }
+        }
+
+        if (contactCount > 0)
+        {
+            contact.a = body;
+            contact.b = nullptr;
+            contact.normal = Vector3(0, 1, 0);
+            contact.penetration = maxPenetration;
+            contact.point = avgPoint * (1.0f / contactCount);
+            return true;
+        }
+        return false;
+    }
+
+    // Contact between sphere (ca, ra) of body a and sphere (cb, rb) of body b; fallback is
+    // the normal when the centres coincide
+    static bool sphereContact(RigidBody* a, const Vector3& ca, float ra, RigidBody* b,
+                              const Vector3& cb, float rb, Contact& contact,
+                              const Vector3& fallback = Vector3(0, 1, 0))
+    {
+        Vector3 d = ca - cb;
+        float dist2 = d.magnitudeSquared();
+        float radiusSum = ra + rb;
+        if (dist2 >= radiusSum * radiusSum)
+            return false;
+        float dist = std::sqrt(dist2);
+        contact.a = a;
+        contact.b = b;
+        contact.normal = dist > 1e-6f ? d * (1.0f / dist) : fallback;
+        contact.penetration = radiusSum - dist;
+        contact.point = cb + contact.normal * rb;
+        return true;
+    }
+
+    // Closest point of the solid cylinder to p (local frame). For p inside, the nearest
+    // point on the surface instead, and inside is set.
+    static Vector3 closestOnCylinder(const Cylinder* c, const Vector3& p, bool& inside)
+    {
+        float radial = std::sqrt(p.x * p.x + p.z * p.z);
+        float dy = c->halfHeight - std::abs(p.y);
+        inside = radial < c->radius && dy > 0.0f;
+        if (!inside)
+        {
+            float scale = radial > c->radius ? c->radius / radial : 1.0f;
+            return Vector3(p.x * scale, std::max(-c->halfHeight, std::min(p.y, c->halfHeight)),
+                           p.z * scale);
+        }
+        if (dy <= c->radius - radial || radial < 1e-6f)
+            return Vector3(p.x, std::copysign(c->halfHeight, p.y), p.z);
+        float scale = c->radius / radial;
+        return Vector3(p.x * scale, p.y, p.z * scale);
+    }
+
+    // Runs test on spheres spaced along the capsule's core segment and merges the hits into
+    // one contact (deepest penetration, mean point, depth-weighted normal)
+    template <typename Test>
+    static bool capsuleSamples(RigidBody* capsuleBody, RigidBody* other, Contact& contact,
+                               Test test)
+    {
+        const Capsule* capsule = (const Capsule*)capsuleBody->shape;
+        Vector3 p0, p1;
+        capsuleSegment(capsuleBody, p0, p1);
+        int segments = std::min((int)std::ceil(2.0f * capsule->halfLength / capsule->radius), 8);
+
+        float maxPenetration = 0.0f;
+        Vector3 pointSum(0, 0, 0);
+        Vector3 normalSum(0, 0, 0);
+        int contactCount = 0;
+        for (int i = 0; i <= segments; i++)
+        {
+            float t = segments > 0 ? (float)i / segments : 0.5f;
+            Contact sample;
+            if (!test(p0 + (p1 - p0) * t, capsule->radius, sample) || sample.penetration <= 0.0f)
+                continue;
+            maxPenetration = std::max(maxPenetration, sample.penetration);
+            pointSum += sample.point;
+            normalSum += sample.normal * sample.penetration;
+            contactCount++;
+        }
+        if (contactCount == 0)
+            return false;
+
+        normalSum.normalize();
+        contact.a = capsuleBody;
+        contact.b = other;
+        contact.normal = normalSum;
+        contact.penetration = maxPenetration;
+        contact.point = pointSum * (1.0f / contactCount);
+        return true;
+    }
+
+    // Sphere (c, r) against the terrain; fills everything but the contact's bodies
+    static bool sphereHeightfield(const Vector3& c, float r, const Heightfield& terrain,
+                                  Contact& contact)
+    {
+        if (c.y - r > terrain.getMaxHeight())
+            return false;
+
+        // Center under the surface: push out along the surface normal
+        float h;
+        Vector3 n;
+        if (terrain.surfaceAt(c.x, c.z, h, n) && c.y < h)
+        {
+            contact.normal = n;
+            contact.penetration = (h - c.y) * n.y + r;
+            contact.point = c - n * r;
+            return true;
+        }
+
+        int x0, z0, x1, z1;
+        if (!terrain.cellRange(c.x - r, c.z - r, c.x + r, c.z + r, x0, z0, x1, z1))
+            return false;
+        float bestDist2 = r * r;
+        bool found = false;
+        Vector3 best;
+        for (int z = z0; z <= z1; z++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                for (int half = 0; half < 2; half++)
+                {
+                    Vector3 tri[3];
+                    terrain.triangle(x, z, half, tri);
+                    Vector3 q = closestPointOnTriangle(c, tri[0], tri[1], tri[2]);
+                    float d2 = (c - q).magnitudeSquared();
+                    if (d2 < bestDist2)
+                    {
+                        bestDist2 = d2;
+                        best = q;
+                        found = true;
+                    }
+                }
+            }
+        }
+        if (!found)
+            return false;
+
+        float dist = std::sqrt(bestDist2);
+        contact.normal = dist > 1e-6f ? (c - best) * (1.0f / dist) : Vector3(0, 1, 0);
+        contact.penetration = r - dist;
+        contact.point = best;
+        return true;
+    }
+
+    // Sphere (c, r) in the mesh's frame against the mesh; results are in the mesh's frame.
+    // motion is the sphere's velocity there, which picks the side when the centre lies in a
+    // triangle's plane.
+    static bool sphereMesh(const TriangleMesh* mesh, const Vector3& c, const Vector3& motion,
+                           float r, Vector3& point, Vector3& normal, float& penetration)
+    {
+        // Nearest triangle within the radius
+        float bestDist2 = r * r;
+        bool found = false;
+        Vector3 best, bestFaceNormal;
+        mesh->query(AABB::fromCenter(c, Vector3(r, r, r)),
+                    [&](uint32_t t)
+                    {
+                        Vector3 tri[3];
+                        mesh->triangle(t, tri);
+                        Vector3 q = closestPointOnTriangle(c, tri[0], tri[1], tri[2]);
+                        float d2 = (c - q).magnitudeSquared();
+                        if (d2 < bestDist2)
+                        {
+                            bestDist2 = d2;
+                            best = q;
+                            bestFaceNormal = (tri[1] - tri[0]).cross(tri[2] - tri[0]);
+                            found = true;
+                        }
+                    });
+        if (!found)
+            return false;
+
+        float dist = std::sqrt(bestDist2);
+        if (dist < 1e-6f)
+        {
+            // Centre on the triangle: back out against the motion
+            bestFaceNormal.normalize();
+            normal = bestFaceNormal.dot(motion) > 0.0f ? bestFaceNormal * -1.0f : bestFaceNormal;
+            penetration = r;
+        }
+        else
+        {
+            normal = (c - best) * (1.0f / dist);
+            penetration = r - dist;
+        }
+
+        point = best;
+        return true;
+    }
+
+    // Shared box/cylinder/polyhedron test: hull points below the surface, plus terrain
+    // vertices that poke into the body between its hull points (peaks under a wide box)
+    template <typename Inside>
+    static bool checkHullHeightfield(RigidBody* body, const Vector3* localPoints, int count,
+                                     Inside inside, const Heightfield& terrain, Contact& contact)
+    {
+        float maxPenetration = 0.0f;
+        Vector3 pointSum(0, 0, 0);
+        Vector3 normalSum(0, 0, 0);
+        int contactCount = 0;
+
+        Vector3 lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f);
+        for (int i = 0; i < count; i++)
+        {
+            Vector3 p = toWorld(body, localPoints[i]);
+            lo = Vector3(std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z));
+            hi = Vector3(std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z));
+
+            float h;
+            Vector3 n;
+            if (!terrain.surfaceAt(p.x, p.z, h, n) || p.y >= h)
+                continue;
+            // Depth along the normal of the triangle under the point
+            float pen = (h - p.y) * n.y;
+            maxPenetration = std::max(maxPenetration, pen);
+            pointSum += p;
+            normalSum += n * pen;
+            contactCount++;
+        }
+        if (lo.y > terrain.getMaxHeight())
+            return false;
+
+        int x0, z0, x1, z1;
+        if (terrain.cellRange(lo.x, lo.z, hi.x, hi.z, x0, z0, x1, z1))
+        {
+            for (int z = z0; z <= z1 + 1; z++)
+            {
+                for (int x = x0; x <= x1 + 1; x++)
+                {
+                    Vector3 v = terrain.vertex(x, z);
+                    if (v.y <= lo.y || !inside(toLocal(body, v)))
+                        continue;
+                    float h;
+                    Vector3 n;
+                    if (!terrain.surfaceAt(v.x, v.z, h, n))
+                        n = Vector3(0, 1, 0);
+                    // The body has to rise until its lowest point clears the vertex
+                    float pen = v.y - lo.y;
+                    maxPenetration = std::max(maxPenetration, pen);
+                    pointSum += v;
+                    normalSum += n * pen;
+                    contactCount++;
+                }
+            }
+        }
+
+        if (contactCount == 0)
+            return false;
+        normalSum.normalize();
+        contact.a = body;
+        contact.b = nullptr;
+        contact.normal = normalSum;
+        contact.penetration = maxPenetration;
+        contact.point = pointSum * (1.0f / contactCount);
+        return true;
+    }
+
+    // Shared box/cylinder/polyhedron mesh test. Each triangle faces the side the body's
+    // centre is on; a hull point behind it (by less than the body's size) is pushed out
+    // through the nearest such triangle, so points resting on a floor do not also pick up
+    // the triangles under it.
+    static bool checkHullMesh(RigidBody* body, const Vector3* localPoints, int count,
+                              RigidBody* meshBody, Contact& contact)
+    {
+        static const int MAX_POINTS = 64;
+        static_assert(Cylinder::POINT_COUNT <= MAX_POINTS, "raise MAX_POINTS");
+        static_assert(ConvexHull::MAX_VERTICES <= MAX_POINTS, "raise MAX_POINTS");
+        const TriangleMesh* mesh = (const TriangleMesh*)meshBody->shape;
+
+        Vector3 points[MAX_POINTS];
+        float depth[MAX_POINTS];
+        Vector3 normals[MAX_POINTS];
+        Vector3 lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f);
+        for (int i = 0; i < count; i++)
+        {
+            points[i] = toLocal(meshBody, toWorld(body, localPoints[i]));
+            depth[i] = 1e30f;
+            lo = Vector3(std::min(lo.x, points[i].x), std::min(lo.y, points[i].y),
+                         std::min(lo.z, points[i].z));
+            hi = Vector3(std::max(hi.x, points[i].x), std::max(hi.y, points[i].y),
+                         std::max(hi.z, points[i].z));
+        }
+        float maxDepth = body->shape->boundingRadius;
+        Vector3 center = toLocal(meshBody, body->position);
+
+        mesh->query(AABB(lo, hi),
+                    [&](uint32_t t)
+                    {
+                        Vector3 tri[3];
+                        mesh->triangle(t, tri);
+                        Vector3 face = (tri[1] - tri[0]).cross(tri[2] - tri[0]);
+                        float len = face.magnitude();
+                        if (len < 1e-12f)
+                            return;
+                        face *= 1.0f / len;
+                        Vector3 n = face.dot(center - tri[0]) < 0.0f ? face * -1.0f : face;
+                        for (int i = 0; i < count; i++)
+                        {
+                            float d = -n.dot(points[i] - tri[0]);
+                            if (d <= 0.0f || d > maxDepth || d >= depth[i])
+                                continue;
+                            if (!insideTriangle(points[i] + n * d, tri, face))
+                                continue;
+                            depth[i] = d;
+                            normals[i] = n;
+                        }
+                    });
+
+        float maxPenetration = 0.0f;
+        Vector3 pointSum(0, 0, 0);
+        Vector3 normalSum(0, 0, 0);
+        int contactCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (depth[i] == 1e30f)
+                continue;
+            maxPenetration = std::max(maxPenetration, depth[i]);
+            pointSum += points[i];
+            normalSum += normals[i] * depth[i];
+            contactCount++;
+        }
+        if (contactCount == 0)
+            return false;
+
+        normalSum.normalize();
+        contact.a = body;
+        contact.b = meshBody;
+        contact.normal = meshBody->orientation.rotate(normalSum);
+        contact.penetration = maxPenetration;
+        contact.point = toWorld(meshBody, pointSum * (1.0f / contactCount));
+        return true;
+    }
+
+    // p lies in the plane of tri (normal n); edge tests against the counter-clockwise
+    // winding
+    static bool insideTriangle(const Vector3& p, const Vector3 tri[3], const Vector3& n)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const Vector3& a = tri[k];
+            const Vector3& b = tri[(k + 1) % 3];
+            if ((b - a).cross(p - a).dot(n) < 0.0f)
+                return false;
+        }
+        return true;
+    }
 };
@@ -0,0 +1,84 @@
+#pragma once
+#include "RigidBody.h"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+// Decides which broadphase candidates reach the narrowphase. Bodies collide only when
+// each one's category is in the other's mask, and never when both are static. Pairs can
+// also be excluded explicitly (bodies joined by a constraint are, by default); exclusions
+// are reference counted, and the hash lookup only happens when both bodies have one.
+class CollisionFilter
+{
+public:
+    bool shouldCollide(const RigidBody& a, uint32_t handleA, const RigidBody& b,
+                       uint32_t handleB) const
+    {
+        if (!a.hasFiniteMass() && !b.hasFiniteMass())
+            return false;
+        if (!(a.collisionCategory & b.collisionMask) || !(b.collisionCategory & a.collisionMask))
+            return false;
+        if (a.ignoredPairs == 0 || b.ignoredPairs == 0)
+            return true;
+        return ignored.find(key(handleA, handleB)) == ignored.end();
+    }
+
+    void ignore(RigidBody& a, uint32_t handleA, RigidBody& b, uint32_t handleB)
+    {
+        if (handleA == handleB)
+            return;
+        if (++ignored[key(handleA, handleB)] == 1)
+        {
+            a.ignoredPairs++;
+            b.ignoredPairs++;
+        }
+    }
+
+    // Drops one exclusion; returns false if the pair was not excluded
+    bool restore(RigidBody& a, uint32_t handleA, RigidBody& b, uint32_t handleB)
+    {
+        auto it = ignored.find(key(handleA, handleB));
+        if (it == ignored.end())
+            return false;
+        if (--it->second == 0)
+        {
+            ignored.erase(it);
+            a.ignoredPairs--;
+            b.ignoredPairs--;
+        }
+        return true;
+    }
+
+    // Forgets every exclusion involving a body that is being removed
+    template <typename Bodies>
+    void removeBody(uint32_t handle, Bodies& bodies)
+    {
+        if (bodies.get(handle)->ignoredPairs == 0)
+            return;
+        for (auto it = ignored.begin(); it != ignored.end();)
+        {
+            uint32_t lo = (uint32_t)it->first;
+            uint32_t hi = (uint32_t)(it->first >> 32);
+            if (lo != handle && hi != handle)
+            {
+                ++it;
+                continue;
+            }
+            if (RigidBody* other = bodies.get(lo == handle ? hi : lo))
+                other->ignoredPairs--;
+            it = ignored.erase(it);
+        }
+    }
+
+    void clear() { ignored.clear(); }
+
+private:
+    std::unordered_map<uint64_t, uint32_t> ignored;
+
+    static uint64_t key(uint32_t a, uint32_t b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return ((uint64_t)b << 32) | a;
+    }
+};
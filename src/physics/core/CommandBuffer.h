@@ -0,0 +1,102 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+enum BodyCommandType : uint32_t
+{
+    COMMAND_FORCE = 0,            // x, y, z: force, as applyForce
+    COMMAND_IMPULSE = 1,          // x, y, z: linear impulse through the centre of mass
+    COMMAND_TORQUE = 2,           // x, y, z: torque, accumulated like a force
+    COMMAND_VELOCITY = 3,         // x, y, z: linear velocity
+    COMMAND_ANGULAR_VELOCITY = 4, // x, y, z: angular velocity
+    COMMAND_FRICTION = 5,         // x: friction coefficient
+    COMMAND_RESTITUTION = 6,      // x: restitution
+    COMMAND_WAKE = 7,
+    COMMAND_SLEEP = 8,
+    COMMAND_TYPE_COUNT = 9
+};
+
+// One record of the ring. Every field is 4 bytes, so JS writes it through a Uint32Array
+// and a Float32Array over the same memory.
+struct BodyCommand
+{
+    uint32_t type;
+    uint32_t handle;
+    float x, y, z;
+};
+
+static_assert(sizeof(BodyCommand) == 5 * sizeof(uint32_t), "BodyCommand must stay packed");
+
+// Single-producer ring of per-body edits, written from JS (or natively through push) and
+// drained by the world in one pass. The memory starts with HEADER_WORDS words,
+// [head, tail, capacity, 0], followed by capacity records. head and tail are free-running
+// counts of written and applied commands; the producer writes record head % capacity and
+// then bumps head, the world moves tail up to head when it applies them. A full ring
+// (head - tail == capacity) takes no more commands until the world drains it.
+class CommandRing
+{
+public:
+    static constexpr uint32_t HEADER_WORDS = 4;
+    static constexpr uint32_t STRIDE = sizeof(BodyCommand) / sizeof(uint32_t);
+
+    explicit CommandRing(uint32_t capacity = 1024) { allocate(capacity); }
+
+    // Replaces the storage, so JS views of the old one go stale; pending commands are lost.
+    // The capacity is rounded up to a power of two, so the counters can wrap around.
+    void allocate(uint32_t capacity)
+    {
+        ringCapacity = 1;
+        while (ringCapacity < capacity && ringCapacity < (1u << 24))
+            ringCapacity <<= 1;
+        words.assign(HEADER_WORDS + (size_t)ringCapacity * STRIDE, 0);
+        words[CAPACITY] = ringCapacity;
+    }
+
+    bool push(uint32_t type, uint32_t handle, float x, float y, float z)
+    {
+        uint32_t head = words[HEAD];
+        if (head - words[TAIL] >= capacity())
+            return false;
+        BodyCommand command = {type, handle, x, y, z};
+        std::memcpy(&words[HEADER_WORDS + (size_t)(head % capacity()) * STRIDE], &command,
+                    sizeof(command));
+        words[HEAD] = head + 1;
+        return true;
+    }
+
+    // Commands written but not yet applied. A corrupted header (a producer that wrote
+    // past a full ring) counts as at most one full ring.
+    uint32_t pending() const { return std::min(words[HEAD] - words[TAIL], capacity()); }
+
+    // The i-th pending command, oldest first
+    BodyCommand at(uint32_t i) const
+    {
+        BodyCommand command;
+        uint32_t slot = (words[TAIL] + i) % capacity();
+        std::memcpy(&command, &words[HEADER_WORDS + (size_t)slot * STRIDE], sizeof(command));
+        return command;
+    }
+
+    // Marks every pending command applied
+    void consume() { words[TAIL] = words[HEAD]; }
+
+    // The header copy is for the producer; this one is what the ring trusts
+    uint32_t capacity() const { return ringCapacity; }
+
+    const uint32_t* data() const { return words.data(); }
+    uint32_t* data() { return words.data(); }
+    size_t size() const { return words.size(); }
+
+private:
+    enum : uint32_t
+    {
+        HEAD = 0,
+        TAIL = 1,
+        CAPACITY = 2
+    };
+
+    std::vector<uint32_t> words;
+    uint32_t ringCapacity = 0;
+};
@@ -1,47 +1,114 @@
 #pragma once
 #include "RigidBody.h"
 
+// Distance constraint between two anchor points, solved with XPBD
+// (extended position based dynamics). Corrections are applied to both the
+// position and the orientation of each body, and the velocity change is
+// derived from the position change so no artificial damping is needed.
 class Constraint
 {
 public:
+    // Resolved from the handles by the world whenever body storage moves
     RigidBody* bodyA;
     RigidBody* bodyB;
-    Vector3 anchorA; 
-    Vector3 anchorB; 
+    uint32_t bodyHandleA = 0;
+    uint32_t bodyHandleB = 0;
+    // Next constraint (handle) in bodyA's and bodyB's attachment lists
+    uint32_t nextA = 0;
+    uint32_t nextB = 0;
+    Vector3 anchorA; // local space of bodyA
+    Vector3 anchorB; // local space of bodyB
     float length;
 
+    // Inverse stiffness in m/N. Zero gives a rigid rod, larger values a softer spring.
+    float compliance = 0.0f;
+
+    // Lagrange multiplier accumulated over the iterations of one substep
+    float lambda = 0.0f;
+
+    // Whether the two bodies still collide with each other. Off by default, like most
+    // engines' joints: a chain's links overlap at their anchors by design.
+    bool collideConnected = false;
+
     Constraint(RigidBody* a, RigidBody* b, float len) : bodyA(a), bodyB(b), length(len)
     {
         anchorA = Vector3(0, 0, 0);
         anchorB = Vector3(0, 0, 0);
     }
 
-    void resolve()
+    // A constraint only needs solving while one of its dynamic bodies is moving
+    bool isActive() const
+    {
+        return (bodyA->hasFiniteMass() && bodyA->isAwake) ||
+               (bodyB->hasFiniteMass() && bodyB->isAwake);
+    }
+
+    // One XPBD projection. Returns the absolute error before the correction.
+    float solve(float dt, float wakeThreshold)
     {
-        Vector3 worldA = bodyA->position + bodyA->orientation.rotate(anchorA);
-        Vector3 worldB = bodyB->position + bodyB->orientation.rotate(anchorB);
+        Vector3 rA = bodyA->orientation.rotate(anchorA);
+        Vector3 rB = bodyB->orientation.rotate(anchorB);
 
-        Vector3 delta = worldA - worldB;
+        Vector3 delta = (bodyA->position + rA) - (bodyB->position + rB);
         float currentLen = delta.magnitude();
         if (currentLen == 0.0f)
-            return;
+            return 0.0f;
 
         float error = currentLen - length;
-        float invMassSum = bodyA->inverseMass + bodyB->inverseMass;
-        if (invMassSum == 0.0f)
-            return;
+        float absError = std::abs(error);
 
-        Vector3 correction = delta * (error / currentLen / invMassSum);
-
-        if (bodyA->hasFiniteMass() && bodyA->isAwake)
-        {
-            bodyA->position = bodyA->position - correction * bodyA->inverseMass;
-            bodyA->velocity *= 0.99f; 
-        }
-        if (bodyB->hasFiniteMass() && bodyB->isAwake)
+        // A sleeping body acts as an anchor until the constraint is pulled far enough
+        // to be worth waking it up.
+        if (absError > wakeThreshold)
         {
-            bodyB->position += correction * bodyB->inverseMass;
-            bodyB->velocity *= 0.99f;
+            if (bodyA->hasFiniteMass() && !bodyA->isAwake)
+                bodyA->setAwake(true);
+            if (bodyB->hasFiniteMass() && !bodyB->isAwake)
+                bodyB->setAwake(true);
         }
+
+        bool moveA = bodyA->hasFiniteMass() && bodyA->isAwake;
+        bool moveB = bodyB->hasFiniteMass() && bodyB->isAwake;
+
+        Vector3 n = delta * (1.0f / currentLen);
+        Vector3 rAxn = rA.cross(n);
+        Vector3 rBxn = rB.cross(n);
+
+        float wA = moveA ? bodyA->inverseMass + rAxn.dot(bodyA->inverseInertiaTensorWorld * rAxn)
+                         : 0.0f;
+        float wB = moveB ? bodyB->inverseMass + rBxn.dot(bodyB->inverseInertiaTensorWorld * rBxn)
+                         : 0.0f;
+
+        float alpha = compliance / (dt * dt);
+        float denom = wA + wB + alpha;
+        if (denom == 0.0f)
+            return absError;
+
+        float deltaLambda = (-error - alpha * lambda) / denom;
+        lambda += deltaLambda;
+
+        Vector3 p = n * deltaLambda;
+        float invDt = 1.0f / dt;
+
+        if (moveA)
+            applyCorrection(bodyA, rA, p, invDt);
+        if (moveB)
+            applyCorrection(bodyB, rB, p * -1.0f, invDt);
+
+        return absError;
+    }
+
+private:
+    static void applyCorrection(RigidBody* body, const Vector3& r, const Vector3& p, float invDt)
+    {
+        Vector3 dx = p * body->inverseMass;
+        Vector3 dTheta = body->inverseInertiaTensorWorld * r.cross(p);
+
+        body->position += dx;
+        body->orientation.addScaledVector(dTheta, 1.0f);
+        body->orientation.normalize();
+
+        body->velocity += dx * invDt;
+        body->angularVelocity += dTheta * invDt;
     }
-};
\ No newline at end of file
+};
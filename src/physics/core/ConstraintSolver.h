@@ -0,0 +1,64 @@
+#pragma once
+#include "Constraint.h"
+#include "FrameAllocator.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Gauss-Seidel loop over the XPBD constraints of one substep. Iterates until the
+// largest constraint error and the largest impulse change both drop under their
+// tolerances, or the iteration cap is hit.
+class ConstraintSolver
+{
+public:
+    int maxIterations = 5;
+    float tolerance = 1e-4f;
+    // Change of a constraint's impulse (lambda / dt) within one iteration, N s
+    float impulseTolerance = 1e-3f;
+    // Error a constraint needs before it wakes up a sleeping body
+    float wakeThreshold = 0.01f;
+
+    // Stats from the last solve
+    int iterationsUsed = 0;
+    float maxError = 0.0f;
+    float maxImpulseChange = 0.0f;
+
+    void solve(std::vector<Constraint*>& constraints, float dt, FrameAllocator& frame)
+    {
+        iterationsUsed = 0;
+        maxError = 0.0f;
+        maxImpulseChange = 0.0f;
+
+        FrameVector<Constraint*> active{FrameAllocatorAdapter<Constraint*>(frame)};
+        active.reserve(constraints.size());
+        for (auto c : constraints)
+        {
+            if (c->isActive())
+            {
+                c->lambda = 0.0f;
+                active.push_back(c);
+            }
+        }
+        if (active.empty())
+            return;
+
+        for (int i = 0; i < maxIterations; i++)
+        {
+            float iterationError = 0.0f;
+            float iterationChange = 0.0f;
+            for (auto c : active)
+            {
+                float lambda = c->lambda;
+                iterationError = std::max(iterationError, c->solve(dt, wakeThreshold));
+                iterationChange = std::max(iterationChange, std::abs(c->lambda - lambda));
+            }
+
+            iterationsUsed++;
+            maxError = iterationError;
+            // lambda is a position-level multiplier; over the substep it is impulse * dt
+            maxImpulseChange = iterationChange / dt;
+            if (iterationError < tolerance && maxImpulseChange < impulseTolerance)
+                break;
+        }
+    }
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "Vector3.h"
 #include "RigidBody.h"
+#include <cstdint>
 
 struct Contact {
     RigidBody* a;
@@ -9,4 +10,16 @@ struct Contact {
     Vector3 point;
     Vector3 normal;
     float penetration;
-};
\ No newline at end of file
+
+    // Solver state, accumulated over the velocity passes of one substep
+    float normalImpulse = 0.0f;
+    Vector3 frictionImpulse;
+    // Normal velocity restitution asks for, fixed by the first pass
+    float targetVelocity = 0.0f;
+};
+
+// Candidate pair from the broadphase, as dense body indices
+struct BodyPair {
+    uint32_t a;
+    uint32_t b;
+};
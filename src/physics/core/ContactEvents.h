@@ -0,0 +1,188 @@
+#pragma once
+#include "Vector3.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+enum ContactEventType : uint32_t
+{
+    CONTACT_BEGIN = 0,
+    CONTACT_PERSIST = 1,
+    CONTACT_END = 2
+};
+
+// One record of the flat event stream handed to JS. Every field is 4 bytes, so the buffer
+// can be read through a Float32Array (and a Uint32Array over the same memory for the
+// first three words).
+struct ContactEvent
+{
+    uint32_t type;
+    uint32_t handleA;
+    uint32_t handleB; // 0 for the floor
+    float px, py, pz;
+    float nx, ny, nz; // pushes A away from B
+    float impulse;    // summed normal impulse over the frame
+};
+
+static_assert(sizeof(ContactEvent) == 10 * sizeof(uint32_t), "ContactEvent must stay packed");
+
+// Turns the contacts of one step into begin/persist/end events. Touching pairs are
+// gathered in a flat list while the substeps run, then sorted and merge-joined against
+// the previous frame's list, so no per-pair maps or JS callbacks are needed and all the
+// buffers keep their capacity from frame to frame.
+class ContactEventRecorder
+{
+public:
+    bool enabled = false;
+    // Begin events below this impulse are dropped (and so is the matching end event)
+    float beginThreshold = 0.1f;
+    // Persist events are only sent for impulses at least this large, so resting contacts
+    // stay silent
+    float persistThreshold = 1.0f;
+
+    ContactEventRecorder()
+    {
+        touching.reserve(256);
+        previous.reserve(256);
+        events.reserve(256);
+    }
+
+    void beginFrame()
+    {
+        events.clear();
+        std::swap(touching, previous);
+        touching.clear();
+    }
+
+    void record(uint32_t handleA, uint32_t handleB, const Vector3& point, const Vector3& normal,
+                float impulse)
+    {
+        // Store pairs with the smaller handle first; flip the normal to match
+        Vector3 n = normal;
+        if (handleB != 0 && handleB < handleA)
+        {
+            std::swap(handleA, handleB);
+            n = n * -1.0f;
+        }
+        touching.push_back(Touch{key(handleA, handleB), point, n, impulse, impulse, false});
+    }
+
+    // Builds the frame's events. stillTouching(handleA, handleB) decides whether a pair
+    // that produced no contact this frame is only resting (both sides asleep) rather than
+    // separated; such pairs are carried over without an event.
+    template <typename StillTouching>
+    void endFrame(StillTouching stillTouching)
+    {
+        std::sort(touching.begin(), touching.end(),
+                  [](const Touch& x, const Touch& y) { return x.key < y.key; });
+
+        // Merge the substep and multi-contact records of each pair
+        size_t out = 0;
+        for (size_t i = 0; i < touching.size(); i++)
+        {
+            if (out > 0 && touching[out - 1].key == touching[i].key)
+            {
+                Touch& t = touching[out - 1];
+                t.impulse += touching[i].impulse;
+                if (touching[i].peak > t.peak)
+                {
+                    t.peak = touching[i].peak;
+                    t.point = touching[i].point;
+                    t.normal = touching[i].normal;
+                }
+            }
+            else
+            {
+                touching[out++] = touching[i];
+            }
+        }
+        touching.resize(out);
+
+        size_t count = touching.size();
+        size_t i = 0, j = 0;
+        while (i < count || j < previous.size())
+        {
+            if (j == previous.size() || (i < count && touching[i].key < previous[j].key))
+            {
+                Touch& t = touching[i++];
+                t.reported = t.impulse >= beginThreshold;
+                if (t.reported)
+                    emit(CONTACT_BEGIN, t);
+            }
+            else if (i == count || previous[j].key < touching[i].key)
+            {
+                Touch& p = previous[j++];
+                if (stillTouching(handleA(p.key), handleB(p.key)))
+                {
+                    p.impulse = 0.0f;
+                    touching.push_back(p);
+                }
+                else if (p.reported)
+                {
+                    p.impulse = 0.0f;
+                    emit(CONTACT_END, p);
+                }
+            }
+            else
+            {
+                Touch& t = touching[i++];
+                const Touch& p = previous[j++];
+                t.reported = p.reported;
+                if (!t.reported && t.impulse >= beginThreshold)
+                {
+                    t.reported = true;
+                    emit(CONTACT_BEGIN, t);
+                }
+                else if (t.reported && t.impulse >= persistThreshold)
+                {
+                    emit(CONTACT_PERSIST, t);
+                }
+            }
+        }
+
+        // Carried-over pairs were appended out of order
+        if (touching.size() > count)
+        {
+            std::inplace_merge(touching.begin(), touching.begin() + count, touching.end(),
+                               [](const Touch& x, const Touch& y) { return x.key < y.key; });
+        }
+    }
+
+    void clear()
+    {
+        touching.clear();
+        previous.clear();
+        events.clear();
+    }
+
+    const std::vector<ContactEvent>& getEvents() const { return events; }
+    ContactEvent* data() { return events.data(); }
+    const ContactEvent* data() const { return events.data(); }
+    size_t size() const { return events.size(); }
+
+private:
+    struct Touch
+    {
+        uint64_t key;
+        Vector3 point;
+        Vector3 normal;
+        float impulse; // summed over the frame
+        float peak;    // largest single contribution; its point and normal are reported
+        bool reported; // a begin event was sent, so an end event is owed
+    };
+
+    std::vector<Touch> touching;
+    std::vector<Touch> previous;
+    std::vector<ContactEvent> events;
+
+    static uint64_t key(uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; }
+    static uint32_t handleA(uint64_t key) { return (uint32_t)(key >> 32); }
+    static uint32_t handleB(uint64_t key) { return (uint32_t)key; }
+
+    void emit(ContactEventType type, const Touch& t)
+    {
+        events.push_back(ContactEvent{type, handleA(t.key), handleB(t.key), t.point.x,
+                                      t.point.y, t.point.z, t.normal.x, t.normal.y,
+                                      t.normal.z, t.impulse});
+    }
+};
@@ -3,135 +3,126 @@
 #include <algorithm>
 #include <cmath>
 
+// Impulses and position correction for one contact. The contact solver calls
+// resolveVelocity once per pass; impulses accumulate on the contact and are clamped as
+// totals, so a later pass can take back part of what an earlier one over-applied.
 class ContactResolver
 {
 public:
-    static void resolve(Contact& contact)
+    // One velocity pass. The first wakes the bodies and fixes the restitution target.
+    // Returns the largest change to the accumulated normal or friction impulse, and the
+    // normal velocity error the pass found in error.
+    static float resolveVelocity(Contact& contact, bool first, float& error)
     {
+        error = 0.0f;
         RigidBody* bodyA = contact.a;
         RigidBody* bodyB = contact.b;
 
         if (!bodyA->isAwake && (!bodyB || !bodyB->isAwake))
         {
-            return;
+            return 0.0f;
         }
 
-        if (bodyA->hasFiniteMass() && !bodyA->isAwake)
-        {
-            bodyA->setAwake(true);
-        }
-        if (bodyB && bodyB->hasFiniteMass() && !bodyB->isAwake)
+        if (first)
         {
-            bodyB->setAwake(true);
+            if (bodyA->hasFiniteMass() && !bodyA->isAwake)
+            {
+                bodyA->setAwake(true);
+            }
+            if (bodyB && bodyB->hasFiniteMass() && !bodyB->isAwake)
+            {
+                bodyB->setAwake(true);
+            }
         }
 
         Vector3 rA = contact.point - bodyA->position;
         Vector3 rB = bodyB ? (contact.point - bodyB->position) : Vector3(0, 0, 0);
 
-        Vector3 velA = bodyA->velocity + bodyA->angularVelocity.cross(rA);
-        Vector3 velB =
-            bodyB ? (bodyB->velocity + bodyB->angularVelocity.cross(rB)) : Vector3(0, 0, 0);
-
-        Vector3 relativeVelocity = velA - velB;
-
+        Vector3 relativeVelocity = relativeVelocityAt(contact, rA, rB);
         float velocityAlongNormal = relativeVelocity.dot(contact.normal);
 
-        if (velocityAlongNormal > 0)
-            return;
-
-        float invMassSum = bodyA->inverseMass;
-        if (bodyB)
-            invMassSum += bodyB->inverseMass;
-
-        Vector3 rA_cross_n = rA.cross(contact.normal);
-        Vector3 ar = bodyA->inverseInertiaTensorWorld * rA_cross_n;
-        Vector3 angularFactorA = ar.cross(rA);
-        float angularCompA = angularFactorA.dot(contact.normal);
-
-        float angularCompB = 0;
-        if (bodyB)
+        if (first)
         {
-            Vector3 rB_cross_n = rB.cross(contact.normal);
-            Vector3 br = bodyB->inverseInertiaTensorWorld * rB_cross_n;
-            Vector3 angularFactorB = br.cross(rB);
-            angularCompB = angularFactorB.dot(contact.normal);
-        }
-
-        float totalInverseMass = invMassSum + angularCompA + angularCompB;
-
-        float e = bodyA->restitution;
-        if (bodyB)
-            e = std::min(e, bodyB->restitution);
+            float e = bodyA->restitution;
+            if (bodyB)
+                e = std::min(e, bodyB->restitution);
 
-        if (velocityAlongNormal > -2.0f)
-        {
-            e = 0.0f;
+            if (velocityAlongNormal > -2.0f)
+            {
+                e = 0.0f;
+            }
+            contact.targetVelocity = -e * velocityAlongNormal;
         }
-        float jn = -(1 + e) * velocityAlongNormal;
-        jn /= totalInverseMass;
 
-        Vector3 imp = contact.normal * jn;
+        // Approaching faster than the target is an error; so is separating faster while
+        // the accumulated impulse is still pushing
+        float violation = contact.targetVelocity - velocityAlongNormal;
+        error = contact.normalImpulse > 0.0f ? std::abs(violation) : std::max(violation, 0.0f);
 
-        bodyA->velocity += imp * bodyA->inverseMass;
+        float invMassSum = bodyA->inverseMass;
+        if (bodyB)
+            invMassSum += bodyB->inverseMass;
 
-        bodyA->angularVelocity += bodyA->inverseInertiaTensorWorld * rA.cross(imp);
+        float totalInverseMass =
+            invMassSum + angularComponent(bodyA, rA, contact.normal) +
+            (bodyB ? angularComponent(bodyB, rB, contact.normal) : 0.0f);
+        if (totalInverseMass <= 0.0f)
+            return 0.0f;
 
-        if (bodyB)
-        {
-            bodyB->velocity = bodyB->velocity - (imp * bodyB->inverseMass);
-            bodyB->angularVelocity =
-                bodyB->angularVelocity - (bodyB->inverseInertiaTensorWorld * rB.cross(imp));
-        }
+        float jn = violation / totalInverseMass;
+        float oldNormal = contact.normalImpulse;
+        contact.normalImpulse = std::max(oldNormal + jn, 0.0f);
+        jn = contact.normalImpulse - oldNormal;
+        applyImpulse(contact, rA, rB, contact.normal * jn);
 
-        velA = bodyA->velocity + bodyA->angularVelocity.cross(rA);
-        velB = bodyB ? (bodyB->velocity + bodyB->angularVelocity.cross(rB)) : Vector3(0, 0, 0);
-        relativeVelocity = velA - velB;
+        relativeVelocity = relativeVelocityAt(contact, rA, rB);
 
         Vector3 tangent =
             relativeVelocity - (contact.normal * relativeVelocity.dot(contact.normal));
         float tangentMag = tangent.magnitude();
 
+        float frictionChange = 0.0f;
         if (tangentMag > 0.001f)
         {
             tangent = tangent * (1.0f / tangentMag);
 
-            Vector3 rA_cross_t = rA.cross(tangent);
-            Vector3 ar_t = bodyA->inverseInertiaTensorWorld * rA_cross_t;
-            float angularCompA_t = ar_t.cross(rA).dot(tangent);
-
-            float angularCompB_t = 0;
-            if (bodyB)
-            {
-                Vector3 rB_cross_t = rB.cross(tangent);
-                Vector3 br_t = bodyB->inverseInertiaTensorWorld * rB_cross_t;
-                angularCompB_t = br_t.cross(rB).dot(tangent);
-            }
-
-            float frictionMass = invMassSum + angularCompA_t + angularCompB_t;
+            float frictionMass = invMassSum + angularComponent(bodyA, rA, tangent) +
+                                 (bodyB ? angularComponent(bodyB, rB, tangent) : 0.0f);
 
             float jf = -relativeVelocity.dot(tangent);
             jf /= frictionMass;
 
+            // Coulomb cone on the accumulated friction
             float mu = bodyA->friction;
-            float maxFriction = mu * jn;
-            if (std::abs(jf) > maxFriction)
+            float maxFriction = mu * contact.normalImpulse;
+            Vector3 oldFriction = contact.frictionImpulse;
+            Vector3 friction = oldFriction + tangent * jf;
+            float frictionMag = friction.magnitude();
+            if (frictionMag > maxFriction)
             {
-                jf = (jf > 0) ? maxFriction : -maxFriction;
+                friction = frictionMag > 0.0f ? friction * (maxFriction / frictionMag)
+                                              : Vector3(0, 0, 0);
             }
+            contact.frictionImpulse = friction;
 
-            Vector3 frictionImpulse = tangent * jf;
+            Vector3 frictionImpulse = friction - oldFriction;
+            frictionChange = frictionImpulse.magnitude();
+            applyImpulse(contact, rA, rB, frictionImpulse);
+        }
 
-            bodyA->velocity += frictionImpulse * bodyA->inverseMass;
-            bodyA->angularVelocity += bodyA->inverseInertiaTensorWorld * rA.cross(frictionImpulse);
+        return std::max(std::abs(jn), frictionChange);
+    }
 
-            if (bodyB)
-            {
-                bodyB->velocity = bodyB->velocity - (frictionImpulse * bodyB->inverseMass);
-                bodyB->angularVelocity =
-                    bodyB->angularVelocity -
-                    (bodyB->inverseInertiaTensorWorld * rB.cross(frictionImpulse));
-            }
-        }
+    // Pushes the bodies apart along the normal, once per substep after the velocity
+    // passes. Contacts that ended up with no normal impulse (separating, or asleep) are
+    // left to their velocity.
+    static void correctPosition(Contact& contact)
+    {
+        if (contact.normalImpulse <= 0.0f)
+            return;
+
+        RigidBody* bodyA = contact.a;
+        RigidBody* bodyB = contact.b;
 
         const float percent = 0.4f;
         const float slop = 0.01f;
@@ -156,4 +147,41 @@ public:
             }
         }
     }
+
+private:
+    static Vector3 relativeVelocityAt(const Contact& contact, const Vector3& rA,
+                                      const Vector3& rB)
+    {
+        const RigidBody* bodyA = contact.a;
+        const RigidBody* bodyB = contact.b;
+        Vector3 velA = bodyA->velocity + bodyA->angularVelocity.cross(rA);
+        Vector3 velB =
+            bodyB ? (bodyB->velocity + bodyB->angularVelocity.cross(rB)) : Vector3(0, 0, 0);
+        return velA - velB;
+    }
+
+    // Effective inverse mass that rotation about the centre adds along a direction
+    static float angularComponent(const RigidBody* body, const Vector3& r, const Vector3& dir)
+    {
+        Vector3 r_cross_d = r.cross(dir);
+        Vector3 ar = body->inverseInertiaTensorWorld * r_cross_d;
+        return ar.cross(r).dot(dir);
+    }
+
+    static void applyImpulse(Contact& contact, const Vector3& rA, const Vector3& rB,
+                             const Vector3& imp)
+    {
+        RigidBody* bodyA = contact.a;
+        RigidBody* bodyB = contact.b;
+
+        bodyA->velocity += imp * bodyA->inverseMass;
+        bodyA->angularVelocity += bodyA->inverseInertiaTensorWorld * rA.cross(imp);
+
+        if (bodyB)
+        {
+            bodyB->velocity = bodyB->velocity - (imp * bodyB->inverseMass);
+            bodyB->angularVelocity =
+                bodyB->angularVelocity - (bodyB->inverseInertiaTensorWorld * rB.cross(imp));
+        }
+    }
 };
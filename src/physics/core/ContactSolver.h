@@ -0,0 +1,83 @@
+#pragma once
+#include "ContactResolver.h"
+#include "FrameAllocator.h"
+#include <algorithm>
+#include <cstdint>
+
+// Sequential-impulse passes over the contacts of one substep. Passes repeat until the
+// largest normal velocity error and the largest impulse change both drop under their
+// tolerances, or the iteration cap is hit; position correction runs once at the end.
+//
+// When no dynamic body is in more than one contact, the contacts cannot disturb each
+// other and the first pass is already exact, so a scene of bodies resting on the floor
+// costs a single pass.
+class ContactSolver
+{
+public:
+    int maxIterations = 4;
+    // Normal velocity error, m/s
+    float velocityTolerance = 1e-3f;
+    // Change of a contact's accumulated impulse, N s
+    float impulseTolerance = 1e-3f;
+
+    // Stats from the last solve; the errors are those the final pass found
+    int iterationsUsed = 0;
+    float maxError = 0.0f;
+    float maxImpulseChange = 0.0f;
+
+    // bodies/bodyCount is the body storage the contacts point into
+    template <typename Contacts>
+    void solve(Contacts& contacts, const RigidBody* bodies, size_t bodyCount,
+               FrameAllocator& frame)
+    {
+        iterationsUsed = 0;
+        maxError = 0.0f;
+        maxImpulseChange = 0.0f;
+        if (contacts.empty())
+            return;
+
+        bool coupled = false;
+        if (maxIterations > 1)
+        {
+            FrameVector<uint8_t> touching(bodyCount, 0, FrameAllocatorAdapter<uint8_t>(frame));
+            auto count = [&](const RigidBody* body)
+            {
+                if (body && body->hasFiniteMass() && touching[body - bodies]++)
+                    coupled = true;
+            };
+            for (const Contact& contact : contacts)
+            {
+                count(contact.a);
+                count(contact.b);
+            }
+        }
+
+        int iterations = coupled ? maxIterations : 1;
+        for (int i = 0; i < iterations; i++)
+        {
+            float iterationError = 0.0f;
+            float iterationChange = 0.0f;
+            for (Contact& contact : contacts)
+            {
+                float error;
+                float change = ContactResolver::resolveVelocity(contact, i == 0, error);
+                iterationError = std::max(iterationError, error);
+                iterationChange = std::max(iterationChange, change);
+            }
+
+            iterationsUsed++;
+            maxError = iterationError;
+            maxImpulseChange = iterationChange;
+            if (iterationError < velocityTolerance && iterationChange < impulseTolerance)
+                break;
+        }
+        if (!coupled)
+        {
+            maxError = 0.0f;
+            maxImpulseChange = 0.0f;
+        }
+
+        for (Contact& contact : contacts)
+            ContactResolver::correctPosition(contact);
+    }
+};
@@ -0,0 +1,681 @@
+#pragma once
+#include "Contact.h"
+#include "RigidBody.h"
+#include "../geometry/ConvexHull.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Simplex left by the last GJK run on a pair, as points in each body's local frame so it
+// can be re-posed next step, plus the hull vertices the support climbs ended on
+struct CachedSimplex
+{
+    int count = 0;
+    Vector3 a[4];
+    Vector3 b[4];
+    int hintA = 0;
+    int hintB = 0;
+    // GJK iterations of the run that produced it
+    int iterations = 0;
+};
+
+// Per-pair simplices carried from one narrowphase pass to the next. Like the contact
+// event recorder, this is two flat lists sorted by pair key rather than a map: a pass
+// looks pairs up in the previous list and appends to the next one, and pairs that were
+// not tested drop out.
+class SimplexCache
+{
+public:
+    void beginPass()
+    {
+        std::sort(next.begin(), next.end(),
+                  [](const Entry& x, const Entry& y) { return x.key < y.key; });
+        std::swap(previous, next);
+        next.clear();
+    }
+
+    const CachedSimplex* find(uint64_t key) const
+    {
+        auto it = std::lower_bound(previous.begin(), previous.end(), key,
+                                   [](const Entry& e, uint64_t k) { return e.key < k; });
+        return it != previous.end() && it->key == key ? &it->simplex : nullptr;
+    }
+
+    void store(uint64_t key, const CachedSimplex& simplex) { next.push_back(Entry{key, simplex}); }
+
+    void clear()
+    {
+        previous.clear();
+        next.clear();
+    }
+
+    static uint64_t key(uint32_t handleA, uint32_t handleB)
+    {
+        return ((uint64_t)handleA << 32) | handleB;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        CachedSimplex simplex;
+    };
+
+    std::vector<Entry> previous;
+    std::vector<Entry> next;
+};
+
+// Generic narrowphase for any pair of convex shapes, driven only by support functions:
+// GJK finds the distance between the shapes' cores, and EPA the penetration when the
+// cores overlap. Spheres and capsules enter as a point or segment core with a rounding
+// margin, so shallow contacts with them never need EPA. The world uses this when no
+// specialized pair routine exists (pyramids and hulls); the scene queries use it for
+// those shapes too.
+class ConvexCollider
+{
+public:
+    static bool isConvex(ShapeType type)
+    {
+        return type == SPHERE || type == BOX || type == CYLINDER || type == PYRAMID ||
+               type == CAPSULE || type == HULL;
+    }
+
+    // Contact between two convex bodies; the normal pushes a away from b. cache, if given,
+    // seeds GJK with last step's simplex and receives this step's.
+    static bool collide(RigidBody* a, RigidBody* b, Contact& contact,
+                        CachedSimplex* cache = nullptr)
+    {
+        Proxy A(a), B(b);
+        Simplex s;
+        s.count = 0;
+        if (cache)
+        {
+            A.hint = cache->hintA;
+            B.hint = cache->hintB;
+            for (int i = 0; i < cache->count; i++)
+            {
+                Vertex& v = s.v[s.count++];
+                v.a = A.toWorld(cache->a[i]);
+                v.b = B.toWorld(cache->b[i]);
+                v.w = v.a - v.b;
+            }
+        }
+        float margin = A.margin + B.margin;
+        int iterations;
+        Result result = gjk(A, B, margin, s, iterations);
+        if (cache)
+        {
+            cache->count = s.count;
+            for (int i = 0; i < s.count; i++)
+            {
+                cache->a[i] = A.toLocal(s.v[i].a);
+                cache->b[i] = B.toLocal(s.v[i].b);
+            }
+            cache->hintA = A.hint;
+            cache->hintB = B.hint;
+            cache->iterations = iterations;
+        }
+        if (result == SEPARATED)
+            return false;
+
+        Vector3 normal;
+        float depth;
+        Vector3 pointB;
+        if (result == WITHIN_MARGIN)
+        {
+            Vector3 pointA;
+            closestPoints(s, pointA, pointB);
+            Vector3 v = pointA - pointB;
+            float dist = v.magnitude();
+            if (dist >= margin)
+                return false;
+            normal = v * (1.0f / dist);
+            depth = margin - dist;
+        }
+        else if (fillTetrahedron(A, B, s) && epa(A, B, s, normal, depth, pointB))
+        {
+            depth += margin;
+        }
+        else
+        {
+            // Cores only touching: just the margins overlap
+            if (margin <= 0.0f)
+                return false;
+            Vector3 pointA;
+            closestPoints(s, pointA, pointB);
+            normal = a->position - b->position;
+            if (normal.magnitudeSquared() < 1e-12f)
+                normal = Vector3(0, 1, 0);
+            normal.normalize();
+            depth = margin;
+        }
+        contact.a = a;
+        contact.b = b;
+        contact.normal = normal;
+        contact.penetration = depth;
+        contact.point = pointB + normal * B.margin;
+        return true;
+    }
+
+    static bool overlap(const RigidBody* a, const RigidBody* b)
+    {
+        Proxy A(a), B(b);
+        Simplex s;
+        s.count = 0;
+        int iterations;
+        Result result = gjk(A, B, A.margin + B.margin, s, iterations);
+        if (result != WITHIN_MARGIN)
+            return result == OVERLAPPING;
+        Vector3 pointA, pointB;
+        closestPoints(s, pointA, pointB);
+        return (pointA - pointB).magnitude() <= A.margin + B.margin;
+    }
+
+    // Closest point of the body's solid to p; p itself when inside. Rounded shapes are
+    // handled exactly through their margin.
+    static Vector3 closestPoint(const RigidBody* body, const Vector3& p)
+    {
+        Proxy A(body), B(p);
+        Simplex s;
+        s.count = 0;
+        int iterations;
+        if (gjk(A, B, FULL_DISTANCE, s, iterations) == OVERLAPPING)
+            return p;
+        Vector3 pointA, pointB;
+        closestPoints(s, pointA, pointB);
+        Vector3 d = p - pointA;
+        float dist = d.magnitude();
+        if (dist <= A.margin)
+            return p;
+        return pointA + d * (A.margin / dist);
+    }
+
+private:
+    static const int MAX_ITERATIONS = 32;
+    // Margin that turns off GJK's early out, for queries that need the exact distance
+    static constexpr float FULL_DISTANCE = 1e18f;
+
+    // A body's core shape posed in world space, or a single point when shape is null
+    struct Proxy
+    {
+        const Shape* shape;
+        Vector3 position;
+        Quaternion orientation;
+        Quaternion inverse;
+        float margin = 0.0f;
+        int hint = 0;
+
+        Proxy(const RigidBody* body)
+            : shape(body->shape), position(body->position), orientation(body->orientation),
+              inverse(body->orientation)
+        {
+            inverse.invert();
+            if (shape->type == SPHERE)
+                margin = ((const Sphere*)shape)->radius;
+            else if (shape->type == CAPSULE)
+                margin = ((const Capsule*)shape)->radius;
+        }
+
+        Proxy(const Vector3& point) : shape(nullptr), position(point) {}
+
+        Vector3 toWorld(const Vector3& p) const { return position + orientation.rotate(p); }
+        Vector3 toLocal(const Vector3& p) const { return inverse.rotate(p - position); }
+
+        // Furthest point of the core along dir (world space)
+        Vector3 support(const Vector3& dir)
+        {
+            if (!shape)
+                return position;
+            Vector3 d = inverse.rotate(dir);
+            Vector3 p;
+            switch (shape->type)
+            {
+            case BOX:
+            {
+                Vector3 h = ((const Box*)shape)->halfExtents;
+                p = Vector3(d.x < 0.0f ? -h.x : h.x, d.y < 0.0f ? -h.y : h.y,
+                            d.z < 0.0f ? -h.z : h.z);
+                break;
+            }
+            case CYLINDER:
+            {
+                const Cylinder* c = (const Cylinder*)shape;
+                float r = std::sqrt(d.x * d.x + d.z * d.z);
+                float scale = r > 1e-9f ? c->radius / r : 0.0f;
+                p = Vector3(d.x * scale, d.y < 0.0f ? -c->halfHeight : c->halfHeight,
+                            d.z * scale);
+                break;
+            }
+            case CAPSULE:
+            {
+                float h = ((const Capsule*)shape)->halfLength;
+                p = Vector3(0, d.y < 0.0f ? -h : h, 0);
+                break;
+            }
+            case PYRAMID:
+            {
+                const Pyramid* pyramid = (const Pyramid*)shape;
+                int best = 0;
+                for (int i = 1; i < Pyramid::VERTEX_COUNT; i++)
+                {
+                    if (pyramid->vertices[i].dot(d) > pyramid->vertices[best].dot(d))
+                        best = i;
+                }
+                p = pyramid->vertices[best];
+                break;
+            }
+            case HULL:
+            {
+                const ConvexHull* hull = (const ConvexHull*)shape;
+                hint = hull->support(d, hint);
+                p = hull->getVertices()[hint];
+                break;
+            }
+            default:
+                break; // spheres are a point core
+            }
+            return toWorld(p);
+        }
+    };
+
+    // Point of the Minkowski difference a - b, with the points it came from
+    struct Vertex
+    {
+        Vector3 w;
+        Vector3 a;
+        Vector3 b;
+    };
+
+    // Vertices, and the barycentric weights of the point closest to the origin
+    struct Simplex
+    {
+        Vertex v[4];
+        float weights[4];
+        int count;
+    };
+
+    enum Result
+    {
+        SEPARATED,     // further apart than the margins
+        WITHIN_MARGIN, // cores apart, simplex holds their closest points
+        OVERLAPPING    // cores overlap, simplex is a tetrahedron around the origin
+    };
+
+    static Vertex support(Proxy& A, Proxy& B, const Vector3& dir)
+    {
+        Vertex v;
+        v.a = A.support(dir);
+        v.b = B.support(dir * -1.0f);
+        v.w = v.a - v.b;
+        return v;
+    }
+
+    // Distance GJK between the cores. Stops as soon as a support plane shows the cores are
+    // more than margin apart, which is what a separated pair from last step usually hits
+    // on the first iteration.
+    static Result gjk(Proxy& A, Proxy& B, float margin, Simplex& s, int& iterations)
+    {
+        if (s.count == 0)
+        {
+            Vector3 d = A.position - B.position;
+            if (d.magnitudeSquared() < 1e-12f)
+                d = Vector3(1, 0, 0);
+            s.v[0] = support(A, B, d);
+            s.count = 1;
+        }
+        Vector3 v;
+        Simplex last;
+        float previous = 1e30f;
+        for (iterations = 1; iterations <= MAX_ITERATIONS; iterations++)
+        {
+            if (solve(s, v))
+                return OVERLAPPING;
+            float vv = v.magnitudeSquared();
+            if (vv < 1e-10f)
+                return OVERLAPPING;
+            // In float the last support can land in the plane of the simplex, just short of
+            // the tolerance below, and the flat result is no closer: the previous simplex
+            // had already converged
+            if (vv >= previous)
+            {
+                s = last;
+                return margin > 0.0f ? WITHIN_MARGIN : SEPARATED;
+            }
+            previous = vv;
+            last = s;
+            Vertex w = support(A, B, v * -1.0f);
+            float vw = v.dot(w.w);
+            if (vw > 0.0f && vw * vw > vv * margin * margin)
+                return SEPARATED;
+            bool repeated = false;
+            for (int i = 0; i < s.count; i++)
+                repeated = repeated || (s.v[i].w - w.w).magnitudeSquared() < 1e-12f;
+            if (repeated || vv - vw <= 1e-5f * vv)
+                return margin > 0.0f ? WITHIN_MARGIN : SEPARATED;
+            s.v[s.count++] = w;
+        }
+        return margin > 0.0f ? WITHIN_MARGIN : SEPARATED;
+    }
+
+    static void closestPoints(const Simplex& s, Vector3& pointA, Vector3& pointB)
+    {
+        pointA = Vector3(0, 0, 0);
+        pointB = Vector3(0, 0, 0);
+        for (int i = 0; i < s.count; i++)
+        {
+            pointA += s.v[i].a * s.weights[i];
+            pointB += s.v[i].b * s.weights[i];
+        }
+    }
+
+    // Reduces the simplex to the feature closest to the origin and sets v to that point.
+    // Returns true when a tetrahedron contains the origin.
+    static bool solve(Simplex& s, Vector3& v)
+    {
+        if (s.count == 4)
+        {
+            if (solveTetrahedron(s))
+                return true;
+        }
+        else if (s.count == 3)
+        {
+            solveTriangle(s, 0, 1, 2);
+        }
+        else if (s.count == 2)
+        {
+            solveSegment(s, 0, 1);
+        }
+        else
+        {
+            s.weights[0] = 1.0f;
+        }
+        v = Vector3(0, 0, 0);
+        for (int i = 0; i < s.count; i++)
+            v += s.v[i].w * s.weights[i];
+        return false;
+    }
+
+    // Keeps the listed vertices, in order, with their weights
+    static void keep(Simplex& s, int count, const int* index, const float* weights)
+    {
+        Vertex kept[3];
+        for (int i = 0; i < count; i++)
+            kept[i] = s.v[index[i]];
+        for (int i = 0; i < count; i++)
+        {
+            s.v[i] = kept[i];
+            s.weights[i] = weights[i];
+        }
+        s.count = count;
+    }
+
+    static void keepVertex(Simplex& s, int i)
+    {
+        float w = 1.0f;
+        keep(s, 1, &i, &w);
+    }
+
+    static void solveSegment(Simplex& s, int ia, int ib)
+    {
+        Vector3 a = s.v[ia].w, ab = s.v[ib].w - a;
+        float len2 = ab.magnitudeSquared();
+        float t = len2 > 1e-20f ? -a.dot(ab) / len2 : 0.0f;
+        if (t <= 0.0f)
+            return keepVertex(s, ia);
+        if (t >= 1.0f)
+            return keepVertex(s, ib);
+        int index[2] = {ia, ib};
+        float w[2] = {1.0f - t, t};
+        keep(s, 2, index, w);
+    }
+
+    // Voronoi regions of the triangle as seen from the origin (Ericson, Real-Time
+    // Collision Detection 5.1.5)
+    static void solveTriangle(Simplex& s, int ia, int ib, int ic)
+    {
+        Vector3 a = s.v[ia].w, b = s.v[ib].w, c = s.v[ic].w;
+        Vector3 ab = b - a, ac = c - a;
+        float d1 = -ab.dot(a), d2 = -ac.dot(a);
+        float d3 = -ab.dot(b), d4 = -ac.dot(b);
+        float d5 = -ab.dot(c), d6 = -ac.dot(c);
+        float va = d3 * d6 - d5 * d4;
+        float vb = d5 * d2 - d1 * d6;
+        float vc = d1 * d4 - d3 * d2;
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return keepVertex(s, ia);
+        if (d3 >= 0.0f && d4 <= d3)
+            return keepVertex(s, ib);
+        if (d6 >= 0.0f && d5 <= d6)
+            return keepVertex(s, ic);
+        float sum = va + vb + vc;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            return solveSegment(s, ia, ib);
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            return solveSegment(s, ia, ic);
+        if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+            return solveSegment(s, ib, ic);
+        if (sum <= 1e-20f)
+        {
+            // Degenerate (flat) triangle: its longest edge
+            float lab = ab.magnitudeSquared(), lac = ac.magnitudeSquared();
+            float lbc = (c - b).magnitudeSquared();
+            if (lab >= lac && lab >= lbc)
+                return solveSegment(s, ia, ib);
+            if (lac >= lbc)
+                return solveSegment(s, ia, ic);
+            return solveSegment(s, ib, ic);
+        }
+        int index[3] = {ia, ib, ic};
+        float w[3] = {va / sum, vb / sum, vc / sum};
+        keep(s, 3, index, w);
+    }
+
+    // Each face the origin lies outside of is solved as a triangle and the closest wins;
+    // if there is none, the origin is inside
+    static bool solveTetrahedron(Simplex& s)
+    {
+        static const int faces[4][4] = {{0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+        Simplex best;
+        float bestDistance = 1e30f;
+        bool outside = false;
+        for (const int* f : faces)
+        {
+            Vector3 a = s.v[f[0]].w;
+            Vector3 n = (s.v[f[1]].w - a).cross(s.v[f[2]].w - a);
+            float sideOrigin = -n.dot(a);
+            float sideOpposite = n.dot(s.v[f[3]].w - a);
+            // A flat tetrahedron has no inside; every face counts as outside
+            if (sideOrigin * sideOpposite > 0.0f && std::abs(sideOpposite) > 1e-12f)
+                continue;
+            outside = true;
+            Simplex face = s;
+            solveTriangle(face, f[0], f[1], f[2]);
+            Vector3 v;
+            for (int i = 0; i < face.count; i++)
+                v += face.v[i].w * face.weights[i];
+            if (v.magnitudeSquared() < bestDistance)
+            {
+                bestDistance = v.magnitudeSquared();
+                best = face;
+            }
+        }
+        if (!outside)
+            return true;
+        s = best;
+        return false;
+    }
+
+    // GJK can stop with the origin on a triangle, edge or vertex of its simplex (shapes
+    // lined up face to face do that); EPA needs a tetrahedron, so add support points in
+    // directions that leave the simplex's span
+    static bool fillTetrahedron(Proxy& A, Proxy& B, Simplex& s)
+    {
+        static const Vector3 axes[3] = {Vector3(1, 0, 0), Vector3(0, 1, 0), Vector3(0, 0, 1)};
+        auto tryAdd = [&](const Vector3& dir)
+        {
+            for (float sign : {1.0f, -1.0f})
+            {
+                Vertex w = support(A, B, dir * sign);
+                if (spread(s, w.w) > 1e-8f)
+                {
+                    s.v[s.count++] = w;
+                    return;
+                }
+            }
+        };
+        for (int i = 0; i < 3 && s.count == 1; i++)
+            tryAdd(axes[i]);
+        for (int i = 0; i < 3 && s.count == 2; i++)
+        {
+            Vector3 dir = (s.v[1].w - s.v[0].w).cross(axes[i]);
+            if (dir.magnitudeSquared() > 1e-12f)
+                tryAdd(dir);
+        }
+        if (s.count == 3)
+            tryAdd((s.v[1].w - s.v[0].w).cross(s.v[2].w - s.v[0].w));
+        return s.count == 4;
+    }
+
+    // Squared distance of w from the point, line or plane through the simplex; zero when w
+    // adds no dimension
+    static float spread(const Simplex& s, const Vector3& w)
+    {
+        Vector3 d = w - s.v[0].w;
+        if (s.count == 1)
+            return d.magnitudeSquared();
+        Vector3 edge = s.v[1].w - s.v[0].w;
+        if (s.count == 2)
+            return edge.cross(d).magnitudeSquared() / std::max(edge.magnitudeSquared(), 1e-20f);
+        Vector3 n = edge.cross(s.v[2].w - s.v[0].w);
+        float h = n.dot(d);
+        return h * h / std::max(n.magnitudeSquared(), 1e-20f);
+    }
+
+    // Expanding polytope from GJK's tetrahedron: the face of the Minkowski difference
+    // nearest the origin gives the penetration normal and depth. normal pushes A out of B.
+    static bool epa(Proxy& A, Proxy& B, const Simplex& s, Vector3& normal, float& depth,
+                    Vector3& pointB)
+    {
+        // Each iteration adds one vertex, and a closed triangulated polytope with V vertices
+        // has 2V - 4 faces; sized to what MAX_ITERATIONS can reach since this is all stack
+        static const int MAX_VERTICES = MAX_ITERATIONS + 4;
+        static const int MAX_FACES = 2 * MAX_VERTICES - 4;
+        static const int MAX_EDGES = MAX_VERTICES;
+        if (s.count < 4)
+            return false;
+
+        struct Face
+        {
+            int v[3];
+            Vector3 n;
+            float d;
+        };
+        Vertex verts[MAX_VERTICES];
+        Face faces[MAX_FACES];
+        int vertexCount = 4, faceCount = 0;
+        for (int i = 0; i < 4; i++)
+            verts[i] = s.v[i];
+        auto addFace = [&](int a, int b, int c)
+        {
+            Vector3 n = (verts[b].w - verts[a].w).cross(verts[c].w - verts[a].w);
+            float len = n.magnitude();
+            if (len < 1e-12f || faceCount == MAX_FACES)
+                return;
+            n *= 1.0f / len;
+            faces[faceCount++] = Face{{a, b, c}, n, n.dot(verts[a].w)};
+        };
+
+        Vector3 w0 = verts[0].w;
+        float volume = (verts[1].w - w0).cross(verts[2].w - w0).dot(verts[3].w - w0);
+        if (std::abs(volume) < 1e-12f)
+            return false;
+        int i1 = volume > 0.0f ? 2 : 1, i2 = volume > 0.0f ? 1 : 2;
+        addFace(0, i1, i2);
+        addFace(0, 3, i1);
+        addFace(0, i2, 3);
+        addFace(i1, 3, i2);
+
+        int best = 0;
+        for (int iteration = 0; iteration < MAX_ITERATIONS && faceCount > 0; iteration++)
+        {
+            best = 0;
+            for (int f = 1; f < faceCount; f++)
+            {
+                if (faces[f].d < faces[best].d)
+                    best = f;
+            }
+            Vertex w = support(A, B, faces[best].n);
+            if (faces[best].n.dot(w.w) - faces[best].d < 1e-4f || vertexCount == MAX_VERTICES)
+                break;
+
+            // Faces the new point is (nearly) in the plane of stay. Boxes and hulls give many
+            // coplanar faces, and counting one of those as visible can cut a second hole
+            // the horizon does not close
+            const float VISIBLE = 1e-6f * (1.0f + w.w.magnitude());
+            int edges[MAX_EDGES][2];
+            int edgeCount = 0;
+            for (int f = 0; f < faceCount;)
+            {
+                Face& face = faces[f];
+                if (face.n.dot(w.w - verts[face.v[0]].w) <= VISIBLE)
+                {
+                    f++;
+                    continue;
+                }
+                for (int k = 0; k < 3; k++)
+                {
+                    int a = face.v[k], b = face.v[(k + 1) % 3];
+                    int twin = -1;
+                    for (int e = 0; e < edgeCount && twin < 0; e++)
+                    {
+                        if (edges[e][0] == b && edges[e][1] == a)
+                            twin = e;
+                    }
+                    if (twin >= 0)
+                    {
+                        edges[twin][0] = edges[edgeCount - 1][0];
+                        edges[twin][1] = edges[edgeCount - 1][1];
+                        edgeCount--;
+                    }
+                    else if (edgeCount < MAX_EDGES)
+                    {
+                        edges[edgeCount][0] = a;
+                        edges[edgeCount][1] = b;
+                        edgeCount++;
+                    }
+                }
+                faces[f] = faces[--faceCount];
+            }
+            verts[vertexCount] = w;
+            for (int e = 0; e < edgeCount; e++)
+                addFace(edges[e][0], edges[e][1], vertexCount);
+            vertexCount++;
+        }
+        if (faceCount == 0)
+            return false;
+        best = 0;
+        for (int f = 1; f < faceCount; f++)
+        {
+            if (faces[f].d < faces[best].d)
+                best = f;
+        }
+
+        // Barycentric weights of the origin's projection onto the face
+        const Face& face = faces[best];
+        const Vertex& a = verts[face.v[0]];
+        const Vertex& b = verts[face.v[1]];
+        const Vertex& c = verts[face.v[2]];
+        Vector3 p = face.n * face.d;
+        Vector3 v0 = b.w - a.w, v1 = c.w - a.w, v2 = p - a.w;
+        float d00 = v0.dot(v0), d01 = v0.dot(v1), d11 = v1.dot(v1);
+        float d20 = v2.dot(v0), d21 = v2.dot(v1);
+        float denom = d00 * d11 - d01 * d01;
+        float wb = denom > 1e-20f ? (d11 * d20 - d01 * d21) / denom : 0.0f;
+        float wc = denom > 1e-20f ? (d00 * d21 - d01 * d20) / denom : 0.0f;
+        pointB = a.b * (1.0f - wb - wc) + b.b * wb + c.b * wc;
+        normal = face.n * -1.0f;
+        depth = face.d;
+        return true;
+    }
+};
@@ -0,0 +1,181 @@
+#pragma once
+#include "AABB.h"
+#include "Vector3.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// What the world draws into its debug buffer; 0 turns debug drawing off
+enum DebugDrawFlag : uint32_t
+{
+    DEBUG_CONTACTS = 1 << 0,    // contact points and normals
+    DEBUG_AABBS = 1 << 1,       // body bounds
+    DEBUG_CONSTRAINTS = 1 << 2, // anchor to anchor links
+    DEBUG_SLEEP = 1 << 3,       // awake / asleep colours
+    DEBUG_ISLANDS = 1 << 4      // one colour per contact and constraint island
+};
+
+// One vertex of the debug buffer: position then colour, the interleaved layout a
+// Three.js InterleavedBuffer reads without conversion
+struct DebugVertex
+{
+    float x, y, z;
+    float r, g, b;
+};
+
+static_assert(sizeof(DebugVertex) == 6 * sizeof(float), "DebugVertex must stay packed");
+
+// Line and point geometry of one step, for rendering the solver's view of the scene. The
+// world fills it at the end of a step, from the contacts of the last substep and the body
+// and constraint state, so nothing runs while the flags are 0. Lines come first in the
+// buffer, as vertex pairs, followed by the points, so a renderer can draw both from one
+// upload with two draw ranges.
+class DebugDraw
+{
+public:
+    uint32_t flags = 0;
+
+    // The world records the contacts only while a flag needs them
+    bool wantsContacts() const { return (flags & (DEBUG_CONTACTS | DEBUG_ISLANDS)) != 0; }
+
+    void beginSubstep() { contacts.clear(); }
+
+    // bodyB is -1 for the floor
+    void recordContact(int bodyA, int bodyB, const Vector3& point, const Vector3& normal)
+    {
+        contacts.push_back({bodyA, bodyB, point, normal});
+    }
+
+    template <typename Visit>
+    void forEachContact(Visit visit) const
+    {
+        for (const ContactRecord& c : contacts)
+            visit(c.bodyA, c.bodyB, c.point, c.normal);
+    }
+
+    void beginFrame()
+    {
+        lines.clear();
+        points.clear();
+    }
+
+    void line(const Vector3& a, const Vector3& b, const Vector3& color)
+    {
+        lines.push_back(vertex(a, color));
+        lines.push_back(vertex(b, color));
+    }
+
+    void point(const Vector3& p, const Vector3& color) { points.push_back(vertex(p, color)); }
+
+    // The twelve edges of a box
+    void box(const AABB& box, const Vector3& color)
+    {
+        const Vector3& lo = box.min;
+        const Vector3& hi = box.max;
+        Vector3 corners[8];
+        for (int i = 0; i < 8; i++)
+            corners[i] = Vector3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+        for (int i = 0; i < 8; i++)
+        {
+            // Each corner links to the corners that differ from it in one higher bit
+            for (int bit = 1; bit < 8; bit <<= 1)
+            {
+                if (!(i & bit))
+                    line(corners[i], corners[i | bit], color);
+            }
+        }
+    }
+
+    // Appends the points after the lines; the buffer is complete until the next beginFrame
+    void endFrame()
+    {
+        lineVertexCount = (int)lines.size();
+        pointCount = (int)points.size();
+        lines.insert(lines.end(), points.begin(), points.end());
+    }
+
+    // Union-find over dense body indices, for island colours
+    void resetIslands(size_t count)
+    {
+        parent.resize(count);
+        for (size_t i = 0; i < count; i++)
+            parent[i] = (int)i;
+    }
+
+    void joinIslands(int a, int b)
+    {
+        int ra = findIsland(a);
+        int rb = findIsland(b);
+        if (ra != rb)
+            parent[ra] = rb;
+    }
+
+    int findIsland(int i)
+    {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
+
+    // Distinct, stable colours per island root: hues a golden-ratio turn apart
+    static Vector3 islandColor(int root)
+    {
+        float hue = std::fmod((float)root * 0.618034f, 1.0f) * 6.0f;
+        float x = 1.0f - std::abs(std::fmod(hue, 2.0f) - 1.0f);
+        const float lo = 0.25f, hi = 0.95f;
+        float mid = lo + (hi - lo) * x;
+        switch ((int)hue)
+        {
+        case 0:
+            return Vector3(hi, mid, lo);
+        case 1:
+            return Vector3(mid, hi, lo);
+        case 2:
+            return Vector3(lo, hi, mid);
+        case 3:
+            return Vector3(lo, mid, hi);
+        case 4:
+            return Vector3(mid, lo, hi);
+        default:
+            return Vector3(hi, lo, mid);
+        }
+    }
+
+    const DebugVertex* data() const { return lines.data(); }
+    int getLineVertexCount() const { return lineVertexCount; }
+    int getPointCount() const { return pointCount; }
+
+    void clear()
+    {
+        contacts.clear();
+        lines.clear();
+        points.clear();
+        lineVertexCount = 0;
+        pointCount = 0;
+    }
+
+private:
+    struct ContactRecord
+    {
+        int bodyA;
+        int bodyB;
+        Vector3 point;
+        Vector3 normal;
+    };
+
+    static DebugVertex vertex(const Vector3& p, const Vector3& color)
+    {
+        return {p.x, p.y, p.z, color.x, color.y, color.z};
+    }
+
+    std::vector<ContactRecord> contacts;
+    // Line vertices, then (after endFrame) the points
+    std::vector<DebugVertex> lines;
+    std::vector<DebugVertex> points;
+    std::vector<int> parent;
+    int lineVertexCount = 0;
+    int pointCount = 0;
+};
@@ -0,0 +1,417 @@
+#pragma once
+#include "AABB.h"
+#include "SpatialSort.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Dynamic AABB tree (bounding volume hierarchy) over body proxies, in the style of
+// Box2D's b2DynamicTree. Leaves store "fat" boxes grown by a margin and by the expected
+// displacement, so a moving body only needs re-inserting once it leaves its fat box.
+// Insertion picks the sibling with the cheapest surface-area increase and the tree is
+// kept balanced with AVL-style rotations, so queries stay O(log n).
+class DynamicTree
+{
+public:
+    static const int NULL_NODE = -1;
+
+    float margin = 0.1f;
+    // Fat boxes are stretched this many steps ahead along the displacement
+    float displacementMultiplier = 2.0f;
+
+    int createProxy(const AABB& aabb, uint32_t userData)
+    {
+        int proxy = allocateNode();
+        Vector3 m(margin, margin, margin);
+        nodes[proxy].aabb = AABB(aabb.min - m, aabb.max + m);
+        nodes[proxy].userData = userData;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        return proxy;
+    }
+
+    // Adds count proxies at once, e.g. a loaded level. The leaves are sorted by the Morton
+    // code of their centres and split in halves down that order, which builds a balanced
+    // subtree in one sort and one linear pass; it goes into the tree as one insertion.
+    // Writes the new proxy ids to proxies.
+    void createProxies(const AABB* boxes, const uint32_t* userData, int count, int* proxies)
+    {
+        if (count <= 0)
+            return;
+        nodes.reserve(nodes.size() + 2 * (size_t)count);
+        Vector3 lo = boxes[0].center(), hi = lo;
+        for (int i = 1; i < count; i++)
+        {
+            Vector3 c = boxes[i].center();
+            lo = Vector3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+            hi = Vector3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+        }
+        Vector3 extent = hi - lo;
+        float size = std::max(extent.x, std::max(extent.y, extent.z));
+        float scale = size > 0.0f ? 1023.0f / size : 0.0f;
+
+        Vector3 m(margin, margin, margin);
+        std::vector<uint64_t> keys(count);
+        for (int i = 0; i < count; i++)
+        {
+            int proxy = allocateNode();
+            nodes[proxy].aabb = AABB(boxes[i].min - m, boxes[i].max + m);
+            nodes[proxy].userData = userData[i];
+            nodes[proxy].height = 0;
+            proxies[i] = proxy;
+            Vector3 q = (boxes[i].center() - lo) * scale;
+            uint64_t code = SpatialSorter::mortonCode((uint32_t)q.x, (uint32_t)q.y, (uint32_t)q.z);
+            keys[i] = (code << 32) | (uint32_t)proxy;
+        }
+        std::sort(keys.begin(), keys.end());
+        insertLeaf(buildSubtree(keys.data(), count));
+    }
+
+    void destroyProxy(int proxy)
+    {
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    // Returns true when the proxy had to be re-inserted
+    bool moveProxy(int proxy, const AABB& aabb, const Vector3& displacement)
+    {
+        if (nodes[proxy].aabb.contains(aabb))
+            return false;
+
+        removeLeaf(proxy);
+
+        Vector3 m(margin, margin, margin);
+        AABB fat(aabb.min - m, aabb.max + m);
+        Vector3 d = displacement * displacementMultiplier;
+        if (d.x < 0)
+            fat.min.x += d.x;
+        else
+            fat.max.x += d.x;
+        if (d.y < 0)
+            fat.min.y += d.y;
+        else
+            fat.max.y += d.y;
+        if (d.z < 0)
+            fat.min.z += d.z;
+        else
+            fat.max.z += d.z;
+        nodes[proxy].aabb = fat;
+
+        insertLeaf(proxy);
+        return true;
+    }
+
+    uint32_t getUserData(int proxy) const { return nodes[proxy].userData; }
+    void setUserData(int proxy, uint32_t userData) { nodes[proxy].userData = userData; }
+    const AABB& getFatAABB(int proxy) const { return nodes[proxy].aabb; }
+
+    // Calls callback(proxy) for every leaf overlapping aabb; stops when it returns false
+    template <typename Callback>
+    void query(const AABB& aabb, Callback callback) const
+    {
+        if (root == NULL_NODE)
+            return;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int id = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[id];
+            if (!node.aabb.overlaps(aabb))
+                continue;
+            if (node.isLeaf())
+            {
+                if (!callback(id))
+                    return;
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    // Calls callback(proxy, maxT) for every leaf the ray's box test hits within maxT. The
+    // callback returns the new maxT: the exact hit distance to clip the ray, the old maxT
+    // to keep going, or 0 to stop.
+    template <typename Callback>
+    void raycast(const Vector3& origin, const Vector3& dir, float maxT, Callback callback) const
+    {
+        if (root == NULL_NODE)
+            return;
+        Vector3 invDir = AABB::inverseDirection(dir);
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int id = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[id];
+            if (node.aabb.raycast(origin, invDir, maxT) < 0.0f)
+                continue;
+            if (node.isLeaf())
+            {
+                maxT = callback(id, maxT);
+                if (maxT <= 0.0f)
+                    return;
+            }
+            else
+            {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    int getHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+    void clear()
+    {
+        nodes.clear();
+        root = NULL_NODE;
+        freeList = NULL_NODE;
+    }
+
+private:
+    struct Node
+    {
+        AABB aabb;
+        uint32_t userData = 0;
+        int parent = NULL_NODE; // next free node while on the free list
+        int child1 = NULL_NODE;
+        int child2 = NULL_NODE;
+        int height = -1; // leaf = 0, free = -1
+
+        bool isLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    std::vector<Node> nodes;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE;
+    mutable std::vector<int> stack;
+
+    int allocateNode()
+    {
+        if (freeList == NULL_NODE)
+        {
+            nodes.push_back(Node());
+            return (int)nodes.size() - 1;
+        }
+        int id = freeList;
+        freeList = nodes[id].parent;
+        nodes[id] = Node();
+        return id;
+    }
+
+    void freeNode(int id)
+    {
+        nodes[id].parent = freeList;
+        nodes[id].height = -1;
+        freeList = id;
+    }
+
+    // Links the leaves of Morton-sorted keys under fresh internal nodes; returns the
+    // subtree's root
+    int buildSubtree(const uint64_t* keys, int count)
+    {
+        if (count == 1)
+            return (int)(keys[0] & 0xFFFFFFFFu);
+        // Split where the highest bit that differs across the range flips, so both halves
+        // are compact cells; identical codes split in the middle
+        int half = count / 2;
+        uint64_t first = keys[0] >> 32, last = keys[count - 1] >> 32;
+        if (first != last)
+        {
+            uint64_t bit = 1;
+            for (uint64_t diff = first ^ last; diff > 1; diff >>= 1)
+                bit <<= 1;
+            half = (int)(std::partition_point(keys, keys + count,
+                                              [&](uint64_t k) { return !((k >> 32) & bit); }) -
+                         keys);
+        }
+        int c1 = buildSubtree(keys, half);
+        int c2 = buildSubtree(keys + half, count - half);
+        int node = allocateNode();
+        nodes[node].child1 = c1;
+        nodes[node].child2 = c2;
+        nodes[node].aabb = nodes[c1].aabb.merged(nodes[c2].aabb);
+        nodes[node].height = 1 + std::max(nodes[c1].height, nodes[c2].height);
+        nodes[c1].parent = node;
+        nodes[c2].parent = node;
+        return node;
+    }
+
+    void insertLeaf(int leaf)
+    {
+        if (root == NULL_NODE)
+        {
+            root = leaf;
+            nodes[root].parent = NULL_NODE;
+            return;
+        }
+
+        // Find the cheapest sibling by the surface area heuristic
+        AABB leafBox = nodes[leaf].aabb;
+        int index = root;
+        while (!nodes[index].isLeaf())
+        {
+            int c1 = nodes[index].child1;
+            int c2 = nodes[index].child2;
+
+            float area = nodes[index].aabb.perimeter();
+            float combinedArea = nodes[index].aabb.merged(leafBox).perimeter();
+            float cost = 2.0f * combinedArea;
+            float inheritance = 2.0f * (combinedArea - area);
+
+            auto childCost = [&](int c)
+            {
+                float merged = nodes[c].aabb.merged(leafBox).perimeter();
+                if (nodes[c].isLeaf())
+                    return merged + inheritance;
+                return merged - nodes[c].aabb.perimeter() + inheritance;
+            };
+            float cost1 = childCost(c1);
+            float cost2 = childCost(c2);
+
+            if (cost < cost1 && cost < cost2)
+                break;
+            index = cost1 < cost2 ? c1 : c2;
+        }
+        int sibling = index;
+
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].aabb = leafBox.merged(nodes[sibling].aabb);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+
+        if (oldParent != NULL_NODE)
+        {
+            if (nodes[oldParent].child1 == sibling)
+                nodes[oldParent].child1 = newParent;
+            else
+                nodes[oldParent].child2 = newParent;
+        }
+        else
+        {
+            root = newParent;
+        }
+
+        refitFrom(nodes[leaf].parent);
+    }
+
+    void removeLeaf(int leaf)
+    {
+        if (leaf == root)
+        {
+            root = NULL_NODE;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+        if (grandParent != NULL_NODE)
+        {
+            if (nodes[grandParent].child1 == parent)
+                nodes[grandParent].child1 = sibling;
+            else
+                nodes[grandParent].child2 = sibling;
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            refitFrom(grandParent);
+        }
+        else
+        {
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+            freeNode(parent);
+        }
+    }
+
+    // Walks up from index, rebalancing and refitting boxes and heights
+    void refitFrom(int index)
+    {
+        while (index != NULL_NODE)
+        {
+            index = balance(index);
+            int c1 = nodes[index].child1;
+            int c2 = nodes[index].child2;
+            nodes[index].height = 1 + std::max(nodes[c1].height, nodes[c2].height);
+            nodes[index].aabb = nodes[c1].aabb.merged(nodes[c2].aabb);
+            index = nodes[index].parent;
+        }
+    }
+
+    // Rotates a subtree whose children differ in height by more than one. Returns the
+    // node now at the subtree's root.
+    int balance(int iA)
+    {
+        Node& A = nodes[iA];
+        if (A.isLeaf() || A.height < 2)
+            return iA;
+
+        int iB = A.child1;
+        int iC = A.child2;
+        int diff = nodes[iC].height - nodes[iB].height;
+
+        if (diff > 1)
+            return rotateUp(iA, iC, iB, true);
+        if (diff < -1)
+            return rotateUp(iA, iB, iC, false);
+        return iA;
+    }
+
+    // Promotes child iUp of iA over iA; iOther is iA's other child
+    int rotateUp(int iA, int iUp, int iOther, bool upIsChild2)
+    {
+        int iF = nodes[iUp].child1;
+        int iG = nodes[iUp].child2;
+
+        // Swap A and Up
+        nodes[iUp].child1 = iA;
+        nodes[iUp].parent = nodes[iA].parent;
+        nodes[iA].parent = iUp;
+
+        int upParent = nodes[iUp].parent;
+        if (upParent != NULL_NODE)
+        {
+            if (nodes[upParent].child1 == iA)
+                nodes[upParent].child1 = iUp;
+            else
+                nodes[upParent].child2 = iUp;
+        }
+        else
+        {
+            root = iUp;
+        }
+
+        // Keep the taller grandchild under Up, hand the other one to A
+        int keep = iF, give = iG;
+        if (nodes[iF].height < nodes[iG].height)
+        {
+            keep = iG;
+            give = iF;
+        }
+        nodes[iUp].child2 = keep;
+        if (upIsChild2)
+            nodes[iA].child2 = give;
+        else
+            nodes[iA].child1 = give;
+        nodes[give].parent = iA;
+
+        nodes[iA].aabb = nodes[iOther].aabb.merged(nodes[give].aabb);
+        nodes[iUp].aabb = nodes[iA].aabb.merged(nodes[keep].aabb);
+        nodes[iA].height = 1 + std::max(nodes[iOther].height, nodes[give].height);
+        nodes[iUp].height = 1 + std::max(nodes[iA].height, nodes[keep].height);
+        return iUp;
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// Linear (bump) allocator for data that only lives for one step: pair lists, contacts,
+// solver scratch. reset() rewinds it at the start of every step. If a step overflows the
+// current block, extra blocks are taken from the heap and on the next reset everything is
+// merged into a single block big enough for the peak, so a warmed-up world stops hitting
+// the heap entirely. heapAllocations() counts the blocks allocated since the last reset.
+class FrameAllocator
+{
+public:
+    explicit FrameAllocator(size_t initialCapacity = 64 * 1024) { addBlock(initialCapacity); }
+
+    FrameAllocator(const FrameAllocator&) = delete;
+    FrameAllocator& operator=(const FrameAllocator&) = delete;
+
+    ~FrameAllocator()
+    {
+        for (Block& b : blocks)
+            std::free(b.memory);
+    }
+
+    void* allocate(size_t bytes, size_t align)
+    {
+        Block* b = &blocks.back();
+        size_t offset = (b->used + align - 1) & ~(align - 1);
+        if (offset + bytes > b->size)
+        {
+            addBlock(std::max(bytes + align, b->size * 2));
+            b = &blocks.back();
+            offset = 0;
+            heapCount++;
+        }
+        b->used = offset + bytes;
+        totalUsed += bytes;
+        return b->memory + offset;
+    }
+
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return (T*)allocate(sizeof(T) * count, alignof(T));
+    }
+
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (Block& b : blocks)
+            {
+                total += b.size;
+                std::free(b.memory);
+            }
+            blocks.clear();
+            addBlock(total);
+        }
+        blocks.back().used = 0;
+        peak = std::max(peak, totalUsed);
+        totalUsed = 0;
+        heapCount = 0;
+    }
+
+    // Heap blocks allocated since the last reset; zero once the arena has warmed up
+    int heapAllocations() const { return heapCount; }
+    size_t used() const { return totalUsed; }
+    size_t peakUsed() const { return std::max(peak, totalUsed); }
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const Block& b : blocks)
+            total += b.size;
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        unsigned char* memory;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> blocks;
+    size_t totalUsed = 0;
+    size_t peak = 0;
+    int heapCount = 0;
+
+    void addBlock(size_t size)
+    {
+        unsigned char* memory = (unsigned char*)std::malloc(size);
+        if (!memory)
+            throw std::bad_alloc();
+        blocks.reserve(8);
+        blocks.push_back(Block{memory, size, 0});
+    }
+};
+
+// STL allocator that draws from a FrameAllocator. Deallocation is a no-op; the memory
+// comes back when the frame allocator is reset.
+template <typename T>
+class FrameAllocatorAdapter
+{
+public:
+    using value_type = T;
+
+    FrameAllocator* arena;
+
+    explicit FrameAllocatorAdapter(FrameAllocator& a) : arena(&a) {}
+
+    template <typename U>
+    FrameAllocatorAdapter(const FrameAllocatorAdapter<U>& other) : arena(other.arena)
+    {
+    }
+
+    T* allocate(size_t n) { return arena->allocateArray<T>(n); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const FrameAllocatorAdapter<U>& other) const
+    {
+        return arena == other.arena;
+    }
+    template <typename U>
+    bool operator!=(const FrameAllocatorAdapter<U>& other) const
+    {
+        return arena != other.arena;
+    }
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocatorAdapter<T>>;
@@ -0,0 +1,483 @@
+#pragma once
+#include "AABB.h"
+#include "RigidBody.h"
+#include "SceneQuery.h"
+#include "SlotMap.h"
+#include "Vector3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// How particles and rigid bodies affect each other
+enum ParticleCoupling
+{
+    COUPLE_NONE = 0,    // particles ignore bodies
+    COUPLE_ONE_WAY = 1, // bodies push particles
+    COUPLE_TWO_WAY = 2  // and particles push back
+};
+
+// Rotation-free spheres of one radius for granular effects, stepped next to the rigid
+// bodies instead of as RigidBodies.
+//
+// State is kept as separate position and velocity arrays. Each step predicts positions,
+// bins them into a dense uniform grid over the particles' bounds with a counting sort,
+// and reorders every array into cell order, so a cell is a contiguous run and the three
+// cells of a row are one run too. Contacts are then resolved as position corrections
+// (Jacobi, a few iterations) by a tight loop over those runs, and velocities are
+// recovered from the displacement. Particle order is therefore not stable between
+// steps; grains are interchangeable.
+class ParticleSystem
+{
+public:
+    float radius = 0.05f;
+    float mass = 0.01f;
+    // Fraction of tangential velocity removed on the floor and on bodies
+    float friction = 0.3f;
+    float damping = 0.999f;
+    int iterations = 2;
+    ParticleCoupling coupling = COUPLE_TWO_WAY;
+
+    size_t size() const { return x.size(); }
+
+    void add(float px, float py, float pz, float pvx, float pvy, float pvz)
+    {
+        x.push_back(px);
+        y.push_back(py);
+        z.push_back(pz);
+        vx.push_back(pvx);
+        vy.push_back(pvy);
+        vz.push_back(pvz);
+    }
+
+    void clear()
+    {
+        for (std::vector<float>* a : arrays())
+            a->clear();
+    }
+
+    // Interleaved xyz positions, count * 3 floats
+    void copyPositions(float* out) const
+    {
+        for (size_t i = 0; i < x.size(); i++)
+        {
+            out[i * 3] = x[i];
+            out[i * 3 + 1] = y[i];
+            out[i * 3 + 2] = z[i];
+        }
+    }
+
+    // floorHeight(x, z) gives the ground under a point (-1e30 for none)
+    template <typename FloorHeight>
+    void step(float dt, const Vector3& gravity, FloorHeight floorHeight,
+              SlotMap<RigidBody>& bodies)
+    {
+        size_t n = x.size();
+        if (n == 0 || dt <= 0.0f)
+            return;
+
+        // Predict
+        ox = x;
+        oy = y;
+        oz = z;
+        for (size_t i = 0; i < n; i++)
+        {
+            vx[i] += gravity.x * dt;
+            vy[i] += gravity.y * dt;
+            vz[i] += gravity.z * dt;
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            z[i] += vz[i] * dt;
+        }
+
+        buildGrid();
+
+        cx.resize(n);
+        cy.resize(n);
+        cz.resize(n);
+        contacts.resize(n);
+        for (int it = 0; it < iterations; it++)
+        {
+            solveParticles();
+            solveFloor(floorHeight);
+            if (coupling != COUPLE_NONE)
+                solveBodies(bodies, it == 0);
+        }
+
+        // Velocities from the displacement, then floor friction
+        float inv = 1.0f / dt;
+        for (size_t i = 0; i < n; i++)
+        {
+            vx[i] = (x[i] - ox[i]) * inv * damping;
+            vy[i] = (y[i] - oy[i]) * inv * damping;
+            vz[i] = (z[i] - oz[i]) * inv * damping;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (y[i] - radius <= floorHeight(x[i], z[i]) + 1e-4f)
+            {
+                vx[i] *= 1.0f - friction;
+                vz[i] *= 1.0f - friction;
+                vy[i] = std::max(vy[i], 0.0f);
+            }
+        }
+    }
+
+private:
+    static constexpr float RELAXATION = 1.5f;
+
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> ox, oy, oz; // positions at the start of the step
+    std::vector<float> cx, cy, cz; // Jacobi corrections
+    std::vector<float> contacts;   // and the number of contacts behind them
+    std::vector<float> scratch;
+
+    // Grid over the predicted positions
+    std::vector<uint32_t> cellOf;
+    std::vector<uint32_t> cellStart; // cells + 1 prefix sums
+    std::vector<uint32_t> order;
+    Vector3 gridMin;
+    float cellSize = 0.1f;
+    float inverseCellSize = 10.0f;
+    int dims[3] = {1, 1, 1};
+
+    std::vector<std::vector<float>*> arrays()
+    {
+        return {&x, &y, &z, &vx, &vy, &vz, &ox, &oy, &oz};
+    }
+
+    int cellCoord(float v, float lo, int axis) const
+    {
+        int c = (int)((v - lo) * inverseCellSize);
+        return std::max(0, std::min(c, dims[axis] - 1));
+    }
+
+    uint32_t cellIndex(int ix, int iy, int iz) const
+    {
+        return ((uint32_t)iz * dims[1] + iy) * dims[0] + ix;
+    }
+
+    // Counting sort of all arrays into cell order
+    void buildGrid()
+    {
+        size_t n = x.size();
+        float lo[3] = {x[0], y[0], z[0]}, hi[3] = {x[0], y[0], z[0]};
+        for (size_t i = 1; i < n; i++)
+        {
+            lo[0] = std::min(lo[0], x[i]);
+            lo[1] = std::min(lo[1], y[i]);
+            lo[2] = std::min(lo[2], z[i]);
+            hi[0] = std::max(hi[0], x[i]);
+            hi[1] = std::max(hi[1], y[i]);
+            hi[2] = std::max(hi[2], z[i]);
+        }
+        gridMin = Vector3(lo[0], lo[1], lo[2]);
+
+        // Cells at least a diameter wide, grown when stray particles would make the grid
+        // much larger than the particle count
+        cellSize = 2.0f * radius;
+        const double maxCells = std::max<double>(4.0 * n, 64.0);
+        for (;;)
+        {
+            double cells = 1.0;
+            for (int a = 0; a < 3; a++)
+            {
+                double extent = std::min((hi[a] - lo[a]) / (double)cellSize, 1e9);
+                dims[a] = (int)extent + 1;
+                cells *= dims[a];
+            }
+            if (cells <= maxCells)
+                break;
+            cellSize *= 1.5f;
+        }
+        inverseCellSize = 1.0f / cellSize;
+
+        size_t cells = (size_t)dims[0] * dims[1] * dims[2];
+        cellStart.assign(cells + 1, 0);
+        cellOf.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t c = cellIndex(cellCoord(x[i], lo[0], 0), cellCoord(y[i], lo[1], 1),
+                                   cellCoord(z[i], lo[2], 2));
+            cellOf[i] = c;
+            cellStart[c + 1]++;
+        }
+        for (size_t c = 0; c < cells; c++)
+            cellStart[c + 1] += cellStart[c];
+
+        order.resize(n);
+        for (size_t i = 0; i < n; i++)
+            order[cellStart[cellOf[i]]++] = (uint32_t)i;
+        // The scatter advanced each start to the next cell's; shift back
+        for (size_t c = cells; c > 0; c--)
+            cellStart[c] = cellStart[c - 1];
+        cellStart[0] = 0;
+
+        scratch.resize(n);
+        for (std::vector<float>* a : arrays())
+        {
+            for (size_t i = 0; i < n; i++)
+                scratch[i] = (*a)[order[i]];
+            a->swap(scratch);
+        }
+    }
+
+    // Pushes apart particle i and particles [begin, end), half the overlap each, and
+    // counts the contacts on both sides. Runs are short (a handful of particles), where
+    // skipping the square root for the many non-touching candidates beats a branch-free
+    // vector loop. Exact duplicates fall out through the d2 test.
+    void collideRun(uint32_t i, uint32_t begin, uint32_t end)
+    {
+        const float px = x[i], py = y[i], pz = z[i];
+        const float diameter = 2.0f * radius;
+        const float diameter2 = diameter * diameter;
+        const float* xs = x.data();
+        const float* ys = y.data();
+        const float* zs = z.data();
+        float* cxs = cx.data();
+        float* cys = cy.data();
+        float* czs = cz.data();
+        float* counts = contacts.data();
+        float ax = 0.0f, ay = 0.0f, az = 0.0f, count = 0.0f;
+        for (uint32_t j = begin; j < end; j++)
+        {
+            float dx = px - xs[j];
+            float dy = py - ys[j];
+            float dz = pz - zs[j];
+            float d2 = dx * dx + dy * dy + dz * dz;
+            if (!(d2 < diameter2 && d2 > 1e-12f))
+                continue;
+            float d = std::sqrt(d2);
+            float s = 0.5f * (diameter - d) / d;
+            ax += dx * s;
+            ay += dy * s;
+            az += dz * s;
+            count += 1.0f;
+            cxs[j] -= dx * s;
+            cys[j] -= dy * s;
+            czs[j] -= dz * s;
+            counts[j] += 1.0f;
+        }
+        cxs[i] += ax;
+        cys[i] += ay;
+        czs[i] += az;
+        counts[i] += count;
+    }
+
+    // One Jacobi pass over every pair. Each cell only looks at the half of its neighbours
+    // that come after it (the rest of its own row, then four rows ahead), so every pair
+    // is visited once; the three cells of a row are one contiguous run.
+    void solveParticles()
+    {
+        size_t n = x.size();
+        std::fill(cx.begin(), cx.end(), 0.0f);
+        std::fill(cy.begin(), cy.end(), 0.0f);
+        std::fill(cz.begin(), cz.end(), 0.0f);
+        std::fill(contacts.begin(), contacts.end(), 0.0f);
+
+        static const int ROWS[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}}; // (dy, dz)
+        for (int iz = 0; iz < dims[2]; iz++)
+        {
+            for (int iy = 0; iy < dims[1]; iy++)
+            {
+                for (int ix = 0; ix < dims[0]; ix++)
+                {
+                    uint32_t c = cellIndex(ix, iy, iz);
+                    uint32_t begin = cellStart[c], end = cellStart[c + 1];
+                    if (begin == end)
+                        continue;
+                    int x0 = std::max(ix - 1, 0), x1 = std::min(ix + 1, dims[0] - 1);
+                    uint32_t rowEnd = cellStart[cellIndex(x1, iy, iz) + 1];
+                    for (uint32_t i = begin; i < end; i++)
+                    {
+                        collideRun(i, i + 1, rowEnd);
+                        for (const int* row : ROWS)
+                        {
+                            int ny = iy + row[0], nz = iz + row[1];
+                            if (ny < 0 || ny >= dims[1] || nz >= dims[2])
+                                continue;
+                            collideRun(i, cellStart[cellIndex(x0, ny, nz)],
+                                       cellStart[cellIndex(x1, ny, nz) + 1]);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Averaged over each particle's contacts (with over-relaxation) so a grain
+        // squeezed from many sides is not pushed by the sum of all of them
+        for (size_t i = 0; i < n; i++)
+        {
+            float scale = contacts[i] > 1.0f ? RELAXATION / contacts[i] : 1.0f;
+            x[i] += cx[i] * scale;
+            y[i] += cy[i] * scale;
+            z[i] += cz[i] * scale;
+        }
+    }
+
+    template <typename FloorHeight>
+    void solveFloor(FloorHeight floorHeight)
+    {
+        for (size_t i = 0; i < x.size(); i++)
+            y[i] = std::max(y[i], floorHeight(x[i], z[i]) + radius);
+    }
+
+    // Pushes particles out of bodies. With two-way coupling, the first pass also hands
+    // each body the impulse that stops the approaching particles (a plastic contact
+    // between the particle and the body, ignoring the body's rotation).
+    void solveBodies(SlotMap<RigidBody>& bodies, bool exchange)
+    {
+        AABB particleBounds(gridMin - Vector3(radius, radius, radius),
+                            gridMin + Vector3(dims[0] * cellSize + radius,
+                                              dims[1] * cellSize + radius,
+                                              dims[2] * cellSize + radius));
+        for (RigidBody& body : bodies)
+        {
+            // Meshes are level geometry; grains only see primitives. Sensors are not solid.
+            if (body.shape->type == MESH || body.isSensor)
+                continue;
+            AABB box = SceneQuery::bodyBounds(&body);
+            box = AABB(box.min - Vector3(radius, radius, radius),
+                       box.max + Vector3(radius, radius, radius));
+            if (!box.overlaps(particleBounds))
+                continue;
+
+            Vector3 impulse(0, 0, 0);
+            Vector3 torque(0, 0, 0);
+            int x0 = cellCoord(box.min.x, gridMin.x, 0), x1 = cellCoord(box.max.x, gridMin.x, 0);
+            int y0 = cellCoord(box.min.y, gridMin.y, 1), y1 = cellCoord(box.max.y, gridMin.y, 1);
+            int z0 = cellCoord(box.min.z, gridMin.z, 2), z1 = cellCoord(box.max.z, gridMin.z, 2);
+            for (int cz = z0; cz <= z1; cz++)
+            {
+                for (int cy = y0; cy <= y1; cy++)
+                {
+                    uint32_t begin = cellStart[cellIndex(x0, cy, cz)];
+                    uint32_t end = cellStart[cellIndex(x1, cy, cz) + 1];
+                    for (uint32_t i = begin; i < end; i++)
+                    {
+                        Vector3 push;
+                        Vector3 p(x[i], y[i], z[i]);
+                        if (!pushOut(body, p, push))
+                            continue;
+                        x[i] += push.x;
+                        y[i] += push.y;
+                        z[i] += push.z;
+                        if (!exchange || coupling != COUPLE_TWO_WAY || !body.hasFiniteMass())
+                            continue;
+                        Vector3 r = p - body.position;
+                        Vector3 relative = Vector3(vx[i], vy[i], vz[i]) -
+                                           (body.velocity + body.angularVelocity.cross(r));
+                        Vector3 normal = push;
+                        normal.normalize();
+                        float approach = relative.dot(normal);
+                        if (approach >= 0.0f)
+                            continue;
+                        Vector3 j = normal * (approach / (1.0f / mass + body.inverseMass));
+                        impulse += j;
+                        torque += r.cross(j);
+                    }
+                }
+            }
+
+            if (impulse.magnitudeSquared() > 0.0f)
+            {
+                body.velocity += impulse * body.inverseMass;
+                body.angularVelocity += body.inverseInertiaTensorWorld * torque;
+                if (!body.isAwake && impulse.magnitudeSquared() * body.inverseMass > 1e-6f)
+                    body.setAwake(true);
+            }
+        }
+    }
+
+    // Displacement that moves a particle at p out of the body, if it overlaps
+    bool pushOut(const RigidBody& body, const Vector3& p, Vector3& push) const
+    {
+        if (body.shape->type == COMPOUND)
+        {
+            // The first overlapping child; the next iteration handles any other
+            for (const Compound::Child& child : ((const Compound*)body.shape)->getChildren())
+            {
+                if (pushOut(SceneQuery::childBody(&body, child), p, push))
+                    return true;
+            }
+            return false;
+        }
+        Vector3 q = SceneQuery::closestPoint(&body, p);
+        Vector3 d = p - q;
+        float d2 = d.magnitudeSquared();
+        if (d2 >= radius * radius)
+            return false;
+        if (d2 > 1e-12f)
+        {
+            float dist = std::sqrt(d2);
+            push = d * ((radius - dist) / dist);
+            return true;
+        }
+
+        // Center inside: leave through the nearest face
+        Vector3 local = CollisionDetector::toLocal(&body, p);
+        Vector3 out; // local exit displacement
+        const Shape* shape = body.shape;
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            float dx = h.x - std::abs(local.x);
+            float dy = h.y - std::abs(local.y);
+            float dz = h.z - std::abs(local.z);
+            if (dx <= dy && dx <= dz)
+                out = Vector3(std::copysign(dx + radius, local.x), 0, 0);
+            else if (dy <= dz)
+                out = Vector3(0, std::copysign(dy + radius, local.y), 0);
+            else
+                out = Vector3(0, 0, std::copysign(dz + radius, local.z));
+        }
+        else if (shape->type == CYLINDER)
+        {
+            const Cylinder* c = (const Cylinder*)shape;
+            float r = std::sqrt(local.x * local.x + local.z * local.z);
+            float dy = c->halfHeight - std::abs(local.y);
+            if (dy <= c->radius - r || r < 1e-6f)
+                out = Vector3(0, std::copysign(dy + radius, local.y), 0);
+            else
+                out = Vector3(local.x, 0, local.z) * ((c->radius - r + radius) / r);
+        }
+        else if (shape->type == CAPSULE)
+        {
+            // Radially away from the core segment
+            const Capsule* c = (const Capsule*)shape;
+            Vector3 s(0, std::max(-c->halfLength, std::min(local.y, c->halfLength)), 0);
+            Vector3 d = local - s;
+            float len = d.magnitude();
+            Vector3 dir = len > 1e-6f ? d * (1.0f / len) : Vector3(1, 0, 0);
+            out = dir * (c->radius - len + radius);
+        }
+        else if (shape->type == PYRAMID || shape->type == HULL)
+        {
+            // Through the face plane nearest to the centre
+            Polyhedron poly;
+            Polyhedron::of(shape, poly);
+            int face = 0;
+            float depth = 1e30f;
+            for (int i = 0; i < poly.faceCount; i++)
+            {
+                float d = poly.offsets[i] - poly.normals[i].dot(local);
+                if (d < depth)
+                {
+                    depth = d;
+                    face = i;
+                }
+            }
+            out = poly.normals[face] * (depth + radius);
+        }
+        else
+        {
+            // Spheres and anything else: radially
+            float len = local.magnitude();
+            Vector3 dir = len > 1e-6f ? local * (1.0f / len) : Vector3(0, 1, 0);
+            out = dir * (shape->boundingRadius - len + radius);
+        }
+        push = body.orientation.rotate(out);
+        return true;
+    }
+};
@@ -0,0 +1,2225 @@
+#pragma once
+#include "ArticulationSolver.h"
+#include "CollisionDetector.h"
+#include "CollisionFilter.h"
+#include "CommandBuffer.h"
+#include "Constraint.h"
+#include "ConstraintSolver.h"
+#include "ContactEvents.h"
+#include "ContactSolver.h"
+#include "DebugDraw.h"
+#include "ConvexCollider.h"
+#include "DynamicTree.h"
+#include "FrameAllocator.h"
+#include "ParticleSystem.h"
+#include "RateTiers.h"
+#include "RigidBody.h"
+#include "SceneFile.h"
+#include "SceneQuery.h"
+#include "SensorEvents.h"
+#include "SlotMap.h"
+#include "SolverStats.h"
+#include "SpatialSort.h"
+#include "StepBudget.h"
+#include "TransformStream.h"
+#include "Vector3.h"
+#include "WorldConfig.h"
+#include "../geometry/ShapeRegistry.h"
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// The world, specialized at compile time by a Config (see WorldConfig.h). PhysicsWorld,
+// the instantiation exported to JS, uses DefaultWorldConfig.
+template <typename Config>
+class BasicPhysicsWorld
+{
+    static_assert(std::is_same<typename Config::Scalar, float>::value,
+                  "BasicPhysicsWorld only supports float scalars");
+    static_assert(Config::substeps >= 1, "at least one substep is required");
+
+    static constexpr bool hasShape(ShapeType type)
+    {
+        return (Config::shapes & shapeBit(type)) != 0;
+    }
+
+    // Bodies and constraints are stored densely and addressed from JS by generational
+    // handles, so removal is a swap with the last element.
+    SlotMap<RigidBody> bodies;
+    Vector3 gravity = Vector3(0, -9.81f, 0);
+    SlotMap<Constraint> constraints;
+    std::vector<Constraint*> iterativeConstraints;
+    ConstraintSolver constraintSolver;
+    ArticulationSolver articulationSolver;
+    ContactSolver contactSolver;
+    SolverStats solverStats;
+    bool constraintGraphDirty = false;
+    // Set whenever body storage moves, so constraints re-resolve their body pointers
+    bool bodyStorageDirty = false;
+
+    // Shared with the worlds cloned from this one (see cloneFrom)
+    std::shared_ptr<ShapeRegistry> shapes = std::make_shared<ShapeRegistry>();
+
+    // Transient per-step data (pairs, contacts, solver scratch), rewound every step
+    FrameAllocator frame;
+
+    // Broadphase and scene queries; leaves carry body handles
+    DynamicTree tree;
+    CollisionFilter filter;
+
+    ContactEventRecorder contactEvents;
+
+    // Enter/exit events of sensor bodies, rebuilt once per step
+    SensorTracker sensors;
+    int sensorCount = 0;
+
+    // Per-body edits queued by JS, applied in one pass at the start of a step
+    CommandRing commands;
+    std::vector<uint64_t> commandOrder;
+
+    // Quantized transform snapshots and delta packets for remote viewers
+    TransformEncoder transformStream;
+
+    // Line/point geometry for debug rendering, built at the end of a step when enabled
+    DebugDraw debugDraw;
+
+    // Last step's GJK simplex per convex pair, to warm start the next
+    SimplexCache simplices;
+
+    // Optional Morton-order reordering of body storage, a slice per frame
+    SpatialSorter spatialSorter;
+
+    // Phase timing and the time-budget policy of stepWithBudget
+    StepBudget budget;
+
+    RateTiers rateTiers;
+
+    // Granular particles, stepped once per frame after the bodies
+    ParticleSystem particles;
+    std::vector<float> particlePositions;
+
+    // Static terrain; when set it takes the place of the y = 0 floor plane. Immutable, so
+    // clones share it.
+    std::shared_ptr<const Heightfield> terrain;
+
+    // Flat buffers shared with JS through typed-array views
+    std::vector<float> rayInput;
+    std::vector<float> rayResults;
+    std::vector<uint32_t> overlapResults;
+    std::vector<uint8_t> sceneData;
+
+public:
+    BasicPhysicsWorld()
+    {
+        constraintSolver.maxIterations = Config::constraintIterations;
+        contactSolver.maxIterations = Config::contactIterations;
+    }
+
+    ~BasicPhysicsWorld() { reset(); }
+
+    uint32_t addSphere(float x, float y, float z, float radius, float mass)
+    {
+        static_assert(hasShape(SPHERE), "spheres are disabled in this world's Config");
+        RigidBody body(shapes->sphere(radius), x, y, z, mass);
+        body.friction = 0.5f;
+        return insertBody(body);
+    }
+
+    uint32_t addBox(float x, float y, float z, float w, float h, float d, float mass)
+    {
+        static_assert(hasShape(BOX), "boxes are disabled in this world's Config");
+        RigidBody body(shapes->box(w, h, d), x, y, z, mass);
+        body.restitution = 0.5f;
+        body.friction = 0.5f;
+        return insertBody(body);
+    }
+
+    void setGravity(float gy) { gravity.y = gy; }
+
+    void setRestitution(float r)
+    {
+        for (auto& body : bodies)
+        {
+            body.restitution = r;
+        }
+    }
+
+    void reset()
+    {
+        for (auto& body : bodies)
+        {
+            shapes->release(body.shape);
+        }
+        bodies.clear();
+        tree.clear();
+        filter.clear();
+        contactEvents.clear();
+        sensors.clear();
+        sensorCount = 0;
+        transformStream.clear();
+        debugDraw.clear();
+        commands.consume();
+        simplices.clear();
+        spatialSorter.clear();
+        particles.clear();
+        constraints.clear();
+        iterativeConstraints.clear();
+        constraintGraphDirty = true;
+        bodyStorageDirty = false;
+    }
+
+    // Replaces this world with a copy of seed that steps exactly as the seed would. Body and
+    // constraint storage are trivially copyable and copied wholesale, so handles and dense
+    // indices carry over; shapes and terrain are shared rather than duplicated.
+    void cloneFrom(const BasicPhysicsWorld& seed)
+    {
+        if (&seed == this)
+            return;
+        reset();
+        shapes = seed.shapes;
+        for (const RigidBody& body : seed.bodies)
+            shapes->retain(body.shape);
+        bodies = seed.bodies;
+        gravity = seed.gravity;
+        constraints = seed.constraints;
+        constraintSolver = seed.constraintSolver;
+        articulationSolver.maxIterations = seed.articulationSolver.maxIterations;
+        articulationSolver.tolerance = seed.articulationSolver.tolerance;
+        articulationSolver.minConstraints = seed.articulationSolver.minConstraints;
+        contactSolver = seed.contactSolver;
+        tree = seed.tree;
+        filter = seed.filter;
+        contactEvents = seed.contactEvents;
+        sensors = seed.sensors;
+        sensorCount = seed.sensorCount;
+        simplices = seed.simplices;
+        spatialSorter = seed.spatialSorter;
+        budget = seed.budget;
+        rateTiers = seed.rateTiers;
+        particles = seed.particles;
+        terrain = seed.terrain;
+        // Constraint body pointers and articulations still point into the seed
+        bodyStorageDirty = true;
+        constraintGraphDirty = true;
+    }
+
+    // Removes a body and every constraint attached to it. Returns false for stale handles.
+    bool removeBody(uint32_t handle)
+    {
+        RigidBody* body = bodies.get(handle);
+        if (!body)
+            return false;
+
+        while (body->firstConstraint != 0)
+            removeConstraint(body->firstConstraint);
+
+        filter.removeBody(handle, bodies);
+        if (body->isSensor)
+            sensorCount--;
+        shapes->release(body->shape);
+        tree.destroyProxy(body->proxy);
+        bodies.erase(handle);
+        bodyStorageDirty = true;
+        return true;
+    }
+
+    bool removeConstraint(uint32_t handle)
+    {
+        Constraint* c = constraints.get(handle);
+        if (!c)
+            return false;
+
+        unlinkConstraint(c->bodyHandleA, handle, c->nextA);
+        if (c->bodyHandleB != c->bodyHandleA)
+            unlinkConstraint(c->bodyHandleB, handle, c->nextB);
+
+        RigidBody* a = bodies.get(c->bodyHandleA);
+        RigidBody* b = bodies.get(c->bodyHandleB);
+        if (a && b && !c->collideConnected)
+            filter.restore(*a, c->bodyHandleA, *b, c->bodyHandleB);
+        if (a)
+            a->setAwake(true);
+        if (b)
+            b->setAwake(true);
+
+        // The swap moves another constraint; its list entries are handles, so only the
+        // solver's pointer lists need rebuilding.
+        constraints.erase(handle);
+        constraintGraphDirty = true;
+        return true;
+    }
+
+    uint32_t getBodyHandle(int index)
+    {
+        if (index >= 0 and index < (int)bodies.size())
+        {
+            return bodies.handleAt(index);
+        }
+        return 0;
+    }
+
+    // Dense index of a body for the index-based accessors, or -1 if the handle is stale
+    int getBodyIndex(uint32_t handle) { return bodies.indexOf(handle); }
+
+    int getConstraintCount() { return constraints.size(); }
+
+    // Number of distinct shape definitions currently shared by the bodies
+    int getShapeCount() { return shapes->size(); }
+
+    // Heap allocations made by the frame allocator during the last step; stays at zero
+    // once the arena has grown to the scene's peak
+    int getStepHeapAllocations() { return frame.heapAllocations(); }
+
+    int getFrameArenaBytes() { return frame.capacity(); }
+
+    void step(float dt) { stepWithBudget(dt, 0.0f); }
+
+    // Steps the world, trading accuracy for time when the step would take longer than
+    // budgetUs microseconds (0 = no budget). getStepDegradations() reports what was cut.
+    void stepWithBudget(float dt, float budgetUs)
+    {
+        const int substeps = Config::substeps;
+        budget.beginFrame(budgetUs);
+        solverStats.reset();
+        frame.reset();
+        if (contactEvents.enabled)
+            contactEvents.beginFrame();
+        if (!budget.deferSpatialSort(substeps) && spatialSorter.update(bodies))
+            bodyStorageDirty = true;
+        if (commands.pending() > 0)
+            applyCommands();
+
+        if (bodyStorageDirty)
+        {
+            for (auto& c : constraints)
+            {
+                c.bodyA = bodies.get(c.bodyHandleA);
+                c.bodyB = bodies.get(c.bodyHandleB);
+            }
+            bodyStorageDirty = false;
+        }
+        if (constraintGraphDirty)
+        {
+            FrameVector<Constraint*> all{FrameAllocatorAdapter<Constraint*>(frame)};
+            all.reserve(constraints.size());
+            for (auto& c : constraints)
+                all.push_back(&c);
+            articulationSolver.build(all.data(), all.size(), iterativeConstraints, frame);
+            constraintGraphDirty = false;
+        }
+
+        rateTiers.beginFrame(bodies, tree, dt);
+        if (!budget.deferSleepCheck(substeps))
+            updateSleep();
+        budget.mark(PHASE_SETUP);
+
+        // Over budget, the first step down is fewer iterations; if that is not enough,
+        // the rest of the frame runs as a single substep
+        const int iterations = constraintSolver.maxIterations;
+        const int articulationIterations = articulationSolver.maxIterations;
+        const int contactIterations = contactSolver.maxIterations;
+        float subDt = dt / substeps;
+        int sub = 0;
+        while (sub < substeps)
+        {
+            int covered = 1;
+            if (budget.overBudget(substeps - sub))
+            {
+                if (!(budget.degradations & DEGRADE_ITERATIONS))
+                {
+                    constraintSolver.maxIterations = std::min(iterations, 2);
+                    articulationSolver.maxIterations = 1;
+                    contactSolver.maxIterations = 1;
+                    budget.degradations |= DEGRADE_ITERATIONS;
+                }
+                else if (substeps - sub > 1)
+                {
+                    covered = substeps - sub;
+                    budget.degradations |= DEGRADE_SUBSTEPS;
+                }
+            }
+            budget.substepStart();
+            substep(subDt * covered);
+            budget.substepEnd(covered);
+            sub += covered;
+        }
+        constraintSolver.maxIterations = iterations;
+        articulationSolver.maxIterations = articulationIterations;
+        contactSolver.maxIterations = contactIterations;
+
+        if (particles.size() > 0)
+        {
+            auto floorHeight = [&](float x, float z)
+            {
+                if constexpr (Config::floorPlane)
+                {
+                    float height;
+                    Vector3 normal;
+                    if (!terrain)
+                        return 0.0f;
+                    if (terrain->surfaceAt(x, z, height, normal))
+                        return height;
+                }
+                return -1e30f;
+            };
+            particles.step(dt, gravity, floorHeight, bodies);
+        }
+        budget.mark(PHASE_PARTICLES);
+
+        // One more pass after the last sensor is removed closes its pairs; after that the
+        // pass is skipped, but the last step's events still have to go
+        if (sensorCount > 0 || sensors.hasOverlaps())
+            updateSensors();
+        else
+            sensors.clearEvents();
+        budget.mark(PHASE_SENSORS);
+
+        if (contactEvents.enabled)
+        {
+            // Pairs that fell asleep stop producing contacts but have not separated
+            auto resting = [&](uint32_t handle)
+            {
+                const RigidBody* body = handle ? bodies.get(handle) : nullptr;
+                return handle == 0 || (body && !body->isAwake);
+            };
+            contactEvents.endFrame([&](uint32_t a, uint32_t b)
+                                   { return resting(a) && resting(b); });
+        }
+        budget.endFrame();
+
+        // Outside the phase timings, so enabling it does not eat into the step budget
+        if (debugDraw.flags)
+            buildDebugDraw();
+    }
+
+    // Distance-based rate tiers: far bodies step every 2nd, 4th or 8th frame
+    void setRateTiersEnabled(bool enabled)
+    {
+        if (enabled)
+            rateTiers.enabled = true;
+        else
+            rateTiers.disable(bodies);
+    }
+
+    // Tier boundaries: tier 0 within near, 1 within mid, 2 within far, 3 beyond
+    void setRateTierDistances(float near, float mid, float far)
+    {
+        rateTiers.distances[0] = near;
+        rateTiers.distances[1] = std::max(mid, near);
+        rateTiers.distances[2] = std::max(far, mid);
+    }
+
+    // Focus points as packed xyz triples
+    void setRateFocusPoints(const float* xyz, size_t count) { rateTiers.setFocus(xyz, count); }
+
+    // Pins a body to a tier (0-3); -1 returns it to distance-based tiering
+    void setBodyRateTier(uint32_t handle, int tier)
+    {
+        if (RigidBody* body = bodies.get(handle))
+        {
+            body->manualRateTier = (int8_t)std::max(-1, std::min(tier, RateTiers::TIER_COUNT - 1));
+        }
+    }
+
+    int getBodyRateTier(uint32_t handle)
+    {
+        const RigidBody* body = bodies.get(handle);
+        return body ? body->rateTier : -1;
+    }
+
+    // StepDegradation bits applied by the last step
+    uint32_t getStepDegradations() { return budget.degradations; }
+
+    float getStepTimeUs() { return budget.totalUs; }
+
+    // One SolverStat of the last step: iterations used and final residuals
+    float getSolverStat(int stat)
+    {
+        if (stat >= 0 and stat < STAT_COUNT)
+        {
+            return solverStats.values[stat];
+        }
+        return 0.0f;
+    }
+
+    // Time spent in one StepPhase during the last step
+    float getPhaseTimeUs(int phase)
+    {
+        if (phase >= 0 and phase < PHASE_COUNT)
+        {
+            return budget.phaseUs[phase];
+        }
+        return 0.0f;
+    }
+
+    // Periodically reorders body storage by position for cache locality. Handles are
+    // unaffected, but dense indices (getBodyPosition(i) and friends) no longer follow a
+    // body; resolve them with getBodyIndex(handle).
+    void setSpatialSortEnabled(bool enabled)
+    {
+        spatialSorter.enabled = enabled;
+        spatialSorter.clear();
+        if (enabled)
+            spatialSorter.requestPass();
+    }
+
+    void setSpatialSortRate(int intervalFrames, int bodiesPerFrame)
+    {
+        spatialSorter.interval = std::max(intervalFrames, 1);
+        spatialSorter.bodiesPerFrame = std::max(bodiesPerFrame, 1);
+    }
+
+    void setContactEventsEnabled(bool enabled)
+    {
+        contactEvents.enabled = enabled;
+        contactEvents.clear();
+    }
+
+    // Minimum summed normal impulse per frame for begin and persist events
+    void setContactEventThresholds(float beginImpulse, float persistImpulse)
+    {
+        contactEvents.beginThreshold = beginImpulse;
+        contactEvents.persistThreshold = persistImpulse;
+    }
+
+    int getContactEventCount() { return (int)contactEvents.size(); }
+
+    // The last step's begin/persist/end events, getContactEventCount() of them; valid until
+    // the next step
+    const ContactEvent* getContactEventData() const { return contactEvents.data(); }
+
+    // Turns a body into a sensor or back. A sensor never collides; each step it reports the
+    // dynamic bodies that start or stop overlapping it, subject to the collision filter.
+    // A sensor with mass still falls, so trigger volumes are usually static.
+    void setBodySensor(uint32_t handle, bool sensor)
+    {
+        RigidBody* body = bodies.get(handle);
+        if (!body || body->isSensor == sensor)
+            return;
+        body->isSensor = sensor;
+        sensorCount += sensor ? 1 : -1;
+        // Whatever rests on it has to notice that it is gone, or has come back
+        tree.query(SceneQuery::bodyBounds(body),
+                   [&](int proxy)
+                   {
+                       RigidBody& other = *bodies.get(tree.getUserData(proxy));
+                       if (other.hasFiniteMass())
+                           other.setAwake(true);
+                       return true;
+                   });
+    }
+
+    bool isBodySensor(uint32_t handle)
+    {
+        const RigidBody* body = bodies.get(handle);
+        return body && body->isSensor;
+    }
+
+    int getSensorEventCount() { return (int)sensors.size(); }
+
+    // The last step's enter/exit events, getSensorEventCount() of them; valid until the
+    // next step
+    const SensorEvent* getSensorEventData() const { return sensors.data(); }
+
+    // Collects the handles of every body overlapping the sphere; they are in
+    // getOverlapResultData() until the next query. Returns how many there are.
+    int overlapSphereData(float x, float y, float z, float radius)
+    {
+        Vector3 center(x, y, z);
+        overlapResults.clear();
+        tree.query(AABB::fromCenter(center, Vector3(radius, radius, radius)),
+                   [&](int proxy)
+                   {
+                       uint32_t handle = tree.getUserData(proxy);
+                       const RigidBody* body = bodies.get(handle);
+                       if (SceneQuery::overlapSphere(body, center, radius))
+                           overlapResults.push_back(handle);
+                       return true;
+                   });
+        return (int)overlapResults.size();
+    }
+
+    // Same for an axis-aligned box given by its centre and half extents
+    int overlapBoxData(float cx, float cy, float cz, float hx, float hy, float hz)
+    {
+        AABB box = AABB::fromCenter(Vector3(cx, cy, cz), Vector3(hx, hy, hz));
+        overlapResults.clear();
+        tree.query(box,
+                   [&](int proxy)
+                   {
+                       uint32_t handle = tree.getUserData(proxy);
+                       const RigidBody* body = bodies.get(handle);
+                       if (SceneQuery::overlapBox(body, box))
+                           overlapResults.push_back(handle);
+                       return true;
+                   });
+        return (int)overlapResults.size();
+    }
+
+    const uint32_t* getOverlapResultData() const { return overlapResults.data(); }
+
+    // Bound and precision (8-24 bits per axis) of streamed positions; positions outside
+    // are clamped. Changing either makes the next packets full frames.
+    void setStreamBounds(float minX, float minY, float minZ, float maxX, float maxY, float maxZ,
+                         int positionBits)
+    {
+        transformStream.setBounds(AABB(Vector3(minX, minY, minZ), Vector3(maxX, maxY, maxZ)),
+                                  positionBits);
+    }
+
+    // Snapshots the body transforms for the stream, typically once after each step;
+    // returns the snapshot's sequence number
+    uint32_t captureTransforms() { return transformStream.capture(bodies); }
+
+    // Encodes the last snapshot against baseline, the newest sequence the viewer has
+    // acknowledged (0 for a full frame). Returns the packet size in bytes.
+    int encodeTransforms(uint32_t baseline)
+    {
+        return (int)transformStream.encode(baseline).size();
+    }
+
+    const std::vector<uint8_t>& getTransformPacketData() const
+    {
+        return transformStream.getPacket();
+    }
+
+    // DebugDrawFlag bits; 0 turns debug drawing off and costs nothing in the step
+    void setDebugDrawFlags(uint32_t flags)
+    {
+        debugDraw.flags = flags;
+        debugDraw.clear();
+    }
+
+    uint32_t getDebugDrawFlags() { return debugDraw.flags; }
+
+    // Size of the last step's debug buffer: line vertices (pairs) first, then points
+    int getDebugLineVertexCount() { return debugDraw.getLineVertexCount(); }
+
+    int getDebugPointCount() { return debugDraw.getPointCount(); }
+
+    const DebugVertex* getDebugVertexData() const { return debugDraw.data(); }
+
+    int getBodyCount() { return bodies.size(); }
+
+    // Floats per body written by readBodyStates: position, orientation (w, x, y, z),
+    // velocity and angular velocity
+    static constexpr int BODY_STATE_STRIDE = 13;
+
+    // Writes the state of up to maxBodies bodies in dense order; returns how many it wrote
+    int readBodyStates(float* out, int maxBodies) const
+    {
+        int count = std::min(maxBodies, (int)bodies.size());
+        for (int i = 0; i < count; i++, out += BODY_STATE_STRIDE)
+        {
+            const RigidBody& body = bodies[i];
+            const Vector3& p = body.position;
+            const Quaternion& q = body.orientation;
+            const Vector3& v = body.velocity;
+            const Vector3& w = body.angularVelocity;
+            const float state[BODY_STATE_STRIDE] = {p.x, p.y, p.z, q.w, q.x, q.y, q.z,
+                                                    v.x, v.y, v.z, w.x, w.y, w.z};
+            std::memcpy(out, state, sizeof(state));
+        }
+        return count;
+    }
+
+    void setVelocity(int index, float vx, float vy, float vz)
+    {
+        if (index >= 0 and index < (int)bodies.size())
+        {
+            bodies[index].velocity = Vector3(vx, vy, vz);
+        }
+    }
+
+    void applyForce(int index, float fx, float fy, float fz)
+    {
+        if (index >= 0 and index < (int)bodies.size())
+        {
+            bodies[index].addForce(Vector3(fx, fy, fz));
+        }
+    }
+
+    void setFriction(float f)
+    {
+        for (auto& body : bodies)
+        {
+            body.friction = f;
+        }
+    }
+
+    // Queues a BodyCommand for the next step; false while the ring is full
+    bool pushCommand(uint32_t type, uint32_t handle, float x, float y, float z)
+    {
+        return commands.push(type, handle, x, y, z);
+    }
+
+    int getPendingCommandCount() { return (int)commands.pending(); }
+
+    int getCommandCapacity() { return (int)commands.capacity(); }
+
+    // Applies what is queued, then reallocates the ring (rounded up to a power of two).
+    // Views of the old ring are invalid afterwards.
+    void setCommandCapacity(int capacity)
+    {
+        applyCommands();
+        commands.allocate((uint32_t)std::max(capacity, 1));
+    }
+
+    // Applies the queued commands now instead of at the next step, e.g. when the ring is
+    // full. They are sorted by dense body index so the pass walks body storage forwards;
+    // commands on the same body keep their order. Commands on removed bodies, unknown
+    // types and motion commands on static bodies are dropped.
+    void applyCommands()
+    {
+        const uint32_t count = commands.pending();
+        commandOrder.clear();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            BodyCommand command = commands.at(i);
+            int index = bodies.indexOf(command.handle);
+            if (index >= 0 && command.type < COMMAND_TYPE_COUNT)
+                commandOrder.push_back((uint64_t)index << 32 | i);
+        }
+        std::sort(commandOrder.begin(), commandOrder.end());
+
+        for (uint64_t key : commandOrder)
+        {
+            BodyCommand command = commands.at((uint32_t)key);
+            RigidBody& body = bodies[key >> 32];
+            Vector3 v(command.x, command.y, command.z);
+            if (command.type == COMMAND_FRICTION)
+            {
+                body.friction = command.x;
+                continue;
+            }
+            if (command.type == COMMAND_RESTITUTION)
+            {
+                body.restitution = command.x;
+                continue;
+            }
+            if (!body.hasFiniteMass())
+                continue;
+            switch (command.type)
+            {
+            case COMMAND_FORCE:
+                body.addForce(v);
+                break;
+            case COMMAND_IMPULSE:
+                body.velocity += v * body.inverseMass;
+                body.setAwake(true);
+                break;
+            case COMMAND_TORQUE:
+                body.addTorque(v);
+                break;
+            case COMMAND_VELOCITY:
+                body.velocity = v;
+                body.setAwake(true);
+                break;
+            case COMMAND_ANGULAR_VELOCITY:
+                body.angularVelocity = v;
+                body.setAwake(true);
+                break;
+            case COMMAND_WAKE:
+                body.setAwake(true);
+                break;
+            case COMMAND_SLEEP:
+                body.setAwake(false);
+                break;
+            }
+        }
+        commands.consume();
+    }
+
+    void updateInertiaTensors()
+    {
+        for (auto& body : bodies)
+        {
+            if (body.inverseMass > 0)
+            {
+                Quaternion& q = body.orientation;
+                Matrix3 rotMatrix;
+                float xx = q.x * q.x, xy = q.x * q.y, xz = q.x * q.z, xw = q.x * q.w;
+                float yy = q.y * q.y, yz = q.y * q.z, yw = q.y * q.w;
+                float zz = q.z * q.z, zw = q.z * q.w;
+                rotMatrix.data[0] = 1.0f - 2.0f * (yy + zz);
+                rotMatrix.data[1] = 2.0f * (xy - zw);
+                rotMatrix.data[2] = 2.0f * (xz + yw);
+                rotMatrix.data[3] = 2.0f * (xy + zw);
+                rotMatrix.data[4] = 1.0f - 2.0f * (xx + zz);
+                rotMatrix.data[5] = 2.0f * (yz - xw);
+                rotMatrix.data[6] = 2.0f * (xz - yw);
+                rotMatrix.data[7] = 2.0f * (yz + xw);
+                rotMatrix.data[8] = 1.0f - 2.0f * (xx + yy);
+                Matrix3 rotT = rotMatrix.transpose();
+                body.inverseInertiaTensorWorld = rotMatrix * body.inverseInertiaTensor * rotT;
+            }
+        }
+    }
+
+    uint32_t addCylinder(float x, float y, float z, float radius, float height, float mass)
+    {
+        static_assert(hasShape(CYLINDER), "cylinders are disabled in this world's Config");
+        RigidBody body(shapes->cylinder(radius, height), x, y, z, mass);
+        body.friction = 0.5f;
+        body.restitution = 0.5f;
+        return insertBody(body);
+    }
+
+    // length is the distance between the two cap centres, along the local y axis
+    uint32_t addCapsule(float x, float y, float z, float radius, float length, float mass)
+    {
+        static_assert(hasShape(CAPSULE), "capsules are disabled in this world's Config");
+        RigidBody body(shapes->capsule(radius, length), x, y, z, mass);
+        body.friction = 0.5f;
+        body.restitution = 0.5f;
+        return insertBody(body);
+    }
+
+    // Square pyramid standing on its base; the body's position is its centre of mass, a
+    // quarter of the height above the base
+    uint32_t addPyramid(float x, float y, float z, float width, float height, float mass)
+    {
+        static_assert(hasShape(PYRAMID), "pyramids are disabled in this world's Config");
+        RigidBody body(shapes->pyramid(width, height), x, y, z, mass);
+        body.friction = 0.5f;
+        body.restitution = 0.5f;
+        return insertBody(body);
+    }
+
+    // Convex hull of count packed xyz points (up to ConvexHull::MAX_VERTICES of them may
+    // end up on the hull), given around (x, y, z). The body sits at the hull's centre of
+    // mass, see getConvexHullCenterData. Returns 0 for flat or oversized point sets.
+    uint32_t addConvexHullData(float x, float y, float z, const float* points, int count,
+                               float mass)
+    {
+        static_assert(hasShape(HULL), "hulls are disabled in this world's Config");
+        const ConvexHull* shape = (const ConvexHull*)shapes->hull(points, count);
+        if (!shape->isValid())
+        {
+            shapes->release(shape);
+            return 0;
+        }
+        Vector3 center = shape->getCenterOfMass();
+        RigidBody body(shape, x + center.x, y + center.y, z + center.z, mass);
+        body.friction = 0.5f;
+        body.restitution = 0.5f;
+        return insertBody(body);
+    }
+
+    // Centre of mass of a hull relative to the point its points were given around. Returns
+    // false if the body is not a hull.
+    bool getConvexHullCenterData(uint32_t handle, float out[3])
+    {
+        const RigidBody* body = bodies.get(handle);
+        if (!body || body->shape->type != HULL)
+            return false;
+        Vector3 center = ((const ConvexHull*)body->shape)->getCenterOfMass();
+        out[0] = center.x;
+        out[1] = center.y;
+        out[2] = center.z;
+        return true;
+    }
+
+    // Returns the constraint handle, or 0 if either index is out of range
+    uint32_t addConstraint(int indexA, int indexB, float length)
+    {
+        if (indexA < 0 || indexA >= (int)bodies.size())
+            return 0;
+        if (indexB < 0 || indexB >= (int)bodies.size())
+            return 0;
+
+        Constraint c(&bodies[indexA], &bodies[indexB], length);
+        c.bodyHandleA = bodies.handleAt(indexA);
+        c.bodyHandleB = bodies.handleAt(indexB);
+        c.nextA = bodies[indexA].firstConstraint;
+        c.nextB = indexA != indexB ? bodies[indexB].firstConstraint : 0;
+        uint32_t handle = constraints.insert(c);
+        bodies[indexA].firstConstraint = handle;
+        bodies[indexB].firstConstraint = handle;
+        filter.ignore(bodies[indexA], c.bodyHandleA, bodies[indexB], c.bodyHandleB);
+
+        constraintGraphDirty = true;
+        bodies[indexA].setAwake(true);
+        bodies[indexB].setAwake(true);
+        return handle;
+    }
+
+    void setConstraintCompliance(uint32_t handle, float compliance)
+    {
+        if (Constraint* c = constraints.get(handle))
+        {
+            c->compliance = std::max(compliance, 0.0f);
+        }
+    }
+
+    // Lets the two bodies of a constraint collide with each other (off by default)
+    void setConstraintCollideConnected(uint32_t handle, bool collide)
+    {
+        Constraint* c = constraints.get(handle);
+        if (!c || c->collideConnected == collide)
+            return;
+        RigidBody* a = bodies.get(c->bodyHandleA);
+        RigidBody* b = bodies.get(c->bodyHandleB);
+        c->collideConnected = collide;
+        if (collide)
+            filter.restore(*a, c->bodyHandleA, *b, c->bodyHandleB);
+        else
+            filter.ignore(*a, c->bodyHandleA, *b, c->bodyHandleB);
+    }
+
+    void setCollisionFilter(uint32_t handle, uint32_t category, uint32_t mask)
+    {
+        if (RigidBody* body = bodies.get(handle))
+        {
+            body->collisionCategory = category;
+            body->collisionMask = mask;
+            body->setAwake(true);
+        }
+    }
+
+    // Excludes a pair from collision (e.g. a projectile and its owner). Exclusions are
+    // counted: each ignoreCollision needs a matching restoreCollision.
+    void ignoreCollision(uint32_t handleA, uint32_t handleB)
+    {
+        RigidBody* a = bodies.get(handleA);
+        RigidBody* b = bodies.get(handleB);
+        if (a && b)
+            filter.ignore(*a, handleA, *b, handleB);
+    }
+
+    void restoreCollision(uint32_t handleA, uint32_t handleB)
+    {
+        RigidBody* a = bodies.get(handleA);
+        RigidBody* b = bodies.get(handleB);
+        if (a && b && filter.restore(*a, handleA, *b, handleB))
+        {
+            a->setAwake(true);
+            b->setAwake(true);
+        }
+    }
+
+    void setConstraintAnchors(uint32_t handle, float ax, float ay, float az, float bx, float by,
+                              float bz)
+    {
+        if (Constraint* c = constraints.get(handle))
+        {
+            c->anchorA = Vector3(ax, ay, az);
+            c->anchorB = Vector3(bx, by, bz);
+            bodies.get(c->bodyHandleA)->setAwake(true);
+            bodies.get(c->bodyHandleB)->setAwake(true);
+        }
+    }
+
+    void setConstraintIterations(int iterations)
+    {
+        constraintSolver.maxIterations = std::max(iterations, 1);
+    }
+
+    void setConstraintTolerance(float tolerance) { constraintSolver.tolerance = tolerance; }
+
+    // Largest change of a constraint's impulse (N s) an iteration may still make for the
+    // solver to stop early
+    void setConstraintImpulseTolerance(float tolerance)
+    {
+        constraintSolver.impulseTolerance = tolerance;
+    }
+
+    // Cap on velocity passes over the contacts of each substep
+    void setContactIterations(int iterations)
+    {
+        contactSolver.maxIterations = std::max(iterations, 1);
+    }
+
+    // Contact passes stop once the normal velocity error (m/s) and the impulse change
+    // (N s) of a pass are both under these
+    void setContactTolerances(float velocity, float impulse)
+    {
+        contactSolver.velocityTolerance = velocity;
+        contactSolver.impulseTolerance = impulse;
+    }
+
+    // Particles share one radius and mass; changing them applies to existing particles.
+    // Cost is about 0.3-0.45 us per grain per step at 2 iterations on one core, so about
+    // 30k grains fit a 60 Hz frame; 100k take 30-60 ms per step, depending on how deep the
+    // pile is.
+    void setParticleProperties(float radius, float mass, float friction)
+    {
+        particles.radius = std::max(radius, 1e-4f);
+        particles.mass = std::max(mass, 1e-6f);
+        particles.friction = std::max(0.0f, std::min(friction, 1.0f));
+    }
+
+    // ParticleCoupling: 0 none, 1 bodies push particles, 2 both ways
+    void setParticleCoupling(int mode)
+    {
+        if (mode >= COUPLE_NONE and mode <= COUPLE_TWO_WAY)
+            particles.coupling = (ParticleCoupling)mode;
+    }
+
+    void setParticleIterations(int iterations) { particles.iterations = std::max(iterations, 1); }
+
+    void addParticle(float x, float y, float z, float vx, float vy, float vz)
+    {
+        particles.add(x, y, z, vx, vy, vz);
+    }
+
+    // nx * ny * nz particles on a lattice from (x, y, z), spacing apart. A small
+    // deterministic jitter keeps stacked columns from balancing on each other. See
+    // setParticleProperties for how many grains fit a frame.
+    void addParticleBlock(float x, float y, float z, int nx, int ny, int nz, float spacing)
+    {
+        uint32_t seed = (uint32_t)particles.size() * 2654435761u + 1;
+        auto jitter = [&]()
+        {
+            seed = seed * 1664525u + 1013904223u;
+            return ((seed >> 8) * (1.0f / 16777216.0f) - 0.5f) * 0.1f * spacing;
+        };
+        for (int k = 0; k < nz; k++)
+            for (int j = 0; j < ny; j++)
+                for (int i = 0; i < nx; i++)
+                    particles.add(x + i * spacing + jitter(), y + j * spacing,
+                                  z + k * spacing + jitter(), 0.0f, 0.0f, 0.0f);
+    }
+
+    void clearParticles() { particles.clear(); }
+
+    int getParticleCount() { return (int)particles.size(); }
+
+    // Interleaved xyz of every particle into out (getParticleCount() * 3 floats)
+    void copyParticlePositions(float* out) { particles.copyPositions(out); }
+
+    // Floats per child in addCompoundData
+    static constexpr int COMPOUND_CHILD_STRIDE = 11;
+    static_assert(COMPOUND_CHILD_STRIDE == SceneFile::CHILD_STRIDE,
+                  "scene files store compound children in the same layout");
+
+    // One body made of count primitive children, COMPOUND_CHILD_STRIDE floats each:
+    // [type, a, b, c, offsetX, offsetY, offsetZ, qw, qx, qy, qz]. type is a ShapeType:
+    // SPHERE (a = radius), BOX (a, b, c = width, height, depth), CYLINDER (a = radius,
+    // b = height) or CAPSULE (a = radius, b = length). Offsets and rotations are relative
+    // to (x, y, z); the body itself sits at the centre of mass, see getCompoundCenterData.
+    // Returns 0 on bad input.
+    uint32_t addCompoundData(float x, float y, float z, const float* children, int count,
+                             float mass)
+    {
+        static_assert(hasShape(COMPOUND), "compounds are disabled in this world's Config");
+        const Compound* shape = compoundShape(children, count);
+        if (!shape)
+            return 0;
+        Vector3 center = shape->getCenterOfMass();
+        RigidBody body(shape, x + center.x, y + center.y, z + center.z, mass);
+        body.friction = 0.5f;
+        body.restitution = 0.5f;
+        return insertBody(body);
+    }
+
+    // Centre of mass of a compound relative to the point its children were given around;
+    // a child's world position is bodyPosition + bodyRotation * (offset - center). Returns
+    // false if the body is not a compound.
+    bool getCompoundCenterData(uint32_t handle, float out[3])
+    {
+        const RigidBody* body = bodies.get(handle);
+        if (!body || body->shape->type != COMPOUND)
+            return false;
+        Vector3 center = ((const Compound*)body->shape)->getCenterOfMass();
+        out[0] = center.x;
+        out[1] = center.y;
+        out[2] = center.z;
+        return true;
+    }
+
+    // Static triangle mesh from packed xyz vertices and three indices per triangle, placed
+    // at (x, y, z). The hierarchy is built here, once. Triangles collide on both sides, so
+    // any winding works.
+    uint32_t addMeshData(float x, float y, float z, const float* vertices, int vertexCount,
+                         const uint32_t* indices, int triangleCount)
+    {
+        static_assert(hasShape(MESH), "meshes are disabled in this world's Config");
+        if (vertexCount <= 0 || triangleCount <= 0)
+            return 0;
+        const Shape* shape =
+            shapes->mesh(vertices, (uint32_t)vertexCount, indices, (uint32_t)triangleCount);
+        return insertBody(RigidBody(shape, x, y, z, 0.0f));
+    }
+
+    // Static mesh from a blob saved with getMeshBlobData. With copy false the blob is used
+    // in place and must outlive every body sharing it (e.g. a mapped file). Returns 0 for
+    // a blob that is truncated, corrupt or from another format version.
+    uint32_t addMeshBlobData(float x, float y, float z, const uint8_t* data, size_t size,
+                             bool copy)
+    {
+        static_assert(hasShape(MESH), "meshes are disabled in this world's Config");
+        if (!TriangleMesh::validate(data, size))
+            return 0;
+        const Shape* shape = copy ? shapes->mesh(std::vector<uint8_t>(data, data + size))
+                                  : shapes->mesh(data, size);
+        return insertBody(RigidBody(shape, x, y, z, 0.0f));
+    }
+
+    // Appends a scene file (see SceneFile) to the world and takes over its gravity. The
+    // records are read where they lie: with copy false the meshes also use their blobs in
+    // place, and the data must outlive them (e.g. a mapped file). Bodies come after the
+    // existing ones in dense order, awake or asleep as they were saved. Returns the number
+    // of bodies added, or -1 for data that is truncated, corrupt, from another format
+    // version or uses shapes this world's Config disables; nothing is added then.
+    // Each body record is still copied into a RigidBody, since the two layouts differ; the
+    // copy and one bulk tree build are all the per-body work.
+    int loadSceneData(const uint8_t* data, size_t size, bool copy)
+    {
+        if (!SceneFile::validate(data, size))
+            return -1;
+        SceneFile file(data);
+        const SceneFile::Header& header = file.getHeader();
+        if (bodies.size() + header.bodyCount > SlotMap<RigidBody>::INDEX_MASK)
+            return -1;
+
+        // Every shape is built before any body goes in, so a bad one leaves the world as is
+        std::vector<const Shape*> table(header.shapeCount);
+        const SceneFile::ShapeRecord* shapeRecords = file.getShapes();
+        for (uint32_t i = 0; i < header.shapeCount; i++)
+        {
+            table[i] = sceneShape(file, shapeRecords[i], copy);
+            if (!table[i])
+            {
+                for (uint32_t k = 0; k < i; k++)
+                    shapes->release(table[k]);
+                return -1;
+            }
+        }
+
+        const int first = bodies.size();
+        bodies.reserve(first + header.bodyCount);
+        const SceneFile::BodyRecord* records = file.getBodies();
+        for (uint32_t i = 0; i < header.bodyCount; i++)
+        {
+            const SceneFile::BodyRecord& r = records[i];
+            RigidBody body(table[r.shape], r.position[0], r.position[1], r.position[2], r.mass);
+            shapes->retain(body.shape);
+            body.orientation = Quaternion(r.orientation[0], r.orientation[1], r.orientation[2],
+                                          r.orientation[3]);
+            body.velocity = Vector3(r.velocity[0], r.velocity[1], r.velocity[2]);
+            body.angularVelocity =
+                Vector3(r.angularVelocity[0], r.angularVelocity[1], r.angularVelocity[2]);
+            body.friction = r.friction;
+            body.restitution = r.restitution;
+            body.collisionCategory = r.collisionCategory;
+            body.collisionMask = r.collisionMask;
+            if (r.flags & SceneFile::BODY_SENSOR)
+            {
+                body.isSensor = true;
+                sensorCount++;
+            }
+            if ((r.flags & SceneFile::BODY_ASLEEP) && body.hasFiniteMass())
+                body.setAwake(false);
+            bodies.insert(body);
+        }
+        bodyStorageDirty = true;
+
+        // The broadphase gets the new bodies as one bulk-built subtree
+        std::vector<AABB> boxes(header.bodyCount);
+        std::vector<uint32_t> handles(header.bodyCount);
+        std::vector<int> proxies(header.bodyCount);
+        for (uint32_t i = 0; i < header.bodyCount; i++)
+        {
+            boxes[i] = SceneQuery::bodyBounds(&bodies[first + i]);
+            handles[i] = bodies.handleAt(first + i);
+        }
+        tree.createProxies(boxes.data(), handles.data(), (int)header.bodyCount, proxies.data());
+        for (uint32_t i = 0; i < header.bodyCount; i++)
+            bodies[first + i].proxy = proxies[i];
+        // The table's own references; shapes no body uses are freed here
+        for (const Shape* shape : table)
+            shapes->release(shape);
+
+        const SceneFile::ConstraintRecord* links = file.getConstraints();
+        for (uint32_t i = 0; i < header.constraintCount; i++)
+        {
+            const SceneFile::ConstraintRecord& r = links[i];
+            uint32_t handle = addConstraint(first + r.bodyA, first + r.bodyB, r.length);
+            Constraint* c = constraints.get(handle);
+            c->anchorA = Vector3(r.anchorA[0], r.anchorA[1], r.anchorA[2]);
+            c->anchorB = Vector3(r.anchorB[0], r.anchorB[1], r.anchorB[2]);
+            c->compliance = std::max(r.compliance, 0.0f);
+            if (r.flags & SceneFile::CONSTRAINT_COLLIDE_CONNECTED)
+                setConstraintCollideConnected(handle, true);
+            // addConstraint wakes its bodies; saved sleepers stay asleep
+            if (records[r.bodyA].flags & SceneFile::BODY_ASLEEP)
+                bodies[first + r.bodyA].setAwake(false);
+            if (records[r.bodyB].flags & SceneFile::BODY_ASLEEP)
+                bodies[first + r.bodyB].setAwake(false);
+        }
+
+        gravity = Vector3(header.gravity[0], header.gravity[1], header.gravity[2]);
+        return (int)header.bodyCount;
+    }
+
+    // Every body and constraint, and the gravity, as a scene file for loadSceneData. Valid
+    // until the next save.
+    const std::vector<uint8_t>& saveSceneData()
+    {
+        SceneWriter writer;
+        for (const RigidBody& body : bodies)
+            writer.addBody(body);
+        for (const Constraint& c : constraints)
+        {
+            writer.addConstraint(c, (uint32_t)bodies.indexOf(c.bodyHandleA),
+                                 (uint32_t)bodies.indexOf(c.bodyHandleB));
+        }
+        writer.finish(gravity, sceneData);
+        return sceneData;
+    }
+
+    // Another static body sharing the mesh of meshHandle; returns 0 if it is not a mesh
+    uint32_t addMeshInstance(uint32_t meshHandle, float x, float y, float z)
+    {
+        const RigidBody* source = bodies.get(meshHandle);
+        if (!source || source->shape->type != MESH)
+            return 0;
+        const Shape* shape = source->shape;
+        shapes->retain(shape);
+        return insertBody(RigidBody(shape, x, y, z, 0.0f));
+    }
+
+    // Serialized form of a body's mesh, or nullptr if it has none
+    const uint8_t* getMeshBlobData(uint32_t handle, size_t& size)
+    {
+        const RigidBody* body = bodies.get(handle);
+        if (!body || body->shape->type != MESH)
+            return nullptr;
+        const TriangleMesh* mesh = (const TriangleMesh*)body->shape;
+        size = mesh->size();
+        return mesh->data();
+    }
+
+    // Replaces the floor plane with a heightfield of columns x rows samples (row-major, x
+    // fastest) spaced cellSize apart, starting at (originX, originZ). quantize stores the
+    // samples as int16 instead of float. Bodies beyond the terrain's edge have no floor.
+    void setHeightfieldData(const float* heights, int columns, int rows, float cellSize,
+                            float originX, float originZ, bool quantize)
+    {
+        if (columns < 2 || rows < 2 || cellSize <= 0.0f)
+            return;
+        terrain = std::make_shared<const Heightfield>(
+            heights, columns, rows, cellSize, originX, originZ,
+            quantize ? Heightfield::INT16 : Heightfield::FLOAT32);
+        for (auto& body : bodies)
+        {
+            if (body.hasFiniteMass())
+                body.setAwake(true);
+        }
+    }
+
+    // Goes back to the y = 0 floor plane
+    void clearHeightfield()
+    {
+        terrain.reset();
+        for (auto& body : bodies)
+        {
+            if (body.hasFiniteMass())
+                body.setAwake(true);
+        }
+    }
+
+    // Floor height under (x, z)
+    float getTerrainHeight(float x, float z)
+    {
+        float height;
+        Vector3 normal;
+        if (terrain && terrain->surfaceAt(x, z, height, normal))
+            return height;
+        return 0.0f;
+    }
+
+    // Memory used by the heightfield samples
+    int getTerrainBytes() { return terrain ? (int)terrain->bytes() : 0; }
+
+    // Records of raycastBatchData: [ox, oy, oz, dx, dy, dz, maxDistance] in, and
+    // [handle, distance, px, py, pz, nx, ny, nz] out (the handle word holds uint32 bits)
+    static constexpr int RAY_INPUT_STRIDE = 7;
+    static constexpr int RAY_RESULT_STRIDE = 8;
+
+    // Closest hit along a ray; returns the body's handle, or 0 on a miss
+    uint32_t raycastData(float ox, float oy, float oz, float dx, float dy, float dz,
+                         float maxDistance, RayHit& hit)
+    {
+        Vector3 dir(dx, dy, dz);
+        dir.normalize();
+        return castRay(Vector3(ox, oy, oz), dir, maxDistance, hit);
+    }
+
+    // Casts count rays of RAY_INPUT_STRIDE floats; the results are in getRayResultData(),
+    // RAY_RESULT_STRIDE floats per ray with handle 0 on a miss, until the next batch.
+    // Returns count.
+    int raycastBatchData(const float* rays, int count)
+    {
+        count = std::max(count, 0);
+        rayResults.assign((size_t)count * RAY_RESULT_STRIDE, 0.0f);
+        for (int i = 0; i < count; i++)
+        {
+            const float* in = &rays[(size_t)i * RAY_INPUT_STRIDE];
+            float* out = &rayResults[(size_t)i * RAY_RESULT_STRIDE];
+            RayHit hit;
+            uint32_t handle = raycastData(in[0], in[1], in[2], in[3], in[4], in[5], in[6], hit);
+            std::memcpy(&out[0], &handle, sizeof(handle));
+            if (handle == 0)
+                continue;
+            out[1] = hit.distance;
+            out[2] = hit.point.x;
+            out[3] = hit.point.y;
+            out[4] = hit.point.z;
+            out[5] = hit.normal.x;
+            out[6] = hit.normal.y;
+            out[7] = hit.normal.z;
+        }
+        return count;
+    }
+
+    const float* getRayResultData() const { return rayResults.data(); }
+
+#ifdef __EMSCRIPTEN__
+    // JS-facing accessors; the native build uses the plain C++ API above
+    // Float32Array view of the last step's phase times (StepPhase order), in microseconds
+    val getPhaseTimes() { return val(typed_memory_view(PHASE_COUNT, budget.phaseUs)); }
+
+    // Float32Array view of the last step's solver stats, in SolverStat order
+    val getSolverStats() { return val(typed_memory_view(STAT_COUNT, solverStats.values)); }
+
+    // Float32Array view of interleaved particle positions, valid until the next step.
+    // Particles are reordered every step, so index i is not the same grain over time.
+    val getParticlePositions()
+    {
+        particlePositions.resize(particles.size() * 3);
+        particles.copyPositions(particlePositions.data());
+        return val(typed_memory_view(particlePositions.size(), particlePositions.data()));
+    }
+
+    // Compound from a Float32Array of COMPOUND_CHILD_STRIDE floats per child; see
+    // addCompoundData
+    uint32_t addCompound(float x, float y, float z, val children, float mass)
+    {
+        size_t length = children["length"].as<size_t>();
+        std::vector<float> data(length);
+        val(typed_memory_view(length, data.data())).call<void>("set", children);
+        return addCompoundData(x, y, z, data.data(), (int)(length / COMPOUND_CHILD_STRIDE),
+                               mass);
+    }
+
+    val getCompoundCenter(uint32_t handle)
+    {
+        float center[3];
+        if (!getCompoundCenterData(handle, center))
+            return val::null();
+        return Vector3(center[0], center[1], center[2]).toJs();
+    }
+
+    // Convex hull of a Float32Array of xyz points; see addConvexHullData
+    uint32_t addConvexHull(float x, float y, float z, val points, float mass)
+    {
+        size_t length = points["length"].as<size_t>();
+        std::vector<float> data(length);
+        val(typed_memory_view(length, data.data())).call<void>("set", points);
+        return addConvexHullData(x, y, z, data.data(), (int)(length / 3), mass);
+    }
+
+    val getConvexHullCenter(uint32_t handle)
+    {
+        float center[3];
+        if (!getConvexHullCenterData(handle, center))
+            return val::null();
+        return Vector3(center[0], center[1], center[2]).toJs();
+    }
+
+    // Static mesh from a Float32Array of xyz vertices and a Uint32Array of triangle indices
+    uint32_t addMesh(float x, float y, float z, val vertices, val indices)
+    {
+        size_t vertexFloats = vertices["length"].as<size_t>();
+        size_t indexCount = indices["length"].as<size_t>();
+        std::vector<float> vertexData(vertexFloats);
+        val(typed_memory_view(vertexFloats, vertexData.data())).call<void>("set", vertices);
+        std::vector<uint32_t> indexData(indexCount);
+        val(typed_memory_view(indexCount, indexData.data())).call<void>("set", indices);
+        return addMeshData(x, y, z, vertexData.data(), (int)(vertexFloats / 3), indexData.data(),
+                           (int)(indexCount / 3));
+    }
+
+    // Static mesh from a Uint8Array saved with getMeshBlob. The bytes are copied straight
+    // into the mesh's storage; nothing is rebuilt.
+    uint32_t addMeshBlob(float x, float y, float z, val bytes)
+    {
+        static_assert(hasShape(MESH), "meshes are disabled in this world's Config");
+        size_t size = bytes["length"].as<size_t>();
+        std::vector<uint8_t> blob(size);
+        val(typed_memory_view(size, blob.data())).call<void>("set", bytes);
+        if (!TriangleMesh::validate(blob.data(), size))
+            return 0;
+        return insertBody(RigidBody(shapes->mesh(std::move(blob)), x, y, z, 0.0f));
+    }
+
+    // Appends a scene file from a Uint8Array, e.g. a fetched level. The bytes are copied
+    // once into the heap and read from there (meshes keep a copy of their blobs); see
+    // loadSceneData.
+    int loadScene(val bytes)
+    {
+        size_t size = bytes["length"].as<size_t>();
+        std::vector<uint8_t> data(size);
+        val(typed_memory_view(size, data.data())).call<void>("set", bytes);
+        return loadSceneData(data.data(), size, true);
+    }
+
+    // Uint8Array view of saveSceneData, valid until the next save
+    val saveScene()
+    {
+        const std::vector<uint8_t>& data = saveSceneData();
+        return val(typed_memory_view(data.size(), data.data()));
+    }
+
+    // Uint8Array view of a body's serialized mesh (valid while the mesh lives), or null
+    val getMeshBlob(uint32_t handle)
+    {
+        size_t size = 0;
+        const uint8_t* data = getMeshBlobData(handle, size);
+        if (!data)
+            return val::null();
+        return val(typed_memory_view(size, data));
+    }
+
+    // Heightfield from a Float32Array of columns * rows samples; see setHeightfieldData
+    void setHeightfield(val heights, int columns, int rows, float cellSize, float originX,
+                        float originZ, bool quantize)
+    {
+        size_t length = heights["length"].as<size_t>();
+        if (length < (size_t)columns * rows)
+            return;
+        std::vector<float> samples(length);
+        val(typed_memory_view(length, samples.data())).call<void>("set", heights);
+        setHeightfieldData(samples.data(), columns, rows, cellSize, originX, originZ, quantize);
+    }
+
+    // Focus points from a Float32Array of [x, y, z] triples
+    void setRateFocus(val points)
+    {
+        size_t length = points["length"].as<size_t>();
+        std::vector<float> data(length);
+        val(typed_memory_view(length, data.data())).call<void>("set", points);
+        rateTiers.setFocus(data.data(), length / 3);
+    }
+
+    val getBodyPosition(int index)
+    {
+        if (index >= 0 and index < (int)bodies.size())
+        {
+            return bodies[index].toJs();
+        }
+        return val::null();
+    }
+
+    // The last step's events as a Float32Array view of
+    // [type, handleA, handleB, px, py, pz, nx, ny, nz, impulse] records. type and the handles
+    // are uint32 bits (read them through a Uint32Array over the same memory). The view is
+    // only valid until the next step.
+    val getContactEvents()
+    {
+        const size_t words = sizeof(ContactEvent) / sizeof(float);
+        return val(typed_memory_view(getContactEventCount() * words,
+                                     (const float*)getContactEventData()));
+    }
+
+    // Uint8Array view of the last encodeTransforms packet, valid until the next encode
+    val getTransformPacket()
+    {
+        const std::vector<uint8_t>& packet = transformStream.getPacket();
+        return val(typed_memory_view(packet.size(), packet.data()));
+    }
+
+    // Uint32Array view of the command ring: the [head, tail, capacity, 0] header, then
+    // capacity BodyCommand records. Write the records through a Float32Array over the same
+    // memory, and fetch the view again after setCommandCapacity or heap growth.
+    val getCommandRing()
+    {
+        return val(typed_memory_view(commands.size(), commands.data()));
+    }
+
+    // The last step's debug geometry as a Float32Array view of [x, y, z, r, g, b] vertices,
+    // getDebugLineVertexCount() line vertices then getDebugPointCount() points. Valid until
+    // the next step.
+    val getDebugVertices()
+    {
+        const size_t count = debugDraw.getLineVertexCount() + debugDraw.getPointCount();
+        const size_t words = sizeof(DebugVertex) / sizeof(float);
+        return val(typed_memory_view(count * words, (const float*)debugDraw.data()));
+    }
+
+    // The last step's sensor events as a Uint32Array view of [type, sensor, body] records,
+    // valid until the next step
+    val getSensorEvents()
+    {
+        const size_t words = sizeof(SensorEvent) / sizeof(uint32_t);
+        return val(typed_memory_view(getSensorEventCount() * words,
+                                     (const uint32_t*)getSensorEventData()));
+    }
+
+    // Closest hit along a ray, as {handle, distance, point, normal}, or null
+    val raycast(float ox, float oy, float oz, float dx, float dy, float dz, float maxDistance)
+    {
+        RayHit hit;
+        uint32_t handle = raycastData(ox, oy, oz, dx, dy, dz, maxDistance, hit);
+        if (handle == 0)
+            return val::null();
+        val obj = val::object();
+        obj.set("handle", handle);
+        obj.set("distance", hit.distance);
+        obj.set("point", hit.point.toJs());
+        obj.set("normal", hit.normal.toJs());
+        return obj;
+    }
+
+    // Casts every ray in a Float32Array of RAY_INPUT_STRIDE records; see raycastBatchData.
+    // Returns a Float32Array view of the results (read the handle words through a
+    // Uint32Array over the same memory), only valid until the next call into the world.
+    val raycastBatch(val rays)
+    {
+        size_t length = rays["length"].as<size_t>();
+        rayInput.resize(length);
+        val(typed_memory_view(length, rayInput.data())).call<void>("set", rays);
+        int count = raycastBatchData(rayInput.data(), (int)(length / RAY_INPUT_STRIDE));
+        return val(typed_memory_view((size_t)count * RAY_RESULT_STRIDE, rayResults.data()));
+    }
+
+    // Handles of every body overlapping the sphere, as a Uint32Array view
+    val overlapSphere(float x, float y, float z, float radius)
+    {
+        int count = overlapSphereData(x, y, z, radius);
+        return val(typed_memory_view(count, overlapResults.data()));
+    }
+
+    // Handles of every body overlapping the axis-aligned box, as a Uint32Array view
+    val overlapBox(float cx, float cy, float cz, float hx, float hy, float hz)
+    {
+        int count = overlapBoxData(cx, cy, cz, hx, hy, hz);
+        return val(typed_memory_view(count, overlapResults.data()));
+    }
+#endif
+
+private:
+    uint32_t castRay(const Vector3& origin, const Vector3& dir, float maxDistance, RayHit& best)
+    {
+        uint32_t bestHandle = 0;
+        tree.raycast(origin, dir, maxDistance,
+                     [&](int proxy, float maxT)
+                     {
+                         uint32_t handle = tree.getUserData(proxy);
+                         RayHit hit;
+                         if (!SceneQuery::raycast(bodies.get(handle), origin, dir, maxT, hit))
+                             return maxT;
+                         best = hit;
+                         bestHandle = handle;
+                         return hit.distance;
+                     });
+        return bestHandle;
+    }
+
+    // Broadphase: every moving body queries the tree; sleeping and static bodies never
+    // query, so pairs between them are skipped for free.
+    void findPairs(FrameVector<BodyPair>& pairs)
+    {
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            const RigidBody& body = bodies[i];
+            if (!body.hasFiniteMass() || !body.isAwake || !body.rateDue || body.isSensor)
+                continue;
+            tree.query(tree.getFatAABB(body.proxy),
+                       [&](int proxy)
+                       {
+                           int j = bodies.indexOf(tree.getUserData(proxy));
+                           if (j == (int)i)
+                               return true;
+                           const RigidBody& other = bodies[j];
+                           if (other.isSensor)
+                               return true;
+                           // Two moving bodies find each other; keep only one of the pair
+                           if (other.hasFiniteMass() && other.isAwake && other.rateDue &&
+                               j < (int)i)
+                               return true;
+                           if (!filter.shouldCollide(body, bodies.handleAt(i), other,
+                                                     bodies.handleAt(j)))
+                               return true;
+                           float reach = body.shape->boundingRadius + other.shape->boundingRadius;
+                           if ((body.position - other.position).magnitudeSquared() > reach * reach)
+                               return true;
+                           uint32_t a = std::min((uint32_t)i, (uint32_t)j);
+                           uint32_t b = std::max((uint32_t)i, (uint32_t)j);
+                           pairs.push_back({a, b});
+                           return true;
+                       });
+        }
+        // Deterministic order, independent of the tree's shape
+        std::sort(pairs.begin(), pairs.end(), [](const BodyPair& x, const BodyPair& y)
+                  { return x.a != y.a ? x.a < y.a : x.b < y.b; });
+    }
+
+    // Fills the debug buffer from the last substep's contacts and the current bodies and
+    // constraints. Islands join dynamic bodies through contacts and constraints; static
+    // bodies and the floor do not join them.
+    void buildDebugDraw()
+    {
+        const uint32_t flags = debugDraw.flags;
+        const Vector3 staticColor(0.45f, 0.45f, 0.5f);
+        debugDraw.beginFrame();
+
+        auto dynamicAt = [&](int index) { return index >= 0 && bodies[index].hasFiniteMass(); };
+        if (flags & DEBUG_ISLANDS)
+        {
+            debugDraw.resetIslands(bodies.size());
+            debugDraw.forEachContact(
+                [&](int a, int b, const Vector3&, const Vector3&)
+                {
+                    if (dynamicAt(a) && dynamicAt(b))
+                        debugDraw.joinIslands(a, b);
+                });
+            for (const Constraint& c : constraints)
+            {
+                int a = int(c.bodyA - bodies.data());
+                int b = int(c.bodyB - bodies.data());
+                if (dynamicAt(a) && dynamicAt(b))
+                    debugDraw.joinIslands(a, b);
+            }
+        }
+
+        // Island colour over sleep colour over the default
+        auto bodyColor = [&](int index)
+        {
+            const RigidBody& body = bodies[index];
+            if (body.isSensor)
+                return Vector3(0.9f, 0.3f, 0.9f);
+            if (!body.hasFiniteMass())
+                return staticColor;
+            if (flags & DEBUG_ISLANDS)
+                return DebugDraw::islandColor(debugDraw.findIsland(index));
+            if (flags & DEBUG_SLEEP)
+                return body.isAwake ? Vector3(0.3f, 0.9f, 0.4f) : Vector3(0.35f, 0.45f, 0.9f);
+            return Vector3(0.95f, 0.75f, 0.25f);
+        };
+        if (flags & DEBUG_AABBS)
+        {
+            for (size_t i = 0; i < bodies.size(); i++)
+                debugDraw.box(SceneQuery::bodyBounds(&bodies[i]), bodyColor((int)i));
+        }
+        else if (flags & (DEBUG_SLEEP | DEBUG_ISLANDS))
+        {
+            // Without bounds, the colours mark the body centres
+            for (size_t i = 0; i < bodies.size(); i++)
+                debugDraw.point(bodies[i].position, bodyColor((int)i));
+        }
+
+        if (flags & DEBUG_CONSTRAINTS)
+        {
+            for (const Constraint& c : constraints)
+            {
+                Vector3 a = c.bodyA->position + c.bodyA->orientation.rotate(c.anchorA);
+                Vector3 b = c.bodyB->position + c.bodyB->orientation.rotate(c.anchorB);
+                debugDraw.line(a, b, Vector3(0.3f, 0.85f, 0.95f));
+            }
+        }
+
+        if (flags & DEBUG_CONTACTS)
+        {
+            debugDraw.forEachContact(
+                [&](int, int, const Vector3& point, const Vector3& normal)
+                {
+                    debugDraw.point(point, Vector3(1.0f, 0.2f, 0.2f));
+                    debugDraw.line(point, point + normal * 0.25f, Vector3(1.0f, 0.9f, 0.2f));
+                });
+        }
+        debugDraw.endFrame();
+    }
+
+    // Sensor pass, once per step: each sensor queries the tree and gets a yes/no overlap
+    // test per candidate. No contact points, no solver work; sleeping bodies stay inside.
+    void updateSensors()
+    {
+        sensors.beginStep();
+        for (size_t i = 0; i < bodies.size() && sensorCount > 0; i++)
+        {
+            RigidBody& sensor = bodies[i];
+            if (!sensor.isSensor)
+                continue;
+            uint32_t sensorHandle = bodies.handleAt(i);
+            tree.query(SceneQuery::bodyBounds(&sensor),
+                       [&](int proxy)
+                       {
+                           uint32_t handle = tree.getUserData(proxy);
+                           RigidBody& other = *bodies.get(handle);
+                           // Static geometry and other sensors never trigger
+                           if (other.isSensor || !other.hasFiniteMass())
+                               return true;
+                           if (!filter.shouldCollide(sensor, sensorHandle, other, handle))
+                               return true;
+                           float reach = sensor.shape->boundingRadius + other.shape->boundingRadius;
+                           if ((sensor.position - other.position).magnitudeSquared() >
+                               reach * reach)
+                               return true;
+                           if (sensorOverlap(&sensor, &other))
+                               sensors.record(sensorHandle, handle);
+                           return true;
+                       });
+        }
+        sensors.endStep();
+    }
+
+    // Boolean narrowphase: a closest point for spheres, GJK without EPA for other convex
+    // pairs, the contact routines only where a mesh is involved. Compounds overlap if any
+    // child does.
+    bool sensorOverlap(RigidBody* a, RigidBody* b)
+    {
+        if constexpr (hasShape(COMPOUND))
+        {
+            if (a->shape->type == COMPOUND)
+                return compoundOverlap(a, b);
+            if (b->shape->type == COMPOUND)
+                return compoundOverlap(b, a);
+        }
+        ShapeType typeA = a->shape->type;
+        ShapeType typeB = b->shape->type;
+        // A sphere only needs the closest point of the other shape
+        if (typeB == SPHERE and typeA != MESH)
+            return SceneQuery::overlapSphere(a, b->position, ((const Sphere*)b->shape)->radius);
+        if (typeA == SPHERE and typeB != MESH)
+            return SceneQuery::overlapSphere(b, a->position, ((const Sphere*)a->shape)->radius);
+        if (ConvexCollider::isConvex(typeA) and ConvexCollider::isConvex(typeB))
+            return ConvexCollider::overlap(a, b);
+        Contact contact;
+        return collide(a, b, contact);
+    }
+
+    bool compoundOverlap(RigidBody* body, RigidBody* other)
+    {
+        const Compound* compound = (const Compound*)body->shape;
+        AABB box = SceneQuery::localBounds(body, SceneQuery::bodyBounds(other));
+        bool found = false;
+        compound->query(box,
+                        [&](int i)
+                        {
+                            if (found)
+                                return;
+                            RigidBody part =
+                                SceneQuery::childBody(body, compound->getChildren()[i]);
+                            found = sensorOverlap(&part, other);
+                        });
+        return found;
+    }
+
+    // Updates each body's motion average and puts slow bodies to sleep
+    void updateSleep()
+    {
+        for (auto& body : bodies)
+        {
+            if (!body.hasFiniteMass() || !body.rateDue)
+                continue;
+            if (body.isAwake)
+            {
+                float currentMotion = body.velocity.dot(body.velocity) +
+                                      body.angularVelocity.dot(body.angularVelocity);
+                float bias = 0.96f;
+                body.motion = bias * body.motion + (1.0f - bias) * currentMotion;
+                if (body.motion > 10.0f * body.sleepEpsilon)
+                    body.motion = 10.0f * body.sleepEpsilon;
+            }
+        }
+        articulationSolver.syncSleep();
+        for (auto& body : bodies)
+        {
+            if (body.hasFiniteMass() && body.isAwake && body.rateDue &&
+                body.motion < body.sleepEpsilon)
+                body.setAwake(false);
+        }
+    }
+
+    void substep(float subDt)
+    {
+        if (debugDraw.wantsContacts())
+            debugDraw.beginSubstep();
+        updateInertiaTensors();
+        for (auto& body : bodies)
+        {
+            if (!body.hasFiniteMass() || !body.isAwake || !body.rateDue)
+                continue;
+            // Slow rate tiers cover the frames they skipped
+            float bodyDt = subDt * body.rateScale;
+            body.velocity += gravity * bodyDt;
+            body.integrate(bodyDt);
+            tree.moveProxy(body.proxy, SceneQuery::bodyBounds(&body), body.velocity * bodyDt);
+        }
+        budget.mark(PHASE_INTEGRATE);
+
+        FrameVector<Contact> contacts{FrameAllocatorAdapter<Contact>(frame)};
+        contacts.reserve(bodies.size());
+        if constexpr (Config::floorPlane)
+        {
+            for (size_t i = 0; i < bodies.size(); i++)
+            {
+                if (bodies[i].rateDue && !bodies[i].isSensor)
+                    floorContacts(&bodies[i], contacts);
+            }
+            resolveContacts(contacts);
+        }
+        budget.mark(PHASE_FLOOR);
+
+        articulationSolver.solve(subDt);
+        constraintSolver.solve(iterativeConstraints, subDt, frame);
+        solverStats.add(STAT_CONSTRAINT_ITERATIONS, constraintSolver);
+        budget.mark(PHASE_CONSTRAINTS);
+
+        FrameVector<BodyPair> pairs{FrameAllocatorAdapter<BodyPair>(frame)};
+        findPairs(pairs);
+        budget.mark(PHASE_BROADPHASE);
+
+        // Narrowphase, then resolve
+        contacts.clear();
+        simplices.beginPass();
+        for (const BodyPair& pair : pairs)
+            pairContacts(&bodies[pair.a], &bodies[pair.b], contacts);
+        resolveContacts(contacts);
+        budget.mark(PHASE_NARROWPHASE);
+    }
+
+    void resolveContacts(FrameVector<Contact>& contacts)
+    {
+        contactSolver.solve(contacts, bodies.data(), bodies.size(), frame);
+        solverStats.add(STAT_CONTACT_ITERATIONS, contactSolver);
+        if (debugDraw.wantsContacts())
+        {
+            for (const Contact& contact : contacts)
+            {
+                debugDraw.recordContact(int(contact.a - bodies.data()),
+                                        contact.b ? int(contact.b - bodies.data()) : -1,
+                                        contact.point, contact.normal);
+            }
+        }
+        if (!contactEvents.enabled)
+            return;
+        for (Contact& contact : contacts)
+        {
+            // Static-static and static-floor contacts are not gameplay events
+            if (!contact.a->hasFiniteMass() && !(contact.b && contact.b->hasFiniteMass()))
+                continue;
+            uint32_t handleA = bodies.handleAt(contact.a - bodies.data());
+            uint32_t handleB = contact.b ? bodies.handleAt(contact.b - bodies.data()) : 0;
+            contactEvents.record(handleA, handleB, contact.point, contact.normal,
+                                 contact.normalImpulse);
+        }
+    }
+
+    // Floor contacts of one body; a compound gets one per touching child
+    void floorContacts(RigidBody* body, FrameVector<Contact>& contacts)
+    {
+        if constexpr (hasShape(COMPOUND))
+        {
+            if (body->shape->type == COMPOUND)
+            {
+                for (const Compound::Child& child : ((const Compound*)body->shape)->getChildren())
+                {
+                    RigidBody part = SceneQuery::childBody(body, child);
+                    Contact contact;
+                    if (collideFloor(&part, contact))
+                    {
+                        contact.a = body;
+                        contacts.push_back(contact);
+                    }
+                }
+                return;
+            }
+        }
+        Contact contact;
+        if (collideFloor(body, contact))
+            contacts.push_back(contact);
+    }
+
+    // Narrowphase of one broadphase pair
+    void pairContacts(RigidBody* bodyA, RigidBody* bodyB, FrameVector<Contact>& contacts)
+    {
+        if constexpr (hasShape(COMPOUND))
+        {
+            if (bodyA->shape->type == COMPOUND)
+                return collideCompound(bodyA, bodyB, contacts);
+            if (bodyB->shape->type == COMPOUND)
+                return collideCompound(bodyB, bodyA, contacts);
+        }
+        Contact contact;
+        if (collide(bodyA, bodyB, contact))
+            contacts.push_back(contact);
+    }
+
+    // Tests the children whose bounds overlap the other body through the primitive
+    // dispatch, then hands the contacts back to the compound. Compound-compound pairs
+    // recurse once per child of the first.
+    void collideCompound(RigidBody* body, RigidBody* other, FrameVector<Contact>& contacts)
+    {
+        const Compound* compound = (const Compound*)body->shape;
+        AABB box = SceneQuery::localBounds(body, SceneQuery::bodyBounds(other));
+        compound->query(box,
+                        [&](int i)
+                        {
+                            RigidBody part =
+                                SceneQuery::childBody(body, compound->getChildren()[i]);
+                            size_t first = contacts.size();
+                            pairContacts(&part, other, contacts);
+                            for (size_t c = first; c < contacts.size(); c++)
+                            {
+                                if (contacts[c].a == &part)
+                                    contacts[c].a = body;
+                                if (contacts[c].b == &part)
+                                    contacts[c].b = body;
+                            }
+                        });
+    }
+
+    bool collideFloor(RigidBody* body, Contact& contact)
+    {
+        if (terrain)
+            return collideTerrain(body, *terrain, contact);
+        ShapeType type = body->shape->type;
+        if constexpr (hasShape(SPHERE))
+        {
+            if (type == SPHERE)
+                return CollisionDetector::checkSpherePlane(body, 0.0f, contact);
+        }
+        if constexpr (hasShape(BOX))
+        {
+            if (type == BOX)
+                return CollisionDetector::checkBoxPlane(body, 0.0f, contact);
+        }
+        if constexpr (hasShape(CYLINDER))
+        {
+            if (type == CYLINDER)
+                return CollisionDetector::checkCylinderPlane(body, 0.0f, contact);
+        }
+        if constexpr (hasShape(CAPSULE))
+        {
+            if (type == CAPSULE)
+                return CollisionDetector::checkCapsulePlane(body, 0.0f, contact);
+        }
+        if constexpr (hasShape(PYRAMID) || hasShape(HULL))
+        {
+            if (type == PYRAMID || type == HULL)
+                return CollisionDetector::checkPolyhedronPlane(body, 0.0f, contact);
+        }
+        return false;
+    }
+
+    bool collideTerrain(RigidBody* body, const Heightfield& field, Contact& contact)
+    {
+        ShapeType type = body->shape->type;
+        if constexpr (hasShape(SPHERE))
+        {
+            if (type == SPHERE)
+                return CollisionDetector::checkSphereHeightfield(body, field, contact);
+        }
+        if constexpr (hasShape(BOX))
+        {
+            if (type == BOX)
+                return CollisionDetector::checkBoxHeightfield(body, field, contact);
+        }
+        if constexpr (hasShape(CYLINDER))
+        {
+            if (type == CYLINDER)
+                return CollisionDetector::checkCylinderHeightfield(body, field, contact);
+        }
+        if constexpr (hasShape(CAPSULE))
+        {
+            if (type == CAPSULE)
+                return CollisionDetector::checkCapsuleHeightfield(body, field, contact);
+        }
+        if constexpr (hasShape(PYRAMID) || hasShape(HULL))
+        {
+            if (type == PYRAMID || type == HULL)
+                return CollisionDetector::checkPolyhedronHeightfield(body, field, contact);
+        }
+        return false;
+    }
+
+    // Pair dispatch; branches for shapes the Config leaves out are not compiled
+    bool collide(RigidBody* bodyA, RigidBody* bodyB, Contact& contact)
+    {
+        ShapeType a = bodyA->shape->type;
+        ShapeType b = bodyB->shape->type;
+        if constexpr (hasShape(SPHERE))
+        {
+            if (a == SPHERE and b == SPHERE)
+                return CollisionDetector::checkSphereSphere(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(BOX))
+        {
+            if (a == BOX and b == BOX)
+                return CollisionDetector::checkBoxBox(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(SPHERE) && hasShape(BOX))
+        {
+            if (a == BOX and b == SPHERE)
+                return CollisionDetector::checkBoxSphere(bodyA, bodyB, contact);
+            if (a == SPHERE and b == BOX)
+                return CollisionDetector::checkSphereBox(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(SPHERE) && hasShape(CYLINDER))
+        {
+            if (a == SPHERE and b == CYLINDER)
+                return CollisionDetector::checkSphereCylinder(bodyA, bodyB, contact);
+            if (a == CYLINDER and b == SPHERE)
+                return CollisionDetector::checkSphereCylinder(bodyB, bodyA, contact);
+        }
+        if constexpr (hasShape(BOX) && hasShape(CYLINDER))
+        {
+            if (a == CYLINDER and b == BOX)
+                return CollisionDetector::checkCylinderBox(bodyA, bodyB, contact);
+            if (a == BOX and b == CYLINDER)
+                return CollisionDetector::checkCylinderBox(bodyB, bodyA, contact);
+        }
+        if constexpr (hasShape(CYLINDER))
+        {
+            if (a == CYLINDER and b == CYLINDER)
+                return CollisionDetector::checkCylinderCylinder(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(CAPSULE))
+        {
+            if (a == CAPSULE and b == CAPSULE)
+                return CollisionDetector::checkCapsuleCapsule(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(CAPSULE) && hasShape(SPHERE))
+        {
+            if (a == CAPSULE and b == SPHERE)
+                return CollisionDetector::checkCapsuleSphere(bodyA, bodyB, contact);
+            if (a == SPHERE and b == CAPSULE)
+                return CollisionDetector::checkSphereCapsule(bodyA, bodyB, contact);
+        }
+        if constexpr (hasShape(CAPSULE) && hasShape(BOX))
+        {
+            if (a == CAPSULE and b == BOX)
+                return CollisionDetector::checkCapsuleBox(bodyA, bodyB, contact);
+            if (a == BOX and b == CAPSULE)
+                return CollisionDetector::checkCapsuleBox(bodyB, bodyA, contact);
+        }
+        if constexpr (hasShape(CAPSULE) && hasShape(CYLINDER))
+        {
+            if (a == CAPSULE and b == CYLINDER)
+                return CollisionDetector::checkCapsuleCylinder(bodyA, bodyB, contact);
+            if (a == CYLINDER and b == CAPSULE)
+                return CollisionDetector::checkCapsuleCylinder(bodyB, bodyA, contact);
+        }
+        if constexpr (hasShape(MESH))
+        {
+            if (b == MESH)
+                return collideMesh(bodyA, bodyB, contact);
+            if (a == MESH)
+                return collideMesh(bodyB, bodyA, contact);
+        }
+        // Generic fallback for convex pairs without a routine of their own
+        if constexpr (hasShape(PYRAMID) || hasShape(HULL))
+        {
+            if (ConvexCollider::isConvex(a) and ConvexCollider::isConvex(b))
+                return collideConvex(bodyA, bodyB, contact);
+        }
+        return false;
+    }
+
+    // GJK/EPA, warm started from the pair's simplex of the previous pass. Pairs are keyed
+    // by handle with the lower handle as A; stand-in bodies for compound children are not
+    // in storage and run cold.
+    bool collideConvex(RigidBody* bodyA, RigidBody* bodyB, Contact& contact)
+    {
+        RigidBody* first = bodies.data();
+        RigidBody* last = first + bodies.size();
+        if (bodyA < first || bodyA >= last || bodyB < first || bodyB >= last)
+            return ConvexCollider::collide(bodyA, bodyB, contact);
+        uint32_t handleA = bodies.handleAt(bodyA - first);
+        uint32_t handleB = bodies.handleAt(bodyB - first);
+        if (handleB < handleA)
+        {
+            std::swap(bodyA, bodyB);
+            std::swap(handleA, handleB);
+        }
+        uint64_t key = SimplexCache::key(handleA, handleB);
+        const CachedSimplex* previous = simplices.find(key);
+        CachedSimplex simplex = previous ? *previous : CachedSimplex();
+        bool hit = ConvexCollider::collide(bodyA, bodyB, contact, &simplex);
+        simplices.store(key, simplex);
+        return hit;
+    }
+
+    bool collideMesh(RigidBody* body, RigidBody* meshBody, Contact& contact)
+    {
+        ShapeType type = body->shape->type;
+        if constexpr (hasShape(SPHERE))
+        {
+            if (type == SPHERE)
+                return CollisionDetector::checkSphereMesh(body, meshBody, contact);
+        }
+        if constexpr (hasShape(BOX))
+        {
+            if (type == BOX)
+                return CollisionDetector::checkBoxMesh(body, meshBody, contact);
+        }
+        if constexpr (hasShape(CYLINDER))
+        {
+            if (type == CYLINDER)
+                return CollisionDetector::checkCylinderMesh(body, meshBody, contact);
+        }
+        if constexpr (hasShape(CAPSULE))
+        {
+            if (type == CAPSULE)
+                return CollisionDetector::checkCapsuleMesh(body, meshBody, contact);
+        }
+        if constexpr (hasShape(PYRAMID) || hasShape(HULL))
+        {
+            if (type == PYRAMID || type == HULL)
+                return CollisionDetector::checkPolyhedronMesh(body, meshBody, contact);
+        }
+        return false;
+    }
+
+    // Registers a compound from COMPOUND_CHILD_STRIDE float child records; null on bad input
+    const Compound* compoundShape(const float* children, int count)
+    {
+        if (count <= 0)
+            return nullptr;
+        for (int i = 0; i < count; i++)
+        {
+            const float* c = children + i * COMPOUND_CHILD_STRIDE;
+            int type = (int)c[0];
+            bool valid = (type == SPHERE && hasShape(SPHERE) && c[1] > 0.0f) ||
+                         (type == BOX && hasShape(BOX) && c[1] > 0.0f && c[2] > 0.0f &&
+                          c[3] > 0.0f) ||
+                         (type == CYLINDER && hasShape(CYLINDER) && c[1] > 0.0f && c[2] > 0.0f) ||
+                         (type == CAPSULE && hasShape(CAPSULE) && c[1] > 0.0f && c[2] >= 0.0f);
+            if (!valid)
+                return nullptr;
+        }
+
+        std::vector<Compound::Child> parts(count);
+        for (int i = 0; i < count; i++)
+        {
+            const float* c = children + i * COMPOUND_CHILD_STRIDE;
+            int type = (int)c[0];
+            Compound::Child& part = parts[i];
+            if (type == SPHERE)
+                part.shape = shapes->sphere(c[1]);
+            else if (type == BOX)
+                part.shape = shapes->box(c[1], c[2], c[3]);
+            else if (type == CYLINDER)
+                part.shape = shapes->cylinder(c[1], c[2]);
+            else
+                part.shape = shapes->capsule(c[1], c[2]);
+            part.offset = Vector3(c[4], c[5], c[6]);
+            part.rotation = Quaternion(c[7], c[8], c[9], c[10]);
+            part.rotation.normalize();
+        }
+        return (const Compound*)shapes->compound(parts.data(), count);
+    }
+
+    // One shape of a scene file's table, holding one reference; null if the record is
+    // malformed or of a shape type this world's Config disables
+    const Shape* sceneShape(const SceneFile& file, const SceneFile::ShapeRecord& s, bool copy)
+    {
+        const float* p = s.params;
+        auto positive = [&](int n)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                if (!(p[i] > 0.0f))
+                    return false;
+            }
+            return true;
+        };
+        if constexpr (hasShape(SPHERE))
+        {
+            if (s.type == SPHERE)
+                return positive(1) ? shapes->sphere(p[0]) : nullptr;
+        }
+        if constexpr (hasShape(BOX))
+        {
+            if (s.type == BOX)
+                return positive(3) ? shapes->box(p[0], p[1], p[2]) : nullptr;
+        }
+        if constexpr (hasShape(CYLINDER))
+        {
+            if (s.type == CYLINDER)
+                return positive(2) ? shapes->cylinder(p[0], p[1]) : nullptr;
+        }
+        if constexpr (hasShape(CAPSULE))
+        {
+            if (s.type == CAPSULE)
+                return positive(1) && p[1] >= 0.0f ? shapes->capsule(p[0], p[1]) : nullptr;
+        }
+        if constexpr (hasShape(PYRAMID))
+        {
+            if (s.type == PYRAMID)
+                return positive(2) ? shapes->pyramid(p[0], p[1]) : nullptr;
+        }
+        if constexpr (hasShape(MESH))
+        {
+            if (s.type == MESH)
+            {
+                const uint8_t* blob = file.payload(s);
+                return copy ? shapes->mesh(std::vector<uint8_t>(blob, blob + s.size))
+                            : shapes->mesh(blob, (size_t)s.size);
+            }
+        }
+        if constexpr (hasShape(HULL))
+        {
+            if (s.type == HULL)
+            {
+                const Shape* hull = shapes->hull((const float*)file.payload(s), (int)s.count);
+                if (((const ConvexHull*)hull)->isValid())
+                    return hull;
+                shapes->release(hull);
+                return nullptr;
+            }
+        }
+        if constexpr (hasShape(COMPOUND))
+        {
+            if (s.type == COMPOUND)
+                return compoundShape((const float*)file.payload(s), (int)s.count);
+        }
+        return nullptr;
+    }
+
+    uint32_t insertBody(const RigidBody& body)
+    {
+        bodyStorageDirty = true;
+        uint32_t handle = bodies.insert(body);
+        RigidBody& stored = bodies[bodies.size() - 1];
+        stored.proxy = tree.createProxy(SceneQuery::bodyBounds(&stored), handle);
+        return handle;
+    }
+
+    // Removes a constraint from one body's attachment list
+    void unlinkConstraint(uint32_t bodyHandle, uint32_t handle, uint32_t next)
+    {
+        RigidBody* body = bodies.get(bodyHandle);
+        if (!body)
+            return;
+        if (body->firstConstraint == handle)
+        {
+            body->firstConstraint = next;
+            return;
+        }
+        uint32_t cur = body->firstConstraint;
+        while (cur != 0)
+        {
+            Constraint* c = constraints.get(cur);
+            uint32_t& link = c->bodyHandleA == bodyHandle ? c->nextA : c->nextB;
+            if (link == handle)
+            {
+                link = next;
+                return;
+            }
+            cur = link;
+        }
+    }
+};
+
+using PhysicsWorld = BasicPhysicsWorld<DefaultWorldConfig>;
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Object pool with stable addresses. Memory is allocated in fixed-size chunks and
+// destroyed objects go on a free list, so spawn/despawn cycles reuse the same memory
+// instead of going back to the allocator.
+template <typename T, size_t ChunkSize = 256>
+class Pool
+{
+public:
+    Pool() = default;
+    Pool(const Pool&) = delete;
+    Pool& operator=(const Pool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        if (freeList.empty())
+            grow();
+        void* memory = freeList.back();
+        freeList.pop_back();
+        live++;
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        object->~T();
+        freeList.push_back(object);
+        live--;
+    }
+
+    size_t liveCount() const { return live; }
+    size_t capacity() const { return chunks.size() * ChunkSize; }
+
+private:
+    struct alignas(T) Storage
+    {
+        unsigned char bytes[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Storage[]>> chunks;
+    std::vector<void*> freeList;
+    size_t live = 0;
+
+    void grow()
+    {
+        chunks.emplace_back(new Storage[ChunkSize]);
+        Storage* chunk = chunks.back().get();
+        freeList.reserve(freeList.size() + ChunkSize);
+        // Hand out the chunk front to back
+        for (size_t i = ChunkSize; i-- > 0;)
+            freeList.push_back(&chunk[i]);
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include "DynamicTree.h"
+#include "RigidBody.h"
+#include "SlotMap.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Multi-rate stepping. Each dynamic body sits in a rate tier: tier k is simulated once
+// every 2^k frames and then advances by the whole time it skipped, so far-away props
+// cost a fraction of the near field. Tiers come from the distance to the nearest focus
+// point (camera, players) or are set by hand.
+//
+// Bodies only interact while both are simulated, so before the substeps run every
+// moving body that is due this frame looks for slower bodies its swept box touches and
+// promotes them to its own tier, making them due right away. Promoted bodies keep their
+// tier for a while so they do not drop back while still in contact. Bodies with
+// constraints always stay in tier 0, since the solvers use one time step per substep.
+class RateTiers
+{
+public:
+    static const int TIER_COUNT = 4;
+    // Frames a promoted body keeps its tier before distance can demote it again
+    static const int PROMOTION_HOLD = 60;
+
+    bool enabled = false;
+    // Tier 0 below distances[0], tier 1 below distances[1], tier 2 below distances[2],
+    // tier 3 beyond
+    float distances[TIER_COUNT - 1] = {30.0f, 60.0f, 120.0f};
+    std::vector<Vector3> focus;
+
+    void setFocus(const float* xyz, size_t count)
+    {
+        focus.resize(count);
+        for (size_t i = 0; i < count; i++)
+            focus[i] = Vector3(xyz[i * 3], xyz[i * 3 + 1], xyz[i * 3 + 2]);
+    }
+
+    // Decides which bodies are simulated this frame and by how much time
+    void beginFrame(SlotMap<RigidBody>& bodies, const DynamicTree& tree, float dt)
+    {
+        if (!enabled)
+            return;
+
+        worklist.clear();
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            RigidBody& body = bodies[i];
+            if (!body.hasFiniteMass())
+                continue;
+            if (body.rateDue)
+                body.framesSinceStep = 0;
+            else if (body.framesSinceStep < 255)
+                body.framesSinceStep++;
+
+            int tier = targetTier(body);
+            if (body.rateHold > 0)
+            {
+                body.rateHold--;
+                tier = std::min(tier, (int)body.rateTier);
+            }
+            body.rateTier = (uint8_t)tier;
+
+            // A tier is due on every 2^k-th frame since the body last stepped
+            body.rateDue = body.framesSinceStep + 1 >= (1 << tier);
+            body.rateScale = body.rateDue ? (float)(body.framesSinceStep + 1) : 0.0f;
+            if (body.rateDue && body.isAwake)
+                worklist.push_back((uint32_t)i);
+        }
+
+        // Promote slower bodies that due bodies may touch this frame
+        while (!worklist.empty())
+        {
+            uint32_t i = worklist.back();
+            worklist.pop_back();
+            const RigidBody& body = bodies[i];
+            AABB box = tree.getFatAABB(body.proxy);
+            Vector3 sweep = body.velocity * (dt * body.rateScale);
+            box = box.merged(AABB(box.min + sweep, box.max + sweep));
+            tree.query(box,
+                       [&](int proxy)
+                       {
+                           int j = bodies.indexOf(tree.getUserData(proxy));
+                           RigidBody& other = bodies[j];
+                           if (!other.hasFiniteMass() || other.rateTier <= body.rateTier)
+                               return true;
+                           other.rateTier = body.rateTier;
+                           other.rateHold = PROMOTION_HOLD;
+                           if (!other.rateDue)
+                           {
+                               other.rateDue = true;
+                               other.rateScale = (float)(other.framesSinceStep + 1);
+                               if (other.isAwake)
+                                   worklist.push_back((uint32_t)j);
+                           }
+                           return true;
+                       });
+        }
+    }
+
+    // Makes every body due again with a normal time step
+    void disable(SlotMap<RigidBody>& bodies)
+    {
+        enabled = false;
+        for (RigidBody& body : bodies)
+        {
+            body.rateTier = 0;
+            body.rateDue = true;
+            body.rateScale = 1.0f;
+            body.framesSinceStep = 0;
+        }
+    }
+
+private:
+    std::vector<uint32_t> worklist;
+
+    int targetTier(const RigidBody& body) const
+    {
+        if (body.firstConstraint != 0)
+            return 0;
+        if (body.manualRateTier >= 0)
+            return std::min((int)body.manualRateTier, TIER_COUNT - 1);
+        if (focus.empty())
+            return 0;
+        float best = 1e30f;
+        for (const Vector3& f : focus)
+            best = std::min(best, (body.position - f).magnitudeSquared());
+        int tier = 0;
+        while (tier < TIER_COUNT - 1 && best >= distances[tier] * distances[tier])
+            tier++;
+        return tier;
+    }
+};
@@ -1,5 +1,8 @@
 #pragma once
 #include "../geometry/Box.h"
+#include "../geometry/Capsule.h"
+#include "../geometry/Compound.h"
+#include "../geometry/ConvexHull.h"
 #include "../geometry/Shape.h"
 #include "../geometry/Sphere.h"
 #include "../geometry/Cylinder.h"
@@ -7,6 +10,8 @@
 #include "Matrix3x3.h"
 #include "Quaternion.h"
 #include "Vector3.h"
+#include <cstdint>
+
 class RigidBody
 {
 public:
@@ -33,10 +38,32 @@ public:
     float motion;
     float sleepEpsilon = 0.3f;
 
-    // Shape
-    Shape* shape;
+    // Shared, immutable definition owned by the world's ShapeRegistry
+    const Shape* shape;
+
+    // Leaf in the world's AABB tree
+    int proxy = -1;
+
+    // Collision filtering: two bodies collide when each category is in the other's mask
+    uint32_t collisionCategory = 1;
+    uint32_t collisionMask = 0xFFFFFFFF;
+    // Number of explicitly excluded pairs involving this body
+    uint32_t ignoredPairs = 0;
+    // Trigger volume: reports overlaps but never collides or gets contacts
+    bool isSensor = false;
 
-    RigidBody(Shape* s, float x, float y, float z, float mass)
+    // Head of the intrusive list of constraints attached to this body (constraint handle)
+    uint32_t firstConstraint = 0;
+
+    // Multi-rate stepping (see RateTiers)
+    uint8_t rateTier = 0;
+    int8_t manualRateTier = -1; // -1 = from distance
+    uint8_t rateHold = 0;
+    uint8_t framesSinceStep = 0;
+    bool rateDue = true;    // simulated this frame
+    float rateScale = 1.0f; // frames of time the body advances by when simulated
+
+    RigidBody(const Shape* s, float x, float y, float z, float mass)
         : shape(s), position(x, y, z), angularVelocity(0, 0, 0), velocity(0, 0, 0),
           orientation(1, 0, 0, 0), isAwake(true), motion(2.0f * 0.3f)
     {
@@ -48,7 +75,10 @@ public:
         else
         {
             inverseMass = 0.0f;
-            inverseInertiaTensor.setIdentity();
+            // Static bodies do not turn either; far-away contact points on large static
+            // shapes (meshes) would otherwise soak up the impulse as rotation
+            inverseInertiaTensor.setDiagonal(0.0f, 0.0f, 0.0f);
+            inverseInertiaTensorWorld = inverseInertiaTensor;
             isAwake = false;
         }
     }
@@ -70,52 +100,20 @@ public:
 
     void calculateInertiaTensor(float mass)
     {
+        // The shape stores its unit-mass inertia, computed once per definition
         Matrix3 it;
-        if (shape->type == SPHERE)
+        if (shape->type == COMPOUND || shape->type == HULL)
         {
-            Sphere* s = (Sphere*)shape;
-            float coeff = 0.4f * mass * s->radius * s->radius;
-            it.setDiagonal(coeff, coeff, coeff);
-        }
-        else if (shape->type == BOX)
-        {
-            Box* b = (Box*)shape;
-
-            float w = b->halfExtents.x * 2;
-            float h = b->halfExtents.y * 2;
-            float d = b->halfExtents.z * 2;
-
-            float ex2 = w * w;
-            float ey2 = h * h;
-            float ez2 = d * d;
-
-            float factor = mass / 12.0f;
-
-            it.setDiagonal(factor * (ey2 + ez2), factor * (ex2 + ez2), factor * (ex2 + ey2));
+            // Offset and rotated children, or an irregular hull, give off-diagonal terms
+            it = shape->type == COMPOUND ? ((const Compound*)shape)->getUnitInertiaTensor()
+                                         : ((const ConvexHull*)shape)->getUnitInertiaTensor();
+            for (float& v : it.data)
+                v *= mass;
         }
-        else if (shape->type == CYLINDER)
+        else
         {
-            Cylinder *c = (Cylinder*)shape;
-            float r = c->radius;
-            float h = c->halfHeight * 2.0f;
-
-            float r2 = r * r;
-            float h2 = h * h;
-
-            float iy = 0.5f * mass * r2;
-            float ixz = (1.0f / 12.0f) * mass * (3.0f * r2 + h2);
-
-            it.setDiagonal(ixz, iy, ixz);
-        }
-        else if (shape->type == PYRAMID) {
-            Pyramid *p = (Pyramid*)shape;
-            float w = p->halfWidth * 2.0f;
-            float h = p->height;
-
-            float iy = (3.0f / 20.0f) * mass * w * w;
-            float ixz = mass * ((3.0f / 80.0f) * w * w + (3.0f / 20.0f) * h * h);
-
-            it.setDiagonal(ixz, iy, ixz);
+            it.setDiagonal(shape->unitInertia.x * mass, shape->unitInertia.y * mass,
+                           shape->unitInertia.z * mass);
         }
         inverseInertiaTensor.setInverse(it);
     }
@@ -128,6 +126,12 @@ public:
         setAwake(true);
     }
 
+    void addTorque(const Vector3& t)
+    {
+        torqueAccum += t;
+        setAwake(true);
+    }
+
     void integrate(float dt)
     {
         if (!isAwake or inverseMass <= 0.0f)
@@ -139,6 +143,7 @@ public:
 
         velocity += linearAcc * dt;
         position += velocity * dt;
+        angularVelocity += (inverseInertiaTensorWorld * torqueAccum) * dt;
 
         orientation.addScaledVector(angularVelocity, dt);
         orientation.normalize();
@@ -147,8 +152,10 @@ public:
         angularVelocity *= std::pow(angularDamping, dt);
 
         forceAccum = Vector3(0, 0, 0);
+        torqueAccum = Vector3(0, 0, 0);
     }
 
+#ifdef __EMSCRIPTEN__
     emscripten::val toJs() const
     {
         emscripten::val obj = emscripten::val::object();
@@ -164,4 +171,5 @@ public:
 
         return obj;
     }
+#endif
 };
@@ -0,0 +1,371 @@
+#pragma once
+#include "Constraint.h"
+#include "RigidBody.h"
+#include "../geometry/TriangleMesh.h"
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Binary level format: shapes, bodies and constraints as fixed-size little-endian
+// records, laid out so a file can be used where it lies (a mapped file, or one copy in
+// the WASM heap) instead of being parsed:
+//
+//   Header | shapes[shapeCount] | bodies[bodyCount] | constraints[constraintCount] | payload
+//
+// Every offset is relative to the start of the file and 4-byte aligned. The payload holds
+// the variable-size shape data: triangle mesh blobs (see TriangleMesh), hull points as
+// packed xyz floats and compound children as COMPOUND_CHILD_STRIDE float records. Bodies
+// refer to shapes and constraints to bodies by table index, so a shape is built once
+// however many bodies share it, and a saved scene can carry its settled, sleeping state.
+class SceneFile
+{
+public:
+    static const uint32_t MAGIC = 0x454E4353; // "SCNE"
+    static const uint32_t VERSION = 1;
+
+    // Floats per compound child record: [type, a, b, c, offset xyz, rotation wxyz]
+    static const uint32_t CHILD_STRIDE = 11;
+
+    enum BodyFlag : uint32_t
+    {
+        BODY_ASLEEP = 1 << 0,
+        BODY_SENSOR = 1 << 1
+    };
+
+    enum ConstraintFlag : uint32_t
+    {
+        CONSTRAINT_COLLIDE_CONNECTED = 1 << 0
+    };
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t fileSize;
+        uint32_t shapeCount;
+        uint32_t bodyCount;
+        uint32_t constraintCount;
+        uint32_t shapeOffset;
+        uint32_t bodyOffset;
+        uint32_t constraintOffset;
+        float gravity[3];
+        uint32_t reserved[4];
+    };
+
+    // params by type: sphere radius; box width, height, depth; cylinder radius, height;
+    // capsule radius, length; pyramid width, height. Meshes, hulls and compounds keep
+    // their data in the payload: size bytes at offset, count vertices or children.
+    struct ShapeRecord
+    {
+        uint32_t type;
+        uint32_t count;
+        uint32_t offset;
+        uint32_t size;
+        float params[4];
+    };
+
+    struct BodyRecord
+    {
+        uint32_t shape;
+        uint32_t flags;
+        float mass; // 0 for static bodies
+        float friction;
+        float restitution;
+        float position[3];
+        float orientation[4]; // w, x, y, z
+        float velocity[3];
+        float angularVelocity[3];
+        uint32_t collisionCategory;
+        uint32_t collisionMask;
+    };
+
+    struct ConstraintRecord
+    {
+        uint32_t bodyA;
+        uint32_t bodyB;
+        uint32_t flags;
+        float length;
+        float compliance;
+        float anchorA[3];
+        float anchorB[3];
+    };
+
+    static_assert(sizeof(Header) == 64, "Header layout is part of the file format");
+    static_assert(sizeof(ShapeRecord) == 32, "ShapeRecord layout is part of the file format");
+    static_assert(sizeof(BodyRecord) == 80, "BodyRecord layout is part of the file format");
+    static_assert(sizeof(ConstraintRecord) == 44,
+                  "ConstraintRecord layout is part of the file format");
+
+    // Whether size bytes at data hold a complete, well-formed scene of the current version:
+    // every table and payload range inside the file and every index inside its table.
+    // Shape dimensions are checked when the shapes are built.
+    static bool validate(const uint8_t* data, size_t size)
+    {
+        if (size < sizeof(Header) || ((uintptr_t)data & 3) != 0)
+            return false;
+        const Header& h = *(const Header*)data;
+        if (h.magic != MAGIC || h.version != VERSION || h.fileSize != size)
+            return false;
+        if (!inside(h.shapeOffset, (uint64_t)h.shapeCount * sizeof(ShapeRecord), size) ||
+            !inside(h.bodyOffset, (uint64_t)h.bodyCount * sizeof(BodyRecord), size) ||
+            !inside(h.constraintOffset, (uint64_t)h.constraintCount * sizeof(ConstraintRecord),
+                    size))
+            return false;
+
+        const ShapeRecord* shapes = (const ShapeRecord*)(data + h.shapeOffset);
+        for (uint32_t i = 0; i < h.shapeCount; i++)
+        {
+            const ShapeRecord& s = shapes[i];
+            if (!hasPayload(s.type))
+                continue;
+            if (!inside(s.offset, s.size, size))
+                return false;
+            if (s.type == MESH && !TriangleMesh::validate(data + s.offset, s.size))
+                return false;
+            if (s.type == HULL && (uint64_t)s.count * 3 * sizeof(float) != s.size)
+                return false;
+            if (s.type == COMPOUND &&
+                (s.count == 0 || (uint64_t)s.count * CHILD_STRIDE * sizeof(float) != s.size))
+                return false;
+        }
+
+        // One compare per record; the loader then reads them without checks
+        const BodyRecord* bodies = (const BodyRecord*)(data + h.bodyOffset);
+        for (uint32_t i = 0; i < h.bodyCount; i++)
+        {
+            if (bodies[i].shape >= h.shapeCount)
+                return false;
+        }
+        const ConstraintRecord* constraints =
+            (const ConstraintRecord*)(data + h.constraintOffset);
+        for (uint32_t i = 0; i < h.constraintCount; i++)
+        {
+            if (constraints[i].bodyA >= h.bodyCount || constraints[i].bodyB >= h.bodyCount)
+                return false;
+        }
+        return true;
+    }
+
+    static bool hasPayload(uint32_t type)
+    {
+        return type == MESH || type == HULL || type == COMPOUND;
+    }
+
+    // View of a validated file
+    explicit SceneFile(const uint8_t* data) : data(data), header((const Header*)data) {}
+
+    const Header& getHeader() const { return *header; }
+    const ShapeRecord* getShapes() const
+    {
+        return (const ShapeRecord*)(data + header->shapeOffset);
+    }
+    const BodyRecord* getBodies() const
+    {
+        return (const BodyRecord*)(data + header->bodyOffset);
+    }
+    const ConstraintRecord* getConstraints() const
+    {
+        return (const ConstraintRecord*)(data + header->constraintOffset);
+    }
+    const uint8_t* payload(const ShapeRecord& shape) const { return data + shape.offset; }
+
+private:
+    const uint8_t* data;
+    const Header* header;
+
+    static bool inside(uint64_t offset, uint64_t length, size_t size)
+    {
+        return (offset & 3) == 0 && offset + length <= size;
+    }
+};
+
+// Builds a scene file from live shapes, bodies and constraints. Shapes are written once
+// per definition, however many bodies use them.
+class SceneWriter
+{
+public:
+    // Table index of a shape, writing it on first use
+    uint32_t addShape(const Shape* shape)
+    {
+        auto it = shapeIndex.find(shape);
+        if (it != shapeIndex.end())
+            return it->second;
+
+        SceneFile::ShapeRecord record = {};
+        record.type = shape->type;
+        if (shape->type == MESH)
+        {
+            const TriangleMesh* mesh = (const TriangleMesh*)shape;
+            record.size = (uint32_t)mesh->size();
+            record.offset = appendPayload(mesh->data(), mesh->size());
+        }
+        else if (shape->type == HULL)
+        {
+            const ConvexHull* hull = (const ConvexHull*)shape;
+            record.count = (uint32_t)hull->getVertexCount();
+            std::vector<float> points;
+            for (int i = 0; i < hull->getVertexCount(); i++)
+                appendVector(points, hull->getVertices()[i]);
+            record.size = (uint32_t)(points.size() * sizeof(float));
+            record.offset = appendPayload(points.data(), record.size);
+        }
+        else if (shape->type == COMPOUND)
+        {
+            // Children are stored around the centre of mass, so it comes out at the origin
+            const std::vector<Compound::Child>& children = ((const Compound*)shape)->getChildren();
+            record.count = (uint32_t)children.size();
+            std::vector<float> floats;
+            for (const Compound::Child& child : children)
+            {
+                float params[4] = {};
+                dimensions(child.shape, params);
+                floats.push_back((float)child.shape->type);
+                floats.insert(floats.end(), params, params + 3);
+                appendVector(floats, child.offset);
+                floats.insert(floats.end(), {child.rotation.w, child.rotation.x,
+                                             child.rotation.y, child.rotation.z});
+            }
+            record.size = (uint32_t)(floats.size() * sizeof(float));
+            record.offset = appendPayload(floats.data(), record.size);
+        }
+        else
+        {
+            dimensions(shape, record.params);
+        }
+        shapes.push_back(record);
+        return shapeIndex[shape] = (uint32_t)(shapes.size() - 1);
+    }
+
+    void addBody(const RigidBody& body)
+    {
+        SceneFile::BodyRecord r;
+        r.shape = addShape(body.shape);
+        r.flags = 0;
+        if (body.hasFiniteMass() && !body.isAwake)
+            r.flags |= SceneFile::BODY_ASLEEP;
+        if (body.isSensor)
+            r.flags |= SceneFile::BODY_SENSOR;
+        r.mass = body.hasFiniteMass() ? 1.0f / body.inverseMass : 0.0f;
+        r.friction = body.friction;
+        r.restitution = body.restitution;
+        copyVector(r.position, body.position);
+        r.orientation[0] = body.orientation.w;
+        r.orientation[1] = body.orientation.x;
+        r.orientation[2] = body.orientation.y;
+        r.orientation[3] = body.orientation.z;
+        copyVector(r.velocity, body.velocity);
+        copyVector(r.angularVelocity, body.angularVelocity);
+        r.collisionCategory = body.collisionCategory;
+        r.collisionMask = body.collisionMask;
+        bodies.push_back(r);
+    }
+
+    // bodyA and bodyB are indices in the order the bodies were added
+    void addConstraint(const Constraint& c, uint32_t bodyA, uint32_t bodyB)
+    {
+        SceneFile::ConstraintRecord r;
+        r.bodyA = bodyA;
+        r.bodyB = bodyB;
+        r.flags = 0;
+        if (c.collideConnected)
+            r.flags |= SceneFile::CONSTRAINT_COLLIDE_CONNECTED;
+        r.length = c.length;
+        r.compliance = c.compliance;
+        copyVector(r.anchorA, c.anchorA);
+        copyVector(r.anchorB, c.anchorB);
+        constraints.push_back(r);
+    }
+
+    // Lays the file out into out
+    void finish(const Vector3& gravity, std::vector<uint8_t>& out) const
+    {
+        SceneFile::Header h = {};
+        h.magic = SceneFile::MAGIC;
+        h.version = SceneFile::VERSION;
+        h.shapeCount = (uint32_t)shapes.size();
+        h.bodyCount = (uint32_t)bodies.size();
+        h.constraintCount = (uint32_t)constraints.size();
+        h.shapeOffset = sizeof(SceneFile::Header);
+        h.bodyOffset = h.shapeOffset + h.shapeCount * sizeof(SceneFile::ShapeRecord);
+        h.constraintOffset = h.bodyOffset + h.bodyCount * sizeof(SceneFile::BodyRecord);
+        uint32_t payloadOffset =
+            h.constraintOffset + h.constraintCount * sizeof(SceneFile::ConstraintRecord);
+        h.fileSize = payloadOffset + (uint32_t)payload.size();
+        copyVector(h.gravity, gravity);
+
+        out.resize(h.fileSize);
+        std::memcpy(out.data(), &h, sizeof(h));
+        for (size_t i = 0; i < shapes.size(); i++)
+        {
+            SceneFile::ShapeRecord s = shapes[i];
+            if (SceneFile::hasPayload(s.type))
+                s.offset += payloadOffset;
+            std::memcpy(out.data() + h.shapeOffset + i * sizeof(s), &s, sizeof(s));
+        }
+        std::memcpy(out.data() + h.bodyOffset, bodies.data(),
+                    bodies.size() * sizeof(SceneFile::BodyRecord));
+        std::memcpy(out.data() + h.constraintOffset, constraints.data(),
+                    constraints.size() * sizeof(SceneFile::ConstraintRecord));
+        std::memcpy(out.data() + payloadOffset, payload.data(), payload.size());
+    }
+
+private:
+    std::unordered_map<const Shape*, uint32_t> shapeIndex;
+    std::vector<SceneFile::ShapeRecord> shapes;
+    std::vector<SceneFile::BodyRecord> bodies;
+    std::vector<SceneFile::ConstraintRecord> constraints;
+    std::vector<uint8_t> payload;
+
+    // Payload offset, relative to the payload until finish() places it
+    uint32_t appendPayload(const void* bytes, size_t size)
+    {
+        uint32_t offset = (uint32_t)payload.size();
+        payload.insert(payload.end(), (const uint8_t*)bytes, (const uint8_t*)bytes + size);
+        payload.resize((payload.size() + 3) & ~(size_t)3, 0);
+        return offset;
+    }
+
+    // The dimensions the world's add functions take, from a primitive shape
+    static void dimensions(const Shape* shape, float params[4])
+    {
+        if (shape->type == SPHERE)
+        {
+            params[0] = ((const Sphere*)shape)->radius;
+        }
+        else if (shape->type == BOX)
+        {
+            const Vector3& e = ((const Box*)shape)->halfExtents;
+            params[0] = e.x * 2.0f;
+            params[1] = e.y * 2.0f;
+            params[2] = e.z * 2.0f;
+        }
+        else if (shape->type == CYLINDER)
+        {
+            params[0] = ((const Cylinder*)shape)->radius;
+            params[1] = ((const Cylinder*)shape)->halfHeight * 2.0f;
+        }
+        else if (shape->type == CAPSULE)
+        {
+            params[0] = ((const Capsule*)shape)->radius;
+            params[1] = ((const Capsule*)shape)->halfLength * 2.0f;
+        }
+        else if (shape->type == PYRAMID)
+        {
+            params[0] = ((const Pyramid*)shape)->halfWidth * 2.0f;
+            params[1] = ((const Pyramid*)shape)->height;
+        }
+    }
+
+    static void copyVector(float out[3], const Vector3& v)
+    {
+        out[0] = v.x;
+        out[1] = v.y;
+        out[2] = v.z;
+    }
+
+    static void appendVector(std::vector<float>& out, const Vector3& v)
+    {
+        out.insert(out.end(), {v.x, v.y, v.z});
+    }
+};
@@ -0,0 +1,545 @@
+#pragma once
+#include "AABB.h"
+#include "CollisionDetector.h"
+#include "ConvexCollider.h"
+#include "RigidBody.h"
+#include <algorithm>
+#include <cmath>
+
+struct RayHit
+{
+    float distance;
+    Vector3 point;
+    Vector3 normal;
+};
+
+// Exact ray and overlap tests against a body's real shape, used by the world's scene
+// queries after the AABB tree has narrowed down the candidates.
+class SceneQuery
+{
+public:
+    // World-space bounds of a body at its current transform
+    static AABB bodyBounds(const RigidBody* body)
+    {
+        const Shape* shape = body->shape;
+        if (shape->type == SPHERE)
+        {
+            float r = ((const Sphere*)shape)->radius;
+            return AABB::fromCenter(body->position, Vector3(r, r, r));
+        }
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            return AABB::fromCenter(body->position, rotatedExtents(body->orientation, h));
+        }
+        if (shape->type == CYLINDER)
+        {
+            const Cylinder* c = (const Cylinder*)shape;
+            Vector3 a = body->orientation.rotate(Vector3(0, 1, 0));
+            auto extent = [&](float ai)
+            {
+                return c->halfHeight * std::abs(ai) +
+                       c->radius * std::sqrt(std::max(0.0f, 1.0f - ai * ai));
+            };
+            return AABB::fromCenter(body->position,
+                                    Vector3(extent(a.x), extent(a.y), extent(a.z)));
+        }
+        if (shape->type == CAPSULE)
+        {
+            const Capsule* c = (const Capsule*)shape;
+            Vector3 a = body->orientation.rotate(Vector3(0, c->halfLength, 0));
+            return AABB::fromCenter(body->position,
+                                    Vector3(std::abs(a.x) + c->radius, std::abs(a.y) + c->radius,
+                                            std::abs(a.z) + c->radius));
+        }
+        if (shape->type == MESH || shape->type == COMPOUND || shape->type == PYRAMID ||
+            shape->type == HULL)
+        {
+            // Rotated local bounds
+            AABB local = polyBounds(shape);
+            Vector3 c = local.center();
+            Vector3 e = rotatedExtents(body->orientation, local.halfExtents());
+            return AABB::fromCenter(body->position + body->orientation.rotate(c), e);
+        }
+        float r = shape->boundingRadius;
+        return AABB::fromCenter(body->position, Vector3(r, r, r));
+    }
+
+    // Conservative bounds of a world-space box in the body's local frame
+    static AABB localBounds(const RigidBody* body, const AABB& world)
+    {
+        Quaternion inv = body->orientation;
+        inv.invert();
+        Vector3 c = inv.rotate(world.center() - body->position);
+        return AABB::fromCenter(c, rotatedExtents(inv, world.halfExtents()));
+    }
+
+    // Stand-in body for one child of a compound, posed in world space. Only its shape and
+    // transform mean anything; contacts found against it belong to the compound.
+    static RigidBody childBody(const RigidBody* body, const Compound::Child& child)
+    {
+        RigidBody part = *body;
+        part.shape = child.shape;
+        part.position = body->position + body->orientation.rotate(child.offset);
+        part.orientation = body->orientation * child.rotation;
+        return part;
+    }
+
+    // dir must be normalized
+    static bool raycast(const RigidBody* body, const Vector3& origin, const Vector3& dir,
+                        float maxT, RayHit& hit)
+    {
+        const Shape* shape = body->shape;
+        if (shape->type == SPHERE)
+            return raySphere(body->position, ((const Sphere*)shape)->radius, origin, dir, maxT,
+                             hit);
+        if (shape->type == COMPOUND)
+        {
+            bool found = false;
+            for (const Compound::Child& child : ((const Compound*)shape)->getChildren())
+            {
+                RigidBody part = childBody(body, child);
+                if (raycast(&part, origin, dir, maxT, hit))
+                {
+                    maxT = hit.distance;
+                    found = true;
+                }
+            }
+            return found;
+        }
+
+        // Everything else is tested in the body's local frame
+        Quaternion inv = body->orientation;
+        inv.invert();
+        Vector3 o = inv.rotate(origin - body->position);
+        Vector3 d = inv.rotate(dir);
+        Vector3 localNormal;
+        float t;
+        bool found = false;
+        if (shape->type == BOX)
+            found = rayBox(((const Box*)shape)->halfExtents, o, d, maxT, t, localNormal);
+        else if (shape->type == CYLINDER)
+            found = rayCylinder((const Cylinder*)shape, o, d, maxT, t, localNormal);
+        else if (shape->type == CAPSULE)
+            found = rayCapsule((const Capsule*)shape, o, d, maxT, t, localNormal);
+        else if (shape->type == MESH)
+            found = ((const TriangleMesh*)shape)->raycast(o, d, maxT, t, localNormal);
+        else if (shape->type == PYRAMID || shape->type == HULL)
+            found = rayPolyhedron(shape, o, d, maxT, t, localNormal);
+        else
+            return raySphere(body->position, shape->boundingRadius, origin, dir, maxT, hit);
+
+        if (!found)
+            return false;
+        hit.distance = t;
+        hit.point = origin + dir * t;
+        hit.normal = body->orientation.rotate(localNormal);
+        return true;
+    }
+
+    static bool overlapSphere(const RigidBody* body, const Vector3& center, float radius)
+    {
+        Vector3 closest = closestPoint(body, center);
+        return (closest - center).magnitudeSquared() <= radius * radius;
+    }
+
+    // Axis-aligned query box against the body's shape (separating axis test)
+    static bool overlapBox(const RigidBody* body, const AABB& box)
+    {
+        const Shape* shape = body->shape;
+        Vector3 c = box.center();
+        Vector3 h = box.halfExtents();
+        if (shape->type == COMPOUND)
+        {
+            for (const Compound::Child& child : ((const Compound*)shape)->getChildren())
+            {
+                RigidBody part = childBody(body, child);
+                if (overlapBox(&part, box))
+                    return true;
+            }
+            return false;
+        }
+        if (shape->type == PYRAMID || shape->type == HULL)
+        {
+            // Not symmetric about the origin, so GJK against a stand-in box body
+            Box query(2.0f * h.x, 2.0f * h.y, 2.0f * h.z);
+            RigidBody queryBody(&query, c.x, c.y, c.z, 0.0f);
+            return ConvexCollider::overlap(body, &queryBody);
+        }
+        if (shape->type == SPHERE)
+        {
+            float r = ((const Sphere*)shape)->radius;
+            Vector3 p = body->position;
+            Vector3 q(std::max(box.min.x, std::min(p.x, box.max.x)),
+                      std::max(box.min.y, std::min(p.y, box.max.y)),
+                      std::max(box.min.z, std::min(p.z, box.max.z)));
+            return (p - q).magnitudeSquared() <= r * r;
+        }
+
+        Vector3 worldAxes[3] = {Vector3(1, 0, 0), Vector3(0, 1, 0), Vector3(0, 0, 1)};
+        Vector3 bodyAxes[3] = {body->orientation.rotate(worldAxes[0]),
+                               body->orientation.rotate(worldAxes[1]),
+                               body->orientation.rotate(worldAxes[2])};
+        Vector3 delta = body->position - c;
+
+        auto separated = [&](const Vector3& axis)
+        {
+            float len2 = axis.magnitudeSquared();
+            if (len2 < 1e-8f)
+                return false;
+            float rQuery = h.x * std::abs(axis.x) + h.y * std::abs(axis.y) + h.z * std::abs(axis.z);
+            float rBody = projectedRadius(body, bodyAxes, axis);
+            return std::abs(delta.dot(axis)) > rQuery + rBody;
+        };
+
+        for (int i = 0; i < 3; i++)
+        {
+            if (separated(worldAxes[i]) || separated(bodyAxes[i]))
+                return false;
+            for (int j = 0; j < 3; j++)
+            {
+                if (separated(worldAxes[i].cross(bodyAxes[j])))
+                    return false;
+            }
+        }
+        if (shape->type == CYLINDER || shape->type == CAPSULE)
+        {
+            // The rim can also be separated along the direction from the box to the axis
+            Vector3 toAxis = closestPoint(body, c) - c;
+            if (separated(toAxis))
+                return false;
+        }
+        return true;
+    }
+
+    // Closest point on (or inside) the body's shape to p
+    static Vector3 closestPoint(const RigidBody* body, const Vector3& p)
+    {
+        const Shape* shape = body->shape;
+        if (shape->type == SPHERE)
+        {
+            float r = ((const Sphere*)shape)->radius;
+            Vector3 d = p - body->position;
+            float len = d.magnitude();
+            if (len <= r)
+                return p;
+            return body->position + d * (r / len);
+        }
+        if (shape->type == COMPOUND)
+        {
+            Vector3 best;
+            float bestDistance = 1e30f;
+            for (const Compound::Child& child : ((const Compound*)shape)->getChildren())
+            {
+                RigidBody part = childBody(body, child);
+                Vector3 q = closestPoint(&part, p);
+                float d2 = (q - p).magnitudeSquared();
+                if (d2 < bestDistance)
+                {
+                    best = q;
+                    bestDistance = d2;
+                }
+            }
+            return best;
+        }
+        if (shape->type == PYRAMID || shape->type == HULL)
+            return ConvexCollider::closestPoint(body, p);
+        Vector3 local = CollisionDetector::toLocal(body, p);
+        Vector3 q;
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            q = Vector3(std::max(-h.x, std::min(local.x, h.x)),
+                        std::max(-h.y, std::min(local.y, h.y)),
+                        std::max(-h.z, std::min(local.z, h.z)));
+        }
+        else if (shape->type == CYLINDER)
+        {
+            const Cylinder* c = (const Cylinder*)shape;
+            q.y = std::max(-c->halfHeight, std::min(local.y, c->halfHeight));
+            float r = std::sqrt(local.x * local.x + local.z * local.z);
+            float scale = r > c->radius ? c->radius / r : 1.0f;
+            q.x = local.x * scale;
+            q.z = local.z * scale;
+        }
+        else if (shape->type == CAPSULE)
+        {
+            const Capsule* c = (const Capsule*)shape;
+            Vector3 s(0, std::max(-c->halfLength, std::min(local.y, c->halfLength)), 0);
+            Vector3 d = local - s;
+            float len = d.magnitude();
+            q = len <= c->radius ? local : s + d * (c->radius / len);
+        }
+        else
+        {
+            float r = shape->boundingRadius;
+            float len = local.magnitude();
+            q = len <= r ? local : local * (r / len);
+        }
+        return CollisionDetector::toWorld(body, q);
+    }
+
+private:
+    // Half extents of a box with half extents h after rotating it by q
+    static Vector3 rotatedExtents(const Quaternion& q, const Vector3& h)
+    {
+        Vector3 ax = q.rotate(Vector3(1, 0, 0));
+        Vector3 ay = q.rotate(Vector3(0, 1, 0));
+        Vector3 az = q.rotate(Vector3(0, 0, 1));
+        return Vector3(std::abs(ax.x) * h.x + std::abs(ay.x) * h.y + std::abs(az.x) * h.z,
+                       std::abs(ax.y) * h.x + std::abs(ay.y) * h.y + std::abs(az.y) * h.z,
+                       std::abs(ax.z) * h.x + std::abs(ay.z) * h.y + std::abs(az.z) * h.z);
+    }
+
+    // Local bounds of the shapes that are not centred on their origin
+    static AABB polyBounds(const Shape* shape)
+    {
+        if (shape->type == MESH)
+            return ((const TriangleMesh*)shape)->getBounds();
+        if (shape->type == COMPOUND)
+            return ((const Compound*)shape)->getBounds();
+        if (shape->type == HULL)
+            return ((const ConvexHull*)shape)->getBounds();
+        const Pyramid* p = (const Pyramid*)shape;
+        return AABB(Vector3(-p->halfWidth, p->vertices[0].y, -p->halfWidth),
+                    Vector3(p->halfWidth, p->vertices[4].y, p->halfWidth));
+    }
+
+    static float projectedRadius(const RigidBody* body, const Vector3 axes[3], const Vector3& n)
+    {
+        const Shape* shape = body->shape;
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            return h.x * std::abs(axes[0].dot(n)) + h.y * std::abs(axes[1].dot(n)) +
+                   h.z * std::abs(axes[2].dot(n));
+        }
+        if (shape->type == CYLINDER)
+        {
+            const Cylinder* c = (const Cylinder*)shape;
+            float len = n.magnitude();
+            float a = axes[1].dot(n) / len;
+            return len * (c->halfHeight * std::abs(a) +
+                          c->radius * std::sqrt(std::max(0.0f, 1.0f - a * a)));
+        }
+        if (shape->type == CAPSULE)
+        {
+            const Capsule* c = (const Capsule*)shape;
+            return c->halfLength * std::abs(axes[1].dot(n)) + c->radius * n.magnitude();
+        }
+        return shape->boundingRadius * n.magnitude();
+    }
+
+    static bool raySphere(const Vector3& center, float r, const Vector3& o, const Vector3& d,
+                          float maxT, RayHit& hit)
+    {
+        Vector3 m = o - center;
+        float b = m.dot(d);
+        float c = m.dot(m) - r * r;
+        if (c > 0.0f && b > 0.0f)
+            return false;
+        float disc = b * b - c;
+        if (disc < 0.0f)
+            return false;
+        float t = std::max(-b - std::sqrt(disc), 0.0f);
+        if (t > maxT)
+            return false;
+        hit.distance = t;
+        hit.point = o + d * t;
+        hit.normal = hit.point - center;
+        hit.normal.normalize();
+        return true;
+    }
+
+    static bool rayBox(const Vector3& h, const Vector3& o, const Vector3& d, float maxT, float& t,
+                       Vector3& normal)
+    {
+        float tmin = 0.0f, tmax = maxT;
+        int axis = -1;
+        float sign = 0.0f;
+        const float* oc = &o.x;
+        const float* dc = &d.x;
+        const float* hc = &h.x;
+        for (int i = 0; i < 3; i++)
+        {
+            if (std::abs(dc[i]) < 1e-8f)
+            {
+                if (oc[i] < -hc[i] || oc[i] > hc[i])
+                    return false;
+                continue;
+            }
+            float inv = 1.0f / dc[i];
+            float t1 = (-hc[i] - oc[i]) * inv;
+            float t2 = (hc[i] - oc[i]) * inv;
+            float s = -1.0f;
+            if (t1 > t2)
+            {
+                std::swap(t1, t2);
+                s = 1.0f;
+            }
+            if (t1 > tmin)
+            {
+                tmin = t1;
+                axis = i;
+                sign = s;
+            }
+            tmax = std::min(tmax, t2);
+            if (tmin > tmax)
+                return false;
+        }
+        t = tmin;
+        normal = Vector3(0, 0, 0);
+        if (axis >= 0)
+            (&normal.x)[axis] = sign;
+        else
+            normal = d * -1.0f; // origin inside the box
+        return true;
+    }
+
+    static bool rayCylinder(const Cylinder* c, const Vector3& o, const Vector3& d, float maxT,
+                            float& t, Vector3& normal)
+    {
+        float best = maxT;
+        bool found = false;
+
+        // Side: solve |(o + d t).xz| = r
+        float a = d.x * d.x + d.z * d.z;
+        if (a > 1e-10f)
+        {
+            float b = o.x * d.x + o.z * d.z;
+            float cc = o.x * o.x + o.z * o.z - c->radius * c->radius;
+            float disc = b * b - a * cc;
+            if (disc >= 0.0f)
+            {
+                float ts = (-b - std::sqrt(disc)) / a;
+                if (ts >= 0.0f && ts <= best)
+                {
+                    float y = o.y + d.y * ts;
+                    if (std::abs(y) <= c->halfHeight)
+                    {
+                        best = ts;
+                        normal = Vector3(o.x + d.x * ts, 0, o.z + d.z * ts);
+                        normal.normalize();
+                        found = true;
+                    }
+                }
+            }
+        }
+
+        // Caps
+        if (std::abs(d.y) > 1e-10f)
+        {
+            for (float capY : {c->halfHeight, -c->halfHeight})
+            {
+                float tc = (capY - o.y) / d.y;
+                if (tc < 0.0f || tc > best)
+                    continue;
+                float x = o.x + d.x * tc, z = o.z + d.z * tc;
+                if (x * x + z * z <= c->radius * c->radius)
+                {
+                    best = tc;
+                    normal = Vector3(0, capY > 0 ? 1.0f : -1.0f, 0);
+                    found = true;
+                }
+            }
+        }
+
+        // Origin inside
+        if (!found && std::abs(o.y) <= c->halfHeight &&
+            o.x * o.x + o.z * o.z <= c->radius * c->radius)
+        {
+            best = 0.0f;
+            normal = d * -1.0f;
+            found = true;
+        }
+
+        t = best;
+        return found;
+    }
+
+    // Nearest entry into the capsule's cylinder part or either cap sphere
+    static bool rayCapsule(const Capsule* c, const Vector3& o, const Vector3& d, float maxT,
+                           float& t, Vector3& normal)
+    {
+        float r = c->radius;
+        Vector3 axisPoint(0, std::max(-c->halfLength, std::min(o.y, c->halfLength)), 0);
+        if ((o - axisPoint).magnitudeSquared() <= r * r)
+        {
+            t = 0.0f;
+            normal = d * -1.0f; // origin inside the capsule
+            return true;
+        }
+
+        float best = maxT;
+        bool found = false;
+        float a = d.x * d.x + d.z * d.z;
+        if (a > 1e-10f)
+        {
+            float b = o.x * d.x + o.z * d.z;
+            float cc = o.x * o.x + o.z * o.z - r * r;
+            float disc = b * b - a * cc;
+            if (disc >= 0.0f)
+            {
+                float ts = (-b - std::sqrt(disc)) / a;
+                if (ts >= 0.0f && ts <= best && std::abs(o.y + d.y * ts) <= c->halfLength)
+                {
+                    best = ts;
+                    normal = Vector3(o.x + d.x * ts, 0, o.z + d.z * ts);
+                    normal.normalize();
+                    found = true;
+                }
+            }
+        }
+        for (float capY : {c->halfLength, -c->halfLength})
+        {
+            RayHit capHit;
+            if (raySphere(Vector3(0, capY, 0), r, o, d, best, capHit) && capHit.distance < best)
+            {
+                best = capHit.distance;
+                normal = capHit.normal;
+                found = true;
+            }
+        }
+        t = best;
+        return found;
+    }
+
+    // Clips the ray against every face plane; the last plane it enters through is the hit
+    static bool rayPolyhedron(const Shape* shape, const Vector3& o, const Vector3& d,
+                              float maxT, float& t, Vector3& normal)
+    {
+        Polyhedron poly;
+        Polyhedron::of(shape, poly);
+        float enter = 0.0f, exit = maxT;
+        int face = -1;
+        for (int i = 0; i < poly.faceCount; i++)
+        {
+            float denom = poly.normals[i].dot(d);
+            float dist = poly.offsets[i] - poly.normals[i].dot(o);
+            if (std::abs(denom) < 1e-10f)
+            {
+                if (dist < 0.0f)
+                    return false;
+                continue;
+            }
+            float ti = dist / denom;
+            if (denom < 0.0f)
+            {
+                if (ti > enter)
+                {
+                    enter = ti;
+                    face = i;
+                }
+            }
+            else
+            {
+                exit = std::min(exit, ti);
+            }
+            if (enter > exit)
+                return false;
+        }
+        t = enter;
+        normal = face >= 0 ? poly.normals[face] : d * -1.0f; // origin inside
+        return true;
+    }
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+enum SensorEventType : uint32_t
+{
+    SENSOR_ENTER = 0,
+    SENSOR_EXIT = 1
+};
+
+// One record of the flat sensor event stream handed to JS, read through a Uint32Array
+struct SensorEvent
+{
+    uint32_t type;
+    uint32_t sensor;
+    uint32_t body;
+};
+
+static_assert(sizeof(SensorEvent) == 3 * sizeof(uint32_t), "SensorEvent must stay packed");
+
+// Enter/exit tracking for sensor bodies. Each step lists the (sensor, body) pairs that
+// overlap; the sorted list is merge-joined against the previous step's, as the contact
+// event recorder does, so there are no per-sensor sets to maintain.
+class SensorTracker
+{
+public:
+    void beginStep()
+    {
+        events.clear();
+        std::swap(overlaps, previous);
+        overlaps.clear();
+    }
+
+    void record(uint32_t sensor, uint32_t body) { overlaps.push_back(key(sensor, body)); }
+
+    void endStep()
+    {
+        std::sort(overlaps.begin(), overlaps.end());
+        size_t i = 0, j = 0;
+        while (i < overlaps.size() || j < previous.size())
+        {
+            if (j == previous.size() || (i < overlaps.size() && overlaps[i] < previous[j]))
+            {
+                emit(SENSOR_ENTER, overlaps[i++]);
+            }
+            else if (i == overlaps.size() || previous[j] < overlaps[i])
+            {
+                emit(SENSOR_EXIT, previous[j++]);
+            }
+            else
+            {
+                i++;
+                j++;
+            }
+        }
+    }
+
+    // Whether any pair is still inside, so the world runs one more pass to close them
+    // after the last sensor is gone
+    bool hasOverlaps() const { return !overlaps.empty(); }
+
+    // Drops the last step's events without starting a pass
+    void clearEvents() { events.clear(); }
+
+    void clear()
+    {
+        overlaps.clear();
+        previous.clear();
+        events.clear();
+    }
+
+    const std::vector<SensorEvent>& getEvents() const { return events; }
+    SensorEvent* data() { return events.data(); }
+    const SensorEvent* data() const { return events.data(); }
+    size_t size() const { return events.size(); }
+
+private:
+    std::vector<uint64_t> overlaps;
+    std::vector<uint64_t> previous;
+    std::vector<SensorEvent> events;
+
+    static uint64_t key(uint32_t sensor, uint32_t body) { return ((uint64_t)sensor << 32) | body; }
+
+    void emit(SensorEventType type, uint64_t k)
+    {
+        events.push_back(SensorEvent{type, (uint32_t)(k >> 32), (uint32_t)k});
+    }
+};
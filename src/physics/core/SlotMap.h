@@ -0,0 +1,171 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Dense array addressed through stable generational handles.
+//
+// Values live contiguously so the hot loops can iterate them directly. Removal moves the
+// last value into the hole (O(1)) and patches the slot that pointed at it. A handle packs
+// a slot index and the slot's generation; the generation is bumped every time the slot is
+// freed, so a handle to a removed value never resolves to whatever reuses the slot. Freed
+// slots are reused oldest first, and a slot whose generation runs out is retired instead of
+// wrapping, so a stale handle can never become valid again.
+// Handle 0 is never issued and can be used as "none".
+template <typename T>
+class SlotMap
+{
+public:
+    static const uint32_t INDEX_BITS = 20;
+    static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+    static const uint32_t GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1;
+    static const uint32_t INVALID = 0;
+
+    uint32_t insert(const T& value)
+    {
+        uint32_t slot;
+        if (freeHead != NONE)
+        {
+            slot = freeHead;
+            freeHead = slots[slot].dense;
+            if (freeHead == NONE)
+                freeTail = NONE;
+        }
+        else
+        {
+            slot = (uint32_t)slots.size();
+            slots.push_back({0, 1});
+        }
+        slots[slot].dense = (uint32_t)dense.size();
+        dense.push_back(value);
+        denseToSlot.push_back(slot);
+        return makeHandle(slot, slots[slot].generation);
+    }
+
+    // Room for count values without reallocating
+    void reserve(size_t count)
+    {
+        dense.reserve(count);
+        denseToSlot.reserve(count);
+        slots.reserve(count);
+    }
+
+    // Dense index of a live handle, or -1
+    int indexOf(uint32_t handle) const
+    {
+        uint32_t slot = handle & INDEX_MASK;
+        if (handle == INVALID || slot >= slots.size())
+            return -1;
+        const Slot& s = slots[slot];
+        if (s.generation != (handle >> INDEX_BITS) || s.dense >= dense.size() ||
+            denseToSlot[s.dense] != slot)
+            return -1;
+        return (int)s.dense;
+    }
+
+    bool contains(uint32_t handle) const { return indexOf(handle) >= 0; }
+
+    T* get(uint32_t handle)
+    {
+        int i = indexOf(handle);
+        return i >= 0 ? &dense[i] : nullptr;
+    }
+
+    uint32_t handleAt(size_t index) const
+    {
+        uint32_t slot = denseToSlot[index];
+        return makeHandle(slot, slots[slot].generation);
+    }
+
+    bool erase(uint32_t handle)
+    {
+        int i = indexOf(handle);
+        if (i < 0)
+            return false;
+        eraseAt((size_t)i);
+        return true;
+    }
+
+    void eraseAt(size_t index)
+    {
+        uint32_t slot = denseToSlot[index];
+        size_t last = dense.size() - 1;
+        if (index != last)
+        {
+            dense[index] = dense[last];
+            denseToSlot[index] = denseToSlot[last];
+            slots[denseToSlot[index]].dense = (uint32_t)index;
+        }
+        dense.pop_back();
+        denseToSlot.pop_back();
+        release(slot);
+    }
+
+    // Exchanges two values' storage positions; their handles stay valid
+    void swapAt(size_t i, size_t j)
+    {
+        if (i == j)
+            return;
+        std::swap(dense[i], dense[j]);
+        std::swap(denseToSlot[i], denseToSlot[j]);
+        slots[denseToSlot[i]].dense = (uint32_t)i;
+        slots[denseToSlot[j]].dense = (uint32_t)j;
+    }
+
+    // Frees every value but keeps the slot table, so handles issued before stay invalid
+    void clear()
+    {
+        for (uint32_t slot : denseToSlot)
+            release(slot);
+        dense.clear();
+        denseToSlot.clear();
+    }
+
+    size_t size() const { return dense.size(); }
+    bool empty() const { return dense.empty(); }
+
+    T& operator[](size_t i) { return dense[i]; }
+    const T& operator[](size_t i) const { return dense[i]; }
+
+    T* data() { return dense.data(); }
+    typename std::vector<T>::iterator begin() { return dense.begin(); }
+    typename std::vector<T>::iterator end() { return dense.end(); }
+    typename std::vector<T>::const_iterator begin() const { return dense.begin(); }
+    typename std::vector<T>::const_iterator end() const { return dense.end(); }
+
+private:
+    static const uint32_t NONE = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        uint32_t dense;      // dense index while live, next free slot while free
+        uint32_t generation; // never 0
+    };
+
+    std::vector<T> dense;
+    std::vector<uint32_t> denseToSlot;
+    std::vector<Slot> slots;
+    // Free slots, oldest at the head
+    uint32_t freeHead = NONE;
+    uint32_t freeTail = NONE;
+
+    static uint32_t makeHandle(uint32_t slot, uint32_t generation)
+    {
+        return (generation << INDEX_BITS) | slot;
+    }
+
+    void release(uint32_t slot)
+    {
+        Slot& s = slots[slot];
+        s.dense = NONE;
+        // A slot on its last generation is never reused
+        if (s.generation == GENERATION_MASK)
+            return;
+        s.generation++;
+        if (freeTail != NONE)
+            slots[freeTail].dense = slot;
+        else
+            freeHead = slot;
+        freeTail = slot;
+    }
+};
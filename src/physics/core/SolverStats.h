@@ -0,0 +1,31 @@
+#pragma once
+#include <algorithm>
+
+// Convergence figures of one step. Each solver reports a group of three, in this order.
+enum SolverStat
+{
+    STAT_CONTACT_ITERATIONS,    // velocity passes, summed over the step's contact solves
+    STAT_CONTACT_ERROR,         // worst final normal velocity error, m/s
+    STAT_CONTACT_IMPULSE,       // worst final impulse change, N s
+    STAT_CONSTRAINT_ITERATIONS, // iterative constraint passes, summed over substeps
+    STAT_CONSTRAINT_ERROR,      // worst final position error, m
+    STAT_CONSTRAINT_IMPULSE,    // worst final impulse change, N s
+    STAT_COUNT
+};
+
+struct SolverStats
+{
+    float values[STAT_COUNT] = {};
+
+    void reset() { std::fill(values, values + STAT_COUNT, 0.0f); }
+
+    // Folds in one solve of a ContactSolver or ConstraintSolver: iterations add up, and
+    // the residuals keep the worst any solve of the step ended with
+    template <typename Solver>
+    void add(SolverStat iterations, const Solver& solver)
+    {
+        values[iterations] += solver.iterationsUsed;
+        values[iterations + 1] = std::max(values[iterations + 1], solver.maxError);
+        values[iterations + 2] = std::max(values[iterations + 2], solver.maxImpulseChange);
+    }
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include "SlotMap.h"
+#include "Vector3.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Keeps body storage roughly in Morton (Z-order) order of position, so bodies that are
+// close in space are close in memory and the narrowphase and solvers walk memory mostly
+// forwards instead of jumping around in spawn order.
+//
+// Every `interval` frames a new target order is computed (a sort of handles by Morton
+// code). It is then applied a few bodies per frame by swapping storage positions through
+// the SlotMap, so handles stay valid and no single frame pays for the whole permutation.
+// Bodies added while a pass is running simply stay at the end until the next pass.
+class SpatialSorter
+{
+public:
+    bool enabled = false;
+    int interval = 120;       // frames between passes
+    int bodiesPerFrame = 256; // storage positions settled per frame
+
+    // Advances the current pass. Returns true when storage moved, in which case pointers
+    // into body storage must be refreshed.
+    template <typename Body>
+    bool update(SlotMap<Body>& bodies)
+    {
+        if (!enabled || bodies.size() < 2)
+            return false;
+
+        if (cursor >= order.size())
+        {
+            if (++framesSincePass < interval)
+                return false;
+            framesSincePass = 0;
+            beginPass(bodies);
+        }
+
+        bool moved = false;
+        size_t end = std::min(order.size(), cursor + (size_t)bodiesPerFrame);
+        for (; cursor < end; cursor++)
+        {
+            if (placed >= bodies.size())
+            {
+                cursor = order.size();
+                break;
+            }
+            int index = bodies.indexOf(order[cursor]);
+            // Removed since the pass started, or already moved into the sorted prefix by
+            // a removal's swap
+            if (index < 0 || (size_t)index < placed)
+                continue;
+            if ((size_t)index != placed)
+            {
+                bodies.swapAt(placed, (size_t)index);
+                moved = true;
+            }
+            placed++;
+        }
+        return moved;
+    }
+
+    // Starts a pass on the next update instead of waiting for the interval
+    void requestPass() { framesSincePass = interval; }
+
+    void clear()
+    {
+        order.clear();
+        keys.clear();
+        cursor = 0;
+        placed = 0;
+        framesSincePass = 0;
+    }
+
+    // 10 bits per axis interleaved into a 30-bit code; q components in [0, 1023]
+    static uint32_t mortonCode(uint32_t x, uint32_t y, uint32_t z)
+    {
+        return (spread(x) << 2) | (spread(y) << 1) | spread(z);
+    }
+
+private:
+    std::vector<uint32_t> order; // handles in target order
+    std::vector<uint64_t> keys;  // (code << 32) | dense index, sort scratch
+    size_t cursor = 0;           // next entry of order to settle
+    size_t placed = 0;           // storage positions already settled
+    int framesSincePass = 0;
+
+    template <typename Body>
+    void beginPass(SlotMap<Body>& bodies)
+    {
+        Vector3 lo = bodies[0].position, hi = lo;
+        for (const Body& b : bodies)
+        {
+            lo = Vector3(std::min(lo.x, b.position.x), std::min(lo.y, b.position.y),
+                         std::min(lo.z, b.position.z));
+            hi = Vector3(std::max(hi.x, b.position.x), std::max(hi.y, b.position.y),
+                         std::max(hi.z, b.position.z));
+        }
+        Vector3 extent = hi - lo;
+        float size = std::max(extent.x, std::max(extent.y, extent.z));
+        float scale = size > 0.0f ? 1023.0f / size : 0.0f;
+
+        keys.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            Vector3 q = (bodies[i].position - lo) * scale;
+            uint64_t code = mortonCode((uint32_t)q.x, (uint32_t)q.y, (uint32_t)q.z);
+            keys[i] = (code << 32) | (uint64_t)i;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        order.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+            order[i] = bodies.handleAt((size_t)(keys[i] & 0xFFFFFFFFu));
+        cursor = 0;
+        placed = 0;
+    }
+
+    // Inserts two zero bits between each of the low 10 bits of v
+    static uint32_t spread(uint32_t v)
+    {
+        v &= 0x3FF;
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+};
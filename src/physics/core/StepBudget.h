@@ -0,0 +1,120 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+// Quality reductions a budgeted step applied, reported as a bitmask
+enum StepDegradation : uint32_t
+{
+    DEGRADE_NONE = 0,
+    DEGRADE_ITERATIONS = 1 << 0,   // constraint, articulation and contact iterations cut
+    DEGRADE_SUBSTEPS = 1 << 1,     // remaining substeps merged into one
+    DEGRADE_SLEEP_CHECK = 1 << 2,  // sleep update deferred to a later frame
+    DEGRADE_SPATIAL_SORT = 1 << 3, // storage re-sort slice deferred
+};
+
+enum StepPhase
+{
+    PHASE_SETUP,       // sorting, pointer refresh, articulation rebuild, sleep
+    PHASE_INTEGRATE,   // forces, integration, tree updates
+    PHASE_FLOOR,       // floor contacts
+    PHASE_CONSTRAINTS, // articulations and iterative constraints
+    PHASE_BROADPHASE,
+    PHASE_NARROWPHASE, // pair tests and contact resolution
+    PHASE_PARTICLES,
+    PHASE_SENSORS, // sensor overlap tests and enter/exit events
+    PHASE_COUNT
+};
+
+// Per-phase timing of one step plus the policy for staying inside a time budget.
+//
+// The cost of a substep is tracked as a running average. Before the substeps start,
+// the predicted cost decides whether low-priority work (sleep checks, re-sorting) is
+// deferred. Between substeps, if the elapsed time plus the predicted remaining substeps
+// would overrun the budget, the iteration counts drop and the remaining substeps are
+// merged into one. Sleep checks are never deferred more than a few frames in a row, so
+// a world that is always over budget can still fall asleep.
+class StepBudget
+{
+public:
+    static const int MAX_DEFERRED_SLEEP_FRAMES = 4;
+
+    // Phase times of the last step, in microseconds
+    float phaseUs[PHASE_COUNT] = {};
+    float totalUs = 0.0f;
+    uint32_t degradations = DEGRADE_NONE;
+
+    void beginFrame(float budget)
+    {
+        budgetUs = budget;
+        degradations = DEGRADE_NONE;
+        std::fill(phaseUs, phaseUs + PHASE_COUNT, 0.0f);
+        frameStart = lastMark = Clock::now();
+    }
+
+    // Charges the time since the previous mark to a phase
+    void mark(StepPhase phase)
+    {
+        Clock::time_point now = Clock::now();
+        phaseUs[phase] += std::chrono::duration<float, std::micro>(now - lastMark).count();
+        lastMark = now;
+    }
+
+    float elapsedUs() const
+    {
+        return std::chrono::duration<float, std::micro>(Clock::now() - frameStart).count();
+    }
+
+    bool limited() const { return budgetUs > 0.0f; }
+
+    // Whether to skip the sleep update this frame
+    bool deferSleepCheck(int substeps)
+    {
+        if (!limited() || deferredSleepFrames >= MAX_DEFERRED_SLEEP_FRAMES ||
+            elapsedUs() + substeps * substepUs <= budgetUs)
+        {
+            deferredSleepFrames = 0;
+            return false;
+        }
+        deferredSleepFrames++;
+        degradations |= DEGRADE_SLEEP_CHECK;
+        return true;
+    }
+
+    // Whether to skip this frame's re-sort slice; checked before anything else runs
+    bool deferSpatialSort(int substeps)
+    {
+        if (!limited() || substeps * substepUs <= budgetUs)
+            return false;
+        degradations |= DEGRADE_SPATIAL_SORT;
+        return true;
+    }
+
+    // Called before each substep: true when the rest of the frame must run degraded
+    bool overBudget(int remainingSubsteps) const
+    {
+        return limited() && elapsedUs() + remainingSubsteps * substepUs > budgetUs;
+    }
+
+    void substepStart() { substepBegin = Clock::now(); }
+
+    // Updates the running substep cost; merged substeps are weighted by what they cover
+    void substepEnd(int covered)
+    {
+        float us = std::chrono::duration<float, std::micro>(Clock::now() - substepBegin).count();
+        us /= (float)std::max(covered, 1);
+        substepUs = substepUs == 0.0f ? us : substepUs * 0.8f + us * 0.2f;
+    }
+
+    void endFrame() { totalUs = elapsedUs(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    float budgetUs = 0.0f;
+    float substepUs = 0.0f; // running average cost of one substep
+    int deferredSleepFrames = 0;
+    Clock::time_point frameStart;
+    Clock::time_point lastMark;
+    Clock::time_point substepBegin;
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Threads exist natively and in WASM builds made with -pthread
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define PHYSICS_THREADS 1
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#else
+#define PHYSICS_THREADS 0
+#endif
+
+// Worker threads for loops over independent items. The calling thread takes items too,
+// so a pool of size 1, or a build without thread support, runs every loop inline.
+// Items are handed out one at a time from a shared counter, which balances uneven items
+// without any queue. In the browser, use it from a worker: the main thread may not block.
+class ThreadPool
+{
+public:
+    // threads counts the caller; 0 picks the hardware concurrency
+    explicit ThreadPool(int threads = 0) { resize(threads); }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() { stop(); }
+
+    void resize(int threads)
+    {
+        stop();
+#if PHYSICS_THREADS
+        if (threads <= 0)
+            threads = (int)std::thread::hardware_concurrency();
+        for (int i = 1; i < threads; i++)
+            workers.emplace_back([this] { workerLoop(); });
+#else
+        (void)threads;
+#endif
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // Calls fn(i) for every i in [0, count), in any order and on any thread, and returns
+    // once all calls have finished
+    void parallelFor(int count, const std::function<void(int)>& fn)
+    {
+#if PHYSICS_THREADS
+        if (!workers.empty() && count > 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = &fn;
+                jobCount = count;
+                next = 0;
+                generation++;
+            }
+            wake.notify_all();
+            run(fn, count);
+
+            // Workers that joined late may still hold the job; it lives on our stack
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return busy == 0; });
+            job = nullptr;
+            return;
+        }
+#endif
+        for (int i = 0; i < count; i++)
+            fn(i);
+    }
+
+private:
+#if PHYSICS_THREADS
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)>* job = nullptr;
+    int jobCount = 0;
+    std::atomic<int> next{0};
+    // Workers inside the current job
+    int busy = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void run(const std::function<void(int)>& fn, int count)
+    {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            fn(i);
+    }
+
+    void workerLoop()
+    {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            wake.wait(lock, [&] { return stopping || (job && generation != seen); });
+            if (stopping)
+                return;
+            seen = generation;
+            const std::function<void(int)>* fn = job;
+            int count = jobCount;
+            busy++;
+            lock.unlock();
+            run(*fn, count);
+            lock.lock();
+            if (--busy == 0)
+                done.notify_all();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        workers.clear();
+        stopping = false;
+    }
+#else
+    std::vector<int> workers;
+
+    void stop() {}
+#endif
+};
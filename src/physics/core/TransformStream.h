@@ -0,0 +1,637 @@
+#pragma once
+#include "AABB.h"
+#include "Quaternion.h"
+#include "RigidBody.h"
+#include "SlotMap.h"
+#include "Vector3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// Compact per-frame body transforms for remote viewers.
+//
+// The encoder captures a quantized snapshot every frame: positions as unsigned integers
+// inside a world bound, orientations packed smallest-three into 32 bits. A packet holds
+// one snapshot as a delta against a baseline snapshot the viewer has acknowledged: only
+// bodies whose quantized transform changed are written, so bodies at rest (asleep or
+// not) cost nothing. Small position changes are written as short deltas. Without a
+// usable baseline the packet is a full frame.
+//
+// Packet layout, a little-endian bit stream: magic, sequence, baseline, position bits,
+// the bound, the slots removed since the baseline, then one record per changed body in
+// slot order.
+
+// Packs bits into bytes, least significant bit first
+class BitWriter
+{
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void write(uint32_t value, int bits)
+    {
+        acc |= (uint64_t)(value & (uint32_t)(((uint64_t)1 << bits) - 1)) << count;
+        count += bits;
+        while (count >= 8)
+        {
+            out.push_back((uint8_t)acc);
+            acc >>= 8;
+            count -= 8;
+        }
+    }
+
+    void writeFloat(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        write(bits, 32);
+    }
+
+    // chunk bits at a time, each followed by a continuation bit
+    void writeVarint(uint32_t value, int chunk)
+    {
+        while (true)
+        {
+            write(value, chunk);
+            value = chunk < 32 ? value >> chunk : 0;
+            write(value != 0, 1);
+            if (value == 0)
+                return;
+        }
+    }
+
+    void flush()
+    {
+        if (count > 0)
+            out.push_back((uint8_t)acc);
+        acc = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t acc = 0;
+    int count = 0;
+};
+
+// Reads what BitWriter wrote. Reading past the end yields zeros and sets overrun.
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    bool overrun = false;
+
+    uint32_t read(int bits)
+    {
+        while (count < bits)
+        {
+            if (pos < size)
+                acc |= (uint64_t)data[pos] << count;
+            else
+                overrun = true;
+            pos++;
+            count += 8;
+        }
+        uint32_t value = (uint32_t)(acc & (((uint64_t)1 << bits) - 1));
+        acc >>= bits;
+        count -= bits;
+        return value;
+    }
+
+    float readFloat()
+    {
+        uint32_t bits = read(32);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint32_t readVarint(int chunk)
+    {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 32; shift += chunk)
+        {
+            value |= read(chunk) << shift;
+            if (!read(1))
+                return value;
+        }
+        overrun = true;
+        return value;
+    }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    uint64_t acc = 0;
+    int count = 0;
+};
+
+// Quantized snapshots and the packet format shared by encoder and decoder
+class TransformStream
+{
+public:
+    static constexpr uint32_t MAGIC = 0x31535450; // "PTS1"
+    // Snapshots kept for baselines on either side, about half a second at 60 Hz
+    static constexpr int HISTORY = 32;
+    static constexpr int MIN_POSITION_BITS = 8;
+    static constexpr int MAX_POSITION_BITS = 24;
+    static constexpr int ROTATION_BITS = 10;
+
+    struct Entry
+    {
+        uint32_t handle;
+        uint32_t x, y, z;
+        uint32_t rotation;
+
+        bool sameTransform(const Entry& o) const
+        {
+            return x == o.x && y == o.y && z == o.z && rotation == o.rotation;
+        }
+    };
+
+    struct Snapshot
+    {
+        uint32_t sequence = 0;
+        std::vector<Entry> entries; // in slot order
+    };
+
+    static uint32_t slotOf(uint32_t handle) { return handle & SlotMap<RigidBody>::INDEX_MASK; }
+
+    static uint32_t generationOf(uint32_t handle)
+    {
+        return handle >> SlotMap<RigidBody>::INDEX_BITS;
+    }
+
+    // Smallest three: the index of the largest component in 2 bits, then the other three
+    // scaled from [-1/sqrt2, 1/sqrt2] to ROTATION_BITS each. The largest is made positive
+    // (q and -q are the same rotation) and rebuilt from unit length.
+    static uint32_t packRotation(const Quaternion& q)
+    {
+        float c[4] = {q.w, q.x, q.y, q.z};
+        int largest = 0;
+        float lengthSq = 0.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            lengthSq += c[i] * c[i];
+            if (std::abs(c[i]) > std::abs(c[largest]))
+                largest = i;
+        }
+        float scale = lengthSq > 0.0f ? 1.0f / std::sqrt(lengthSq) : 1.0f;
+        if (c[largest] < 0.0f)
+            scale = -scale;
+
+        const float maxValue = (float)((1 << ROTATION_BITS) - 1);
+        uint32_t packed = (uint32_t)largest;
+        for (int i = 0; i < 4; i++)
+        {
+            if (i == largest)
+                continue;
+            float v = c[i] * scale * SQRT2 * 0.5f + 0.5f;
+            float quantized = std::round(std::max(0.0f, std::min(v, 1.0f)) * maxValue);
+            packed = (packed << ROTATION_BITS) | (uint32_t)quantized;
+        }
+        return packed;
+    }
+
+    static Quaternion unpackRotation(uint32_t packed)
+    {
+        const uint32_t mask = (1u << ROTATION_BITS) - 1;
+        const float maxValue = (float)mask;
+        int largest = (int)(packed >> (3 * ROTATION_BITS));
+        float c[4];
+        float sumSq = 0.0f;
+        int shift = 2 * ROTATION_BITS;
+        for (int i = 0; i < 4; i++)
+        {
+            if (i == largest)
+                continue;
+            float v = (float)((packed >> shift) & mask) / maxValue;
+            c[i] = (v - 0.5f) * 2.0f / SQRT2;
+            sumSq += c[i] * c[i];
+            shift -= ROTATION_BITS;
+        }
+        c[largest] = std::sqrt(std::max(0.0f, 1.0f - sumSq));
+        return Quaternion(c[0], c[1], c[2], c[3]);
+    }
+
+    // One coordinate on the grid of the current bound, and back
+    uint32_t quantize(float value, int axis) const
+    {
+        float t = (value - lower[axis]) / step(axis);
+        float maxValue = (float)((1u << positionBits) - 1);
+        return (uint32_t)std::round(std::max(0.0f, std::min(t, maxValue)));
+    }
+
+    float dequantize(uint32_t value, int axis) const
+    {
+        return lower[axis] + (float)value * step(axis);
+    }
+
+protected:
+    static constexpr float SQRT2 = 1.41421356f;
+
+    // The world bound, per axis
+    float lower[3] = {-100.0f, -10.0f, -100.0f};
+    float upper[3] = {100.0f, 90.0f, 100.0f};
+    int positionBits = 16;
+    Snapshot history[HISTORY];
+    // Baseline of a full frame
+    std::vector<Entry> noEntries;
+
+    float step(int axis) const
+    {
+        return (upper[axis] - lower[axis]) / (float)((1u << positionBits) - 1);
+    }
+
+    Snapshot* find(uint32_t sequence)
+    {
+        Snapshot& s = history[sequence % HISTORY];
+        return sequence != 0 && s.sequence == sequence ? &s : nullptr;
+    }
+
+    void clearHistory()
+    {
+        for (Snapshot& s : history)
+        {
+            s.sequence = 0;
+            s.entries.clear();
+        }
+    }
+
+    // Position deltas: a 2-bit class, then nothing (unchanged), a short signed delta, or
+    // the absolute value
+    static constexpr int SHORT_DELTA_BITS = 5;
+    static constexpr int MEDIUM_DELTA_BITS = 10;
+
+    static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+
+    static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+};
+
+class TransformEncoder : public TransformStream
+{
+public:
+    // Positions outside the bound are clamped to it. Changing the bound or the precision
+    // drops the history, so the next packets are full frames.
+    void setBounds(const AABB& box, int bits)
+    {
+        const Vector3 mn = box.min, mx = box.max;
+        lower[0] = mn.x;
+        lower[1] = mn.y;
+        lower[2] = mn.z;
+        upper[0] = std::max(mx.x, mn.x + 1e-3f);
+        upper[1] = std::max(mx.y, mn.y + 1e-3f);
+        upper[2] = std::max(mx.z, mn.z + 1e-3f);
+        positionBits = std::max(MIN_POSITION_BITS, std::min(bits, MAX_POSITION_BITS));
+        clearHistory();
+    }
+
+    // Quantizes the current transforms into the next snapshot; returns its sequence
+    uint32_t capture(const SlotMap<RigidBody>& bodies)
+    {
+        sequence = sequence + 1 == 0 ? 1 : sequence + 1;
+        Snapshot& s = history[sequence % HISTORY];
+        s.sequence = sequence;
+        s.entries.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); i++)
+        {
+            const RigidBody& body = bodies[i];
+            Entry& e = s.entries[i];
+            e.handle = bodies.handleAt(i);
+            e.x = quantize(body.position.x, 0);
+            e.y = quantize(body.position.y, 1);
+            e.z = quantize(body.position.z, 2);
+            e.rotation = packRotation(body.orientation);
+        }
+        // Dense order changes with every removal; slots do not
+        std::sort(s.entries.begin(), s.entries.end(), [](const Entry& a, const Entry& b)
+                  { return slotOf(a.handle) < slotOf(b.handle); });
+        return sequence;
+    }
+
+    // Encodes the latest capture against baseline, the newest sequence the viewer has
+    // acknowledged. 0, or a baseline that has left the history, gives a full frame.
+    const std::vector<uint8_t>& encode(uint32_t baseline)
+    {
+        packet.clear();
+        Snapshot* current = find(sequence);
+        if (!current)
+            return packet;
+        Snapshot* base = baseline != sequence ? find(baseline) : nullptr;
+        const std::vector<Entry>& from = base ? base->entries : noEntries;
+        const std::vector<Entry>& to = current->entries;
+
+        BitWriter out(packet);
+        out.write(MAGIC, 32);
+        out.write(sequence, 32);
+        out.write(base ? baseline : 0, 32);
+        out.write((uint32_t)positionBits, 8);
+        for (int axis = 0; axis < 3; axis++)
+            out.writeFloat(lower[axis]);
+        for (int axis = 0; axis < 3; axis++)
+            out.writeFloat(upper[axis]);
+
+        // Slots that emptied, then the bodies that are new or moved
+        removed.clear();
+        changed.clear();
+        size_t i = 0, j = 0;
+        while (i < to.size() || j < from.size())
+        {
+            uint32_t slotTo = i < to.size() ? slotOf(to[i].handle) : UINT32_MAX;
+            uint32_t slotFrom = j < from.size() ? slotOf(from[j].handle) : UINT32_MAX;
+            if (slotFrom < slotTo)
+            {
+                removed.push_back(slotFrom);
+                j++;
+            }
+            else if (slotTo < slotFrom)
+            {
+                changed.push_back({(uint32_t)i++, UINT32_MAX});
+            }
+            else
+            {
+                if (to[i].handle != from[j].handle || !to[i].sameTransform(from[j]))
+                    changed.push_back({(uint32_t)i, (uint32_t)j});
+                i++;
+                j++;
+            }
+        }
+
+        out.writeVarint((uint32_t)removed.size(), 8);
+        uint32_t previous = 0;
+        for (uint32_t slot : removed)
+        {
+            out.writeVarint(slot - previous, 4);
+            previous = slot;
+        }
+
+        out.writeVarint((uint32_t)changed.size(), 8);
+        previous = 0;
+        for (const Change& change : changed)
+        {
+            const Entry& e = to[change.to];
+            uint32_t slot = slotOf(e.handle);
+            out.writeVarint(slot - previous, 4);
+            previous = slot;
+
+            const Entry* b = change.from != UINT32_MAX ? &from[change.from] : nullptr;
+            bool fresh = !b || b->handle != e.handle;
+            out.write(fresh, 1);
+            if (fresh)
+            {
+                out.write(generationOf(e.handle), 32 - SlotMap<RigidBody>::INDEX_BITS);
+                out.write(e.x, positionBits);
+                out.write(e.y, positionBits);
+                out.write(e.z, positionBits);
+                out.write(e.rotation, 32);
+                continue;
+            }
+            bool moved = e.x != b->x || e.y != b->y || e.z != b->z;
+            out.write(moved, 1);
+            if (moved)
+            {
+                writeAxis(out, e.x, b->x);
+                writeAxis(out, e.y, b->y);
+                writeAxis(out, e.z, b->z);
+            }
+            bool turned = e.rotation != b->rotation;
+            out.write(turned, 1);
+            if (turned)
+                out.write(e.rotation, 32);
+        }
+        out.flush();
+        return packet;
+    }
+
+    uint32_t latest() const { return sequence; }
+
+    const std::vector<uint8_t>& getPacket() const { return packet; }
+
+    void clear()
+    {
+        clearHistory();
+        packet.clear();
+    }
+
+private:
+    struct Change
+    {
+        uint32_t to, from;
+    };
+
+    uint32_t sequence = 0;
+    std::vector<uint8_t> packet;
+    std::vector<uint32_t> removed;
+    std::vector<Change> changed;
+
+    void writeAxis(BitWriter& out, uint32_t value, uint32_t base)
+    {
+        int32_t delta = (int32_t)(value - base);
+        uint32_t z = zigzag(delta);
+        if (delta == 0)
+        {
+            out.write(0, 2);
+        }
+        else if (z < (1u << SHORT_DELTA_BITS))
+        {
+            out.write(1, 2);
+            out.write(z, SHORT_DELTA_BITS);
+        }
+        else if (z < (1u << MEDIUM_DELTA_BITS))
+        {
+            out.write(2, 2);
+            out.write(z, MEDIUM_DELTA_BITS);
+        }
+        else
+        {
+            out.write(3, 2);
+            out.write(value, positionBits);
+        }
+    }
+};
+
+// Rebuilds the transforms from packets, keeping its own history of decoded snapshots
+// for later packets to refer to
+class TransformDecoder : public TransformStream
+{
+public:
+    // Floats per body in getStates(): [handle, px, py, pz, qw, qx, qy, qz]; the handle is
+    // uint32 bits
+    static constexpr int STATE_STRIDE = 8;
+
+    // Returns the packet's sequence, which the viewer acknowledges to the encoder, or 0
+    // when the packet is malformed or its baseline is no longer held
+    uint32_t decode(const uint8_t* data, size_t size)
+    {
+        BitReader in(data, size);
+        if (in.read(32) != MAGIC)
+            return 0;
+        uint32_t sequence = in.read(32);
+        uint32_t baseline = in.read(32);
+        int bits = (int)in.read(8);
+        float low[3], high[3];
+        for (int axis = 0; axis < 3; axis++)
+            low[axis] = in.readFloat();
+        for (int axis = 0; axis < 3; axis++)
+            high[axis] = in.readFloat();
+        if (sequence == 0 || bits < MIN_POSITION_BITS || bits > MAX_POSITION_BITS)
+            return 0;
+
+        Snapshot* base = nullptr;
+        if (baseline != 0)
+        {
+            base = find(baseline);
+            if (!base || bits != positionBits)
+                return 0;
+        }
+        std::memcpy(lower, low, sizeof(lower));
+        std::memcpy(upper, high, sizeof(upper));
+        positionBits = bits;
+
+        // Every removal takes at least five bits
+        uint32_t removedCount = in.readVarint(8);
+        if (removedCount > size * 8 / 5)
+            return 0;
+        removed.resize(removedCount);
+        uint32_t previous = 0;
+        for (uint32_t& slot : removed)
+        {
+            slot = previous + in.readVarint(4);
+            previous = slot;
+        }
+
+        const std::vector<Entry>& from = base ? base->entries : noEntries;
+        scratch.clear();
+        size_t j = 0, r = 0;
+        // Copies the baseline entries before slot, dropping removed ones
+        auto copyUntil = [&](uint32_t slot)
+        {
+            while (j < from.size() && slotOf(from[j].handle) < slot)
+            {
+                while (r < removed.size() && removed[r] < slotOf(from[j].handle))
+                    r++;
+                if (r == removed.size() || removed[r] != slotOf(from[j].handle))
+                    scratch.push_back(from[j]);
+                j++;
+            }
+        };
+
+        uint32_t changedCount = in.readVarint(8);
+        previous = 0;
+        for (uint32_t n = 0; n < changedCount && !in.overrun; n++)
+        {
+            uint32_t slot = previous + in.readVarint(4);
+            previous = slot;
+            copyUntil(slot);
+            const Entry* b = nullptr;
+            if (j < from.size() && slotOf(from[j].handle) == slot)
+                b = &from[j++];
+
+            Entry e;
+            if (in.read(1))
+            {
+                uint32_t generation = in.read(32 - SlotMap<RigidBody>::INDEX_BITS);
+                e.handle = (generation << SlotMap<RigidBody>::INDEX_BITS) | slot;
+                e.x = in.read(bits);
+                e.y = in.read(bits);
+                e.z = in.read(bits);
+                e.rotation = in.read(32);
+            }
+            else
+            {
+                if (!b)
+                    return 0;
+                e = *b;
+                if (in.read(1))
+                {
+                    e.x = readAxis(in, b->x);
+                    e.y = readAxis(in, b->y);
+                    e.z = readAxis(in, b->z);
+                }
+                if (in.read(1))
+                    e.rotation = in.read(32);
+            }
+            scratch.push_back(e);
+        }
+        copyUntil(UINT32_MAX);
+        if (in.overrun)
+            return 0;
+
+        Snapshot& s = history[sequence % HISTORY];
+        s.sequence = sequence;
+        s.entries.swap(scratch);
+        current = sequence;
+        buildStates(s);
+        return sequence;
+    }
+
+    uint32_t latest() const { return current; }
+
+    int getBodyCount() const { return (int)(states.size() / STATE_STRIDE); }
+
+    const std::vector<float>& getStateList() const { return states; }
+
+#ifdef __EMSCRIPTEN__
+    // Takes the packet as a Uint8Array
+    uint32_t decodePacket(val bytes)
+    {
+        size_t size = bytes["length"].as<size_t>();
+        input.resize(size);
+        val(typed_memory_view(size, input.data())).call<void>("set", bytes);
+        return decode(input.data(), size);
+    }
+
+    // Float32Array view of getBodyCount() records of STATE_STRIDE floats, valid until the
+    // next decode
+    val getStates() { return val(typed_memory_view(states.size(), states.data())); }
+#endif
+
+private:
+    uint32_t current = 0;
+    std::vector<uint32_t> removed;
+    std::vector<Entry> scratch;
+    std::vector<float> states;
+    std::vector<uint8_t> input;
+
+    uint32_t readAxis(BitReader& in, uint32_t base)
+    {
+        switch (in.read(2))
+        {
+        case 1:
+            return base + (uint32_t)unzigzag(in.read(SHORT_DELTA_BITS));
+        case 2:
+            return base + (uint32_t)unzigzag(in.read(MEDIUM_DELTA_BITS));
+        case 3:
+            return in.read(positionBits);
+        default:
+            return base;
+        }
+    }
+
+    void buildStates(const Snapshot& s)
+    {
+        states.resize(s.entries.size() * STATE_STRIDE);
+        float* out = states.data();
+        for (const Entry& e : s.entries)
+        {
+            Quaternion q = unpackRotation(e.rotation);
+            std::memcpy(out, &e.handle, sizeof(float));
+            out[1] = dequantize(e.x, 0);
+            out[2] = dequantize(e.y, 1);
+            out[3] = dequantize(e.z, 2);
+            out[4] = q.w;
+            out[5] = q.x;
+            out[6] = q.y;
+            out[7] = q.z;
+            out += STATE_STRIDE;
+        }
+    }
+};
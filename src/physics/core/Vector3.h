@@ -1,6 +1,9 @@
 #pragma once
 #include <cmath>
+
+#ifdef __EMSCRIPTEN__
 #include <emscripten/val.h>
+#endif
 
 class Vector3
 {
@@ -57,6 +60,7 @@ public:
         return Vector3(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x);
     }
 
+#ifdef __EMSCRIPTEN__
     emscripten::val toJs() const
     {
         emscripten::val obj = emscripten::val::object();
@@ -65,4 +69,5 @@ public:
         obj.set("z", z);
         return obj;
     }
+#endif
 };
\ No newline at end of file
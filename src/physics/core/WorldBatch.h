@@ -0,0 +1,115 @@
+#pragma once
+#include "PhysicsWorld.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+using namespace emscripten;
+#endif
+
+// Many independent copies of one scene, for planning rollouts and parameter sweeps. The
+// seed world is built through the usual API and cloned into one array of worlds. A step
+// hands whole worlds to the thread pool: the worlds are small, and they share only shapes
+// and terrain, which stepping never writes.
+template <typename Config>
+class BasicWorldBatch
+{
+public:
+    using World = BasicPhysicsWorld<Config>;
+
+    // threads counts the calling thread; 0 picks the hardware concurrency
+    explicit BasicWorldBatch(int threads = 0) : pool(threads) {}
+
+    // The scene clone() copies
+    World* getSeed() { return &seed; }
+
+    // Replaces the batch with count copies of the seed. Cloning shares the seed's shape
+    // registry, so it runs on the calling thread.
+    void clone(int count)
+    {
+        count = std::max(count, 0);
+        if (count != worldCount)
+        {
+            worlds.reset();
+            worlds.reset(count > 0 ? new World[count] : nullptr);
+            worldCount = count;
+        }
+        for (int i = 0; i < worldCount; i++)
+            worlds[i].cloneFrom(seed);
+        bodiesPerWorld = seed.getBodyCount();
+    }
+
+    // Puts one world back in the seed's state, e.g. to restart a rollout
+    void resetWorld(int index)
+    {
+        if (index >= 0 and index < worldCount)
+            worlds[index].cloneFrom(seed);
+    }
+
+    // Per-world access for inputs that differ between rollouts; null when out of range
+    World* getWorld(int index)
+    {
+        return index >= 0 and index < worldCount ? &worlds[index] : nullptr;
+    }
+
+    int getWorldCount() { return worldCount; }
+
+    // Bodies per world in the state readback: the seed's count at the last clone()
+    int getBodiesPerWorld() { return bodiesPerWorld; }
+
+    void setThreadCount(int threads) { pool.resize(threads); }
+
+    int getThreadCount() { return pool.size(); }
+
+    // Advances every world by frames steps of dt
+    void step(float dt, int frames)
+    {
+        pool.parallelFor(worldCount,
+                         [&](int i)
+                         {
+                             for (int f = 0; f < frames; f++)
+                                 worlds[i].step(dt);
+                         });
+    }
+
+    // Gathers the body states of all worlds: worldCount blocks of getBodiesPerWorld()
+    // records of World::BODY_STATE_STRIDE floats, bodies in dense order. A world that has
+    // lost bodies since the clone leaves the rest of its block zeroed.
+    const std::vector<float>& readStates()
+    {
+        const size_t block = (size_t)bodiesPerWorld * World::BODY_STATE_STRIDE;
+        states.resize(block * worldCount);
+        pool.parallelFor(worldCount,
+                         [&](int i)
+                         {
+                             float* out = states.data() + block * i;
+                             int written = worlds[i].readBodyStates(out, bodiesPerWorld);
+                             std::fill(out + (size_t)written * World::BODY_STATE_STRIDE,
+                                       out + block, 0.0f);
+                         });
+        return states;
+    }
+
+#ifdef __EMSCRIPTEN__
+    // Float32Array view of readStates(), valid until the next call
+    val getStates()
+    {
+        const std::vector<float>& s = readStates();
+        return val(typed_memory_view(s.size(), s.data()));
+    }
+#endif
+
+private:
+    World seed;
+    // One allocation for all worlds; each world's bodies and scratch live on its own
+    std::unique_ptr<World[]> worlds;
+    int worldCount = 0;
+    int bodiesPerWorld = 0;
+    ThreadPool pool;
+    std::vector<float> states;
+};
+
+using WorldBatch = BasicWorldBatch<DefaultWorldConfig>;
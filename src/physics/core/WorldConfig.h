@@ -0,0 +1,31 @@
+#pragma once
+#include "../geometry/Shape.h"
+#include <cstdint>
+
+constexpr uint32_t shapeBit(ShapeType type) { return 1u << type; }
+
+// Build-time settings of a BasicPhysicsWorld. A product that knows its needs up front
+// derives its own config and overrides fields; everything that is disabled here is
+// compiled out of the world (dispatch branches, floor pass, add* functions).
+struct DefaultWorldConfig
+{
+    // Only float is supported for now: the math types are single precision
+    using Scalar = float;
+    static constexpr int substeps = 4;
+    // Initial cap of the iterative constraint solver; the runtime setter and the frame
+    // budget can still lower or raise it
+    static constexpr int constraintIterations = 5;
+    // Cap on velocity passes over each substep's contacts; converged sets stop earlier
+    static constexpr int contactIterations = 4;
+    static constexpr uint32_t shapes =
+        shapeBit(SPHERE) | shapeBit(BOX) | shapeBit(CYLINDER) | shapeBit(MESH) |
+        shapeBit(COMPOUND) | shapeBit(CAPSULE) | shapeBit(PYRAMID) | shapeBit(HULL);
+    // Built-in ground plane at y = 0
+    static constexpr bool floorPlane = true;
+};
+
+// For titles that only use spheres and boxes
+struct SphereBoxWorldConfig : DefaultWorldConfig
+{
+    static constexpr uint32_t shapes = shapeBit(SPHERE) | shapeBit(BOX);
+};
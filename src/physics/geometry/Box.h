@@ -5,5 +5,20 @@
 class Box : public Shape {
 public:
     Vector3 halfExtents;
-    Box(float w, float h, float d) : Shape(BOX), halfExtents(w/2.0f, h/2.0f, d/2.0f) {}
-};
\ No newline at end of file
+    // Corners in local space, used by the plane and point tests
+    Vector3 corners[8];
+
+    Box(float w, float h, float d) : Shape(BOX), halfExtents(w/2.0f, h/2.0f, d/2.0f)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            corners[i] = Vector3((i & 1) ? -halfExtents.x : halfExtents.x,
+                                 (i & 2) ? -halfExtents.y : halfExtents.y,
+                                 (i & 4) ? -halfExtents.z : halfExtents.z);
+        }
+        float factor = 1.0f / 12.0f;
+        unitInertia = Vector3(factor * (h * h + d * d), factor * (w * w + d * d),
+                              factor * (w * w + h * h));
+        boundingRadius = halfExtents.magnitude();
+    }
+};
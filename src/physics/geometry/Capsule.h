@@ -0,0 +1,25 @@
+#pragma once
+#include "Shape.h"
+
+// Segment along the local y axis swept by a sphere. length is the distance between the two
+// cap centres (the straight part), as in three.js CapsuleGeometry.
+class Capsule : public Shape {
+public:
+    float radius;
+    float halfLength;
+
+    Capsule(float r, float length) : Shape(CAPSULE), radius(r), halfLength(length / 2.0f)
+    {
+        // Cylinder plus two hemispheres, mass split by volume
+        float r2 = r * r;
+        float cylinderVolume = r2 * length;
+        float sphereVolume = (4.0f / 3.0f) * r2 * r;
+        float mc = cylinderVolume / (cylinderVolume + sphereVolume);
+        float ms = 1.0f - mc;
+        float iy = mc * 0.5f * r2 + ms * 0.4f * r2;
+        float ixz = mc * (length * length / 12.0f + r2 / 4.0f) +
+                    ms * (0.4f * r2 + length * length / 4.0f + 0.375f * length * r);
+        unitInertia = Vector3(ixz, iy, ixz);
+        boundingRadius = halfLength + r;
+    }
+};
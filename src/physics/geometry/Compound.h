@@ -0,0 +1,251 @@
+#pragma once
+#include "../core/AABB.h"
+#include "../core/Matrix3x3.h"
+#include "../core/Quaternion.h"
+#include "Box.h"
+#include "Capsule.h"
+#include "Cylinder.h"
+#include "Sphere.h"
+#include <algorithm>
+#include <vector>
+
+// Rigid assembly of primitive children (spheres, boxes, cylinders, capsules), each at a
+// local offset and rotation, so a table or an L-shaped piece is one body instead of several
+// bodies held together by constraints. Children are registry shapes; the compound holds a
+// reference to each for its lifetime (see ShapeRegistry::release).
+//
+// Mass is spread over the children by volume. The constructor moves the children so their
+// combined centre of mass sits at the local origin, which is where the body's position is;
+// centerOfMass keeps the shift, in the frame the children were given in.
+class Compound : public Shape
+{
+public:
+    struct Child
+    {
+        const Shape* shape;
+        Vector3 offset;
+        Quaternion rotation;
+    };
+
+    // Hierarchy over the children's local bounds, stored depth first. A leaf holds one
+    // child; next is the index just past the node's subtree.
+    struct Node
+    {
+        AABB bounds;
+        int child; // -1 for internal nodes
+        int next;
+    };
+
+    Compound(const Child* source, int count) : Shape(COMPOUND), children(source, source + count)
+    {
+        std::vector<float> fractions(count);
+        float totalVolume = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            fractions[i] = volume(children[i].shape);
+            totalVolume += fractions[i];
+        }
+        for (float& f : fractions)
+            f = totalVolume > 0.0f ? f / totalVolume : 1.0f / count;
+
+        for (int i = 0; i < count; i++)
+            centerOfMass += children[i].offset * fractions[i];
+
+        // Parallel axis theorem over the rotated child tensors, per unit of total mass
+        for (int i = 0; i < 9; i++)
+            unitInertiaTensor.data[i] = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            Child& c = children[i];
+            c.offset = c.offset - centerOfMass;
+            Matrix3 local;
+            local.setDiagonal(c.shape->unitInertia.x, c.shape->unitInertia.y,
+                              c.shape->unitInertia.z);
+            Matrix3 r = rotationMatrix(c.rotation);
+            Matrix3 rotated = r * local * r.transpose();
+            const Vector3& d = c.offset;
+            float d2 = d.magnitudeSquared();
+            const float* dc = &d.x;
+            for (int row = 0; row < 3; row++)
+            {
+                for (int col = 0; col < 3; col++)
+                {
+                    float shift = (row == col ? d2 : 0.0f) - dc[row] * dc[col];
+                    unitInertiaTensor.data[row * 3 + col] +=
+                        fractions[i] * (rotated.data[row * 3 + col] + shift);
+                }
+            }
+            boundingRadius = std::max(boundingRadius, d.magnitude() + c.shape->boundingRadius);
+        }
+        unitInertia = Vector3(unitInertiaTensor.data[0], unitInertiaTensor.data[4],
+                              unitInertiaTensor.data[8]);
+
+        std::vector<AABB> bounds(count);
+        std::vector<int> order(count);
+        for (int i = 0; i < count; i++)
+        {
+            bounds[i] = childBounds(children[i]);
+            order[i] = i;
+        }
+        nodes.reserve(2 * count - 1);
+        build(bounds, order, 0, count);
+    }
+
+    const std::vector<Child>& getChildren() const { return children; }
+    const Vector3& getCenterOfMass() const { return centerOfMass; }
+    // Full inertia tensor about the centre of mass for a unit mass; unitInertia only has
+    // its diagonal
+    const Matrix3& getUnitInertiaTensor() const { return unitInertiaTensor; }
+    const AABB& getBounds() const { return nodes[0].bounds; }
+
+    // Calls visit(childIndex) for every child whose local bounds overlap box
+    template <typename Visit>
+    void query(const AABB& box, Visit visit) const
+    {
+        int i = 0;
+        int end = (int)nodes.size();
+        while (i < end)
+        {
+            const Node& node = nodes[i];
+            if (!node.bounds.overlaps(box))
+            {
+                i = node.next;
+                continue;
+            }
+            if (node.child >= 0)
+                visit(node.child);
+            i++;
+        }
+    }
+
+private:
+    std::vector<Child> children;
+    std::vector<Node> nodes;
+    Vector3 centerOfMass;
+    Matrix3 unitInertiaTensor;
+
+    static float volume(const Shape* shape)
+    {
+        if (shape->type == SPHERE)
+        {
+            float r = ((const Sphere*)shape)->radius;
+            return 4.18879f * r * r * r;
+        }
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            return 8.0f * h.x * h.y * h.z;
+        }
+        if (shape->type == CYLINDER)
+        {
+            const Cylinder* c = (const Cylinder*)shape;
+            return 6.28318f * c->radius * c->radius * c->halfHeight;
+        }
+        if (shape->type == CAPSULE)
+        {
+            const Capsule* c = (const Capsule*)shape;
+            return 6.28318f * c->radius * c->radius * c->halfLength +
+                   4.18879f * c->radius * c->radius * c->radius;
+        }
+        float r = shape->boundingRadius;
+        return 4.18879f * r * r * r;
+    }
+
+    static Matrix3 rotationMatrix(const Quaternion& q)
+    {
+        Vector3 columns[3] = {q.rotate(Vector3(1, 0, 0)), q.rotate(Vector3(0, 1, 0)),
+                              q.rotate(Vector3(0, 0, 1))};
+        Matrix3 m;
+        for (int col = 0; col < 3; col++)
+        {
+            m.data[col] = columns[col].x;
+            m.data[3 + col] = columns[col].y;
+            m.data[6 + col] = columns[col].z;
+        }
+        return m;
+    }
+
+    // Bounds of a child in the compound's frame
+    static AABB childBounds(const Child& c)
+    {
+        const Shape* shape = c.shape;
+        if (shape->type == SPHERE)
+        {
+            float r = ((const Sphere*)shape)->radius;
+            return AABB::fromCenter(c.offset, Vector3(r, r, r));
+        }
+        if (shape->type == BOX)
+        {
+            Vector3 h = ((const Box*)shape)->halfExtents;
+            Matrix3 m = rotationMatrix(c.rotation);
+            Vector3 e;
+            float* ec = &e.x;
+            for (int row = 0; row < 3; row++)
+            {
+                ec[row] = std::abs(m.data[row * 3]) * h.x + std::abs(m.data[row * 3 + 1]) * h.y +
+                          std::abs(m.data[row * 3 + 2]) * h.z;
+            }
+            return AABB::fromCenter(c.offset, e);
+        }
+        if (shape->type == CYLINDER)
+        {
+            const Cylinder* cyl = (const Cylinder*)shape;
+            Vector3 a = c.rotation.rotate(Vector3(0, 1, 0));
+            auto extent = [&](float ai)
+            {
+                return cyl->halfHeight * std::abs(ai) +
+                       cyl->radius * std::sqrt(std::max(0.0f, 1.0f - ai * ai));
+            };
+            return AABB::fromCenter(c.offset, Vector3(extent(a.x), extent(a.y), extent(a.z)));
+        }
+        if (shape->type == CAPSULE)
+        {
+            const Capsule* cap = (const Capsule*)shape;
+            Vector3 a = c.rotation.rotate(Vector3(0, cap->halfLength, 0));
+            return AABB::fromCenter(c.offset, Vector3(std::abs(a.x) + cap->radius,
+                                                      std::abs(a.y) + cap->radius,
+                                                      std::abs(a.z) + cap->radius));
+        }
+        float r = shape->boundingRadius;
+        return AABB::fromCenter(c.offset, Vector3(r, r, r));
+    }
+
+    // Median split along the widest axis of the child centres
+    void build(const std::vector<AABB>& bounds, std::vector<int>& order, int begin, int end)
+    {
+        int index = (int)nodes.size();
+        nodes.push_back(Node{bounds[order[begin]], -1, 0});
+        for (int i = begin + 1; i < end; i++)
+            nodes[index].bounds = nodes[index].bounds.merged(bounds[order[i]]);
+        if (end - begin == 1)
+        {
+            nodes[index].child = order[begin];
+            nodes[index].next = index + 1;
+            return;
+        }
+
+        Vector3 lo = bounds[order[begin]].center(), hi = lo;
+        for (int i = begin + 1; i < end; i++)
+        {
+            Vector3 c = bounds[order[i]].center();
+            lo = Vector3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+            hi = Vector3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+        }
+        Vector3 spread = hi - lo;
+        int axis = 2;
+        if (spread.x >= spread.y && spread.x >= spread.z)
+            axis = 0;
+        else if (spread.y >= spread.z)
+            axis = 1;
+        int mid = (begin + end) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](int a, int b)
+                         {
+                             Vector3 ca = bounds[a].center(), cb = bounds[b].center();
+                             return (&ca.x)[axis] < (&cb.x)[axis];
+                         });
+        build(bounds, order, begin, mid);
+        build(bounds, order, mid, end);
+        nodes[index].next = (int)nodes.size();
+    }
+};
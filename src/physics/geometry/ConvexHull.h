@@ -0,0 +1,353 @@
+#pragma once
+#include "../core/AABB.h"
+#include "../core/Matrix3x3.h"
+#include "Pyramid.h"
+#include "Shape.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// Convex polyhedron around a point cloud; points inside the hull are dropped. Like a
+// compound it is recentred: vertices are stored around the centre of mass, which is where
+// the body's position is, and centerOfMass keeps the shift in the frame the points were
+// given in.
+//
+// Support lookups hill-climb the vertex adjacency from a start vertex the caller keeps, so
+// a query in about last step's direction takes a step or two instead of a full scan.
+class ConvexHull : public Shape
+{
+public:
+    // Cap on hull vertices, so the point-cloud contact tests can use fixed buffers
+    static const int MAX_VERTICES = 64;
+
+    ConvexHull(const float* points, int count) : Shape(HULL)
+    {
+        std::vector<Triangle> triangles;
+        if (!build(points, count, triangles))
+            return;
+        computeMass(triangles);
+    }
+
+    // False for fewer than four non-coplanar points, or more than MAX_VERTICES on the hull
+    bool isValid() const { return !vertices.empty(); }
+
+    int getVertexCount() const { return (int)vertices.size(); }
+    const Vector3* getVertices() const { return vertices.data(); }
+    // Outward face planes; a point p is inside when normal . p <= offset for every face
+    int getFaceCount() const { return (int)faceNormals.size(); }
+    const Vector3* getFaceNormals() const { return faceNormals.data(); }
+    const float* getFaceOffsets() const { return faceOffsets.data(); }
+    const AABB& getBounds() const { return bounds; }
+    const Vector3& getCenterOfMass() const { return centerOfMass; }
+    // Full inertia tensor about the centre of mass for a unit mass; unitInertia only has
+    // its diagonal
+    const Matrix3& getUnitInertiaTensor() const { return unitInertiaTensor; }
+
+    // Index of the vertex furthest along dir, climbing from vertex start. On a convex hull
+    // the only local maximum is the global one.
+    int support(const Vector3& dir, int start) const
+    {
+        int best = start >= 0 && start < (int)vertices.size() ? start : 0;
+        float bestDot = vertices[best].dot(dir);
+        for (;;)
+        {
+            int next = best;
+            for (int i = adjacencyStart[best]; i < adjacencyStart[best + 1]; i++)
+            {
+                float d = vertices[adjacency[i]].dot(dir);
+                if (d > bestDot)
+                {
+                    bestDot = d;
+                    next = adjacency[i];
+                }
+            }
+            if (next == best)
+                return best;
+            best = next;
+        }
+    }
+
+private:
+    struct Triangle
+    {
+        int v[3];
+        Vector3 normal;
+        float offset;
+    };
+
+    std::vector<Vector3> vertices;
+    // Neighbours of vertex i are adjacency[adjacencyStart[i] .. adjacencyStart[i + 1])
+    std::vector<int> adjacencyStart;
+    std::vector<int> adjacency;
+    std::vector<Vector3> faceNormals;
+    std::vector<float> faceOffsets;
+    AABB bounds;
+    Vector3 centerOfMass;
+    Matrix3 unitInertiaTensor;
+
+    // Incremental hull: a tetrahedron of extreme points, then every point outside the
+    // current hull replaces the faces it sees with a fan to their horizon. Fine for the
+    // few hundred points of a prop; fills vertices, adjacency and the face planes.
+    bool build(const float* points, int count, std::vector<Triangle>& triangles)
+    {
+        if (count < 4)
+            return false;
+        std::vector<Vector3> p(count);
+        Vector3 lo(points[0], points[1], points[2]), hi = lo;
+        for (int i = 0; i < count; i++)
+        {
+            p[i] = Vector3(points[i * 3], points[i * 3 + 1], points[i * 3 + 2]);
+            lo = Vector3(std::min(lo.x, p[i].x), std::min(lo.y, p[i].y), std::min(lo.z, p[i].z));
+            hi = Vector3(std::max(hi.x, p[i].x), std::max(hi.y, p[i].y), std::max(hi.z, p[i].z));
+        }
+        float eps = 1e-5f * (hi - lo).magnitude();
+
+        int i0 = 0, i1 = 0, i2 = 0, i3 = 0;
+        for (int i = 1; i < count; i++)
+        {
+            if (p[i].x < p[i0].x)
+                i0 = i;
+        }
+        float best = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            float d = (p[i] - p[i0]).magnitudeSquared();
+            if (d > best)
+            {
+                best = d;
+                i1 = i;
+            }
+        }
+        if (best <= eps * eps)
+            return false;
+        Vector3 edge = p[i1] - p[i0];
+        best = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            float d = (p[i] - p[i0]).cross(edge).magnitudeSquared();
+            if (d > best)
+            {
+                best = d;
+                i2 = i;
+            }
+        }
+        if (best <= eps * eps * edge.magnitudeSquared())
+            return false;
+        Vector3 n = edge.cross(p[i2] - p[i0]);
+        n.normalize();
+        best = 0.0f;
+        for (int i = 0; i < count; i++)
+        {
+            float d = std::abs((p[i] - p[i0]).dot(n));
+            if (d > best)
+            {
+                best = d;
+                i3 = i;
+            }
+        }
+        if (best <= eps)
+            return false;
+        // Wind the first face away from the fourth point
+        if ((p[i3] - p[i0]).dot(n) > 0.0f)
+            std::swap(i1, i2);
+        addTriangle(p, triangles, i0, i1, i2);
+        addTriangle(p, triangles, i0, i3, i1);
+        addTriangle(p, triangles, i0, i2, i3);
+        addTriangle(p, triangles, i1, i3, i2);
+
+        std::vector<std::pair<int, int>> horizon;
+        for (int i = 0; i < count; i++)
+        {
+            if (i == i0 || i == i1 || i == i2 || i == i3)
+                continue;
+            horizon.clear();
+            for (size_t f = 0; f < triangles.size();)
+            {
+                const Triangle& t = triangles[f];
+                if (t.normal.dot(p[i]) - t.offset <= eps)
+                {
+                    f++;
+                    continue;
+                }
+                // Edges shared by two visible faces cancel; the rest form the horizon
+                for (int k = 0; k < 3; k++)
+                {
+                    int a = t.v[k], b = t.v[(k + 1) % 3];
+                    auto twin = std::find(horizon.begin(), horizon.end(), std::make_pair(b, a));
+                    if (twin != horizon.end())
+                    {
+                        *twin = horizon.back();
+                        horizon.pop_back();
+                    }
+                    else
+                    {
+                        horizon.push_back(std::make_pair(a, b));
+                    }
+                }
+                triangles[f] = triangles.back();
+                triangles.pop_back();
+            }
+            for (const auto& e : horizon)
+                addTriangle(p, triangles, e.first, e.second, i);
+        }
+
+        std::vector<int> remap(count, -1);
+        for (Triangle& t : triangles)
+        {
+            for (int& v : t.v)
+            {
+                if (remap[v] < 0)
+                {
+                    remap[v] = (int)vertices.size();
+                    vertices.push_back(p[v]);
+                }
+                v = remap[v];
+            }
+        }
+        if ((int)vertices.size() > MAX_VERTICES)
+        {
+            vertices.clear();
+            return false;
+        }
+
+        // Every undirected edge appears once in each winding, so each directed edge gives
+        // one neighbour
+        adjacencyStart.assign(vertices.size() + 1, 0);
+        for (const Triangle& t : triangles)
+        {
+            for (int k = 0; k < 3; k++)
+                adjacencyStart[t.v[k] + 1]++;
+        }
+        for (size_t i = 1; i < adjacencyStart.size(); i++)
+            adjacencyStart[i] += adjacencyStart[i - 1];
+        adjacency.resize(adjacencyStart.back());
+        std::vector<int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (const Triangle& t : triangles)
+        {
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[t.v[k]]++] = t.v[(k + 1) % 3];
+        }
+
+        // Coplanar triangles share one plane
+        for (const Triangle& t : triangles)
+        {
+            bool known = false;
+            for (size_t f = 0; f < faceNormals.size() && !known; f++)
+            {
+                known = faceNormals[f].dot(t.normal) > 1.0f - 1e-5f &&
+                        std::abs(faceOffsets[f] - t.offset) <= eps;
+            }
+            if (!known)
+            {
+                faceNormals.push_back(t.normal);
+                faceOffsets.push_back(t.offset);
+            }
+        }
+        return true;
+    }
+
+    static void addTriangle(const std::vector<Vector3>& p, std::vector<Triangle>& triangles,
+                            int a, int b, int c)
+    {
+        Triangle t{{a, b, c}, (p[b] - p[a]).cross(p[c] - p[a]), 0.0f};
+        t.normal.normalize();
+        t.offset = t.normal.dot(p[a]);
+        triangles.push_back(t);
+    }
+
+    // Volume, centre of mass and inertia from the tetrahedra between an interior point
+    // and each face, then moves the hull so the centre of mass is the origin
+    void computeMass(const std::vector<Triangle>& triangles)
+    {
+        Vector3 ref;
+        for (const Vector3& v : vertices)
+            ref += v;
+        ref *= 1.0f / vertices.size();
+
+        float volume = 0.0f;
+        Vector3 moment;
+        float covariance[9] = {};
+        for (const Triangle& t : triangles)
+        {
+            Vector3 a = vertices[t.v[0]] - ref;
+            Vector3 b = vertices[t.v[1]] - ref;
+            Vector3 c = vertices[t.v[2]] - ref;
+            float det = a.dot(b.cross(c));
+            Vector3 s = a + b + c;
+            volume += det;
+            moment += s * det;
+            const float *ac = &a.x, *bc = &b.x, *cc = &c.x, *sc = &s.x;
+            for (int row = 0; row < 3; row++)
+            {
+                for (int col = 0; col < 3; col++)
+                {
+                    covariance[row * 3 + col] += det * (ac[row] * ac[col] + bc[row] * bc[col] +
+                                                        cc[row] * cc[col] + sc[row] * sc[col]);
+                }
+            }
+        }
+        Vector3 m = moment * (1.0f / (4.0f * volume));
+        volume /= 6.0f;
+        centerOfMass = ref + m;
+
+        // Second moment about the centre of mass, per unit volume, then I = tr(C) - C
+        const float* mc = &m.x;
+        float c[9];
+        for (int row = 0; row < 3; row++)
+        {
+            for (int col = 0; col < 3; col++)
+            {
+                c[row * 3 + col] =
+                    covariance[row * 3 + col] / (120.0f * volume) - mc[row] * mc[col];
+            }
+        }
+        float trace = c[0] + c[4] + c[8];
+        for (int i = 0; i < 9; i++)
+            unitInertiaTensor.data[i] = (i % 4 == 0 ? trace : 0.0f) - c[i];
+        unitInertia = Vector3(unitInertiaTensor.data[0], unitInertiaTensor.data[4],
+                              unitInertiaTensor.data[8]);
+
+        Vector3 lo = vertices[0] - centerOfMass, hi = lo;
+        for (Vector3& v : vertices)
+        {
+            v = v - centerOfMass;
+            lo = Vector3(std::min(lo.x, v.x), std::min(lo.y, v.y), std::min(lo.z, v.z));
+            hi = Vector3(std::max(hi.x, v.x), std::max(hi.y, v.y), std::max(hi.z, v.z));
+            boundingRadius = std::max(boundingRadius, v.magnitude());
+        }
+        bounds = AABB(lo, hi);
+        for (size_t f = 0; f < faceNormals.size(); f++)
+            faceOffsets[f] -= faceNormals[f].dot(centerOfMass);
+    }
+};
+
+// Vertices and outward face planes of a pyramid or hull, for the tests that treat both as
+// plain polyhedra
+struct Polyhedron
+{
+    const Vector3* vertices;
+    int vertexCount;
+    const Vector3* normals;
+    const float* offsets;
+    int faceCount;
+
+    static bool of(const Shape* shape, Polyhedron& out)
+    {
+        if (shape->type == PYRAMID)
+        {
+            const Pyramid* p = (const Pyramid*)shape;
+            out = Polyhedron{p->vertices, Pyramid::VERTEX_COUNT, p->faceNormals, p->faceOffsets,
+                             Pyramid::FACE_COUNT};
+            return true;
+        }
+        if (shape->type == HULL)
+        {
+            const ConvexHull* h = (const ConvexHull*)shape;
+            out = Polyhedron{h->getVertices(), h->getVertexCount(), h->getFaceNormals(),
+                             h->getFaceOffsets(), h->getFaceCount()};
+            return true;
+        }
+        return false;
+    }
+};
@@ -3,8 +3,32 @@
 
 class Cylinder : public Shape {
 public:
+    static const int SEGMENTS = 16;
+    static const int POINT_COUNT = SEGMENTS * 2 + 2;
+
     float radius;
     float halfHeight;
+    // Rim and cap-centre sample points in local space, shared by the point-cloud tests
+    Vector3 supportPoints[POINT_COUNT];
+
+    Cylinder(float r, float h) : Shape(CYLINDER), radius(r), halfHeight (h / 2.0f)
+    {
+        float step = 6.28318f / SEGMENTS;
+        for (int i = 0; i < SEGMENTS; i++)
+        {
+            float angle = i * step;
+            float x = std::cos(angle) * radius;
+            float z = std::sin(angle) * radius;
+            supportPoints[i * 2] = Vector3(x, halfHeight, z);
+            supportPoints[i * 2 + 1] = Vector3(x, -halfHeight, z);
+        }
+        supportPoints[SEGMENTS * 2] = Vector3(0, halfHeight, 0);
+        supportPoints[SEGMENTS * 2 + 1] = Vector3(0, -halfHeight, 0);
 
-    Cylinder(float r, float h) : Shape(CYLINDER), radius(r), halfHeight (h / 2.0f) {}
-};
\ No newline at end of file
+        float r2 = r * r;
+        float iy = 0.5f * r2;
+        float ixz = (1.0f / 12.0f) * (3.0f * r2 + h * h);
+        unitInertia = Vector3(ixz, iy, ixz);
+        boundingRadius = std::sqrt(r2 + halfHeight * halfHeight);
+    }
+};
@@ -0,0 +1,156 @@
+#pragma once
+#include "../core/Vector3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Static terrain as a regular grid of height samples over the XZ plane. Each cell is split
+// into two triangles along the diagonal from (x0, z0) to (x1, z1), so the surface under
+// any point is found with one division per axis. Samples are stored either as floats or
+// quantized to int16 (2 bytes per sample; the step is (max - min) / 65535).
+class Heightfield
+{
+public:
+    enum Format
+    {
+        FLOAT32,
+        INT16
+    };
+
+    // heights has columns * rows samples, row-major with x varying fastest
+    Heightfield(const float* heights, int columns, int rows, float cellSize, float originX,
+                float originZ, Format format)
+        : columns(columns), rows(rows), cellSize(cellSize), inverseCellSize(1.0f / cellSize),
+          originX(originX), originZ(originZ), format(format)
+    {
+        size_t count = (size_t)columns * rows;
+        minHeight = count ? *std::min_element(heights, heights + count) : 0.0f;
+        maxHeight = count ? *std::max_element(heights, heights + count) : 0.0f;
+        if (format == FLOAT32)
+        {
+            samples.assign(heights, heights + count);
+            return;
+        }
+        scale = maxHeight > minHeight ? (maxHeight - minHeight) / 65535.0f : 1.0f;
+        quantized.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            float q = std::round((heights[i] - minHeight) / scale) - 32768.0f;
+            quantized[i] = (int16_t)std::max(-32768.0f, std::min(q, 32767.0f));
+        }
+    }
+
+    int getColumns() const { return columns; }
+    int getRows() const { return rows; }
+    float getCellSize() const { return cellSize; }
+    float getMinHeight() const { return minHeight; }
+    float getMaxHeight() const { return maxHeight; }
+    size_t bytes() const
+    {
+        return format == FLOAT32 ? samples.size() * sizeof(float)
+                                 : quantized.size() * sizeof(int16_t);
+    }
+
+    float sample(int x, int z) const
+    {
+        size_t i = (size_t)z * columns + x;
+        if (format == FLOAT32)
+            return samples[i];
+        return minHeight + ((float)quantized[i] + 32768.0f) * scale;
+    }
+
+    Vector3 vertex(int x, int z) const
+    {
+        return Vector3(originX + x * cellSize, sample(x, z), originZ + z * cellSize);
+    }
+
+    // Cell containing (x, z); false outside the terrain
+    bool cellAt(float x, float z, int& cx, int& cz) const
+    {
+        float fx = (x - originX) * inverseCellSize;
+        float fz = (z - originZ) * inverseCellSize;
+        if (fx < 0.0f || fz < 0.0f || fx >= columns - 1 || fz >= rows - 1)
+            return false;
+        cx = (int)fx;
+        cz = (int)fz;
+        return true;
+    }
+
+    // Cell index range overlapping [minX, maxX] x [minZ, maxZ], clamped to the terrain.
+    // Returns false when the range misses the terrain entirely.
+    bool cellRange(float minX, float minZ, float maxX, float maxZ, int& x0, int& z0, int& x1,
+                   int& z1) const
+    {
+        x0 = (int)std::floor((minX - originX) * inverseCellSize);
+        z0 = (int)std::floor((minZ - originZ) * inverseCellSize);
+        x1 = (int)std::floor((maxX - originX) * inverseCellSize);
+        z1 = (int)std::floor((maxZ - originZ) * inverseCellSize);
+        if (x1 < 0 || z1 < 0 || x0 >= columns - 1 || z0 >= rows - 1)
+            return false;
+        x0 = std::max(x0, 0);
+        z0 = std::max(z0, 0);
+        x1 = std::min(x1, columns - 2);
+        z1 = std::min(z1, rows - 2);
+        return true;
+    }
+
+    // One of the two triangles of a cell, counter-clockwise seen from above
+    void triangle(int cx, int cz, int half, Vector3 out[3]) const
+    {
+        if (half == 0)
+        {
+            out[0] = vertex(cx, cz);
+            out[1] = vertex(cx, cz + 1);
+            out[2] = vertex(cx + 1, cz + 1);
+        }
+        else
+        {
+            out[0] = vertex(cx, cz);
+            out[1] = vertex(cx + 1, cz + 1);
+            out[2] = vertex(cx + 1, cz);
+        }
+    }
+
+    // Surface height and upward normal under (x, z); false outside the terrain
+    bool surfaceAt(float x, float z, float& height, Vector3& normal) const
+    {
+        int cx, cz;
+        if (!cellAt(x, z, cx, cz))
+            return false;
+        float u = (x - originX) * inverseCellSize - cx;
+        float v = (z - originZ) * inverseCellSize - cz;
+        float h00 = sample(cx, cz);
+        float h11 = sample(cx + 1, cz + 1);
+        if (v >= u)
+        {
+            // Triangle (0,0) (0,1) (1,1)
+            float h01 = sample(cx, cz + 1);
+            height = h00 + (h11 - h01) * u + (h01 - h00) * v;
+            normal = Vector3(-(h11 - h01) * inverseCellSize, 1.0f, -(h01 - h00) * inverseCellSize);
+        }
+        else
+        {
+            // Triangle (0,0) (1,1) (1,0)
+            float h10 = sample(cx + 1, cz);
+            height = h00 + (h10 - h00) * u + (h11 - h10) * v;
+            normal = Vector3(-(h10 - h00) * inverseCellSize, 1.0f, -(h11 - h10) * inverseCellSize);
+        }
+        normal.normalize();
+        return true;
+    }
+
+private:
+    int columns;
+    int rows;
+    float cellSize;
+    float inverseCellSize;
+    float originX;
+    float originZ;
+    Format format;
+    float minHeight = 0.0f;
+    float maxHeight = 0.0f;
+    float scale = 1.0f;
+    std::vector<float> samples;
+    std::vector<int16_t> quantized;
+};
@@ -1,10 +1,49 @@
 #pragma once
 #include "Shape.h"
+#include <algorithm>
 
+// Square pyramid standing on the local y axis. The body origin is its centre of mass, a
+// quarter of the height above the base, so the base sits at y = -height / 4 and the apex
+// at y = 3 * height / 4.
 class Pyramid : public Shape {
 public:
+    static const int VERTEX_COUNT = 5;
+    static const int FACE_COUNT = 5;
+
     float halfWidth;
     float height;
+    // Base corners then the apex, and outward face planes (normal . p <= offset inside)
+    Vector3 vertices[VERTEX_COUNT];
+    Vector3 faceNormals[FACE_COUNT];
+    float faceOffsets[FACE_COUNT];
+
+    Pyramid(float w, float h) : Shape(PYRAMID), halfWidth(w / 2.0f), height(h)
+    {
+        float base = -0.25f * h;
+        float apex = 0.75f * h;
+        for (int i = 0; i < 4; i++)
+        {
+            vertices[i] = Vector3((i & 1) ? -halfWidth : halfWidth, base,
+                                  (i & 2) ? -halfWidth : halfWidth);
+        }
+        vertices[4] = Vector3(0, apex, 0);
+
+        faceNormals[0] = Vector3(0, -1, 0);
+        faceOffsets[0] = -base;
+        float len = std::sqrt(h * h + halfWidth * halfWidth);
+        float side = h / len;
+        float up = halfWidth / len;
+        faceNormals[1] = Vector3(side, up, 0);
+        faceNormals[2] = Vector3(-side, up, 0);
+        faceNormals[3] = Vector3(0, up, side);
+        faceNormals[4] = Vector3(0, up, -side);
+        for (int i = 1; i < FACE_COUNT; i++)
+            faceOffsets[i] = up * apex;
 
-    Pyramid(float w, float h) : Shape(PYRAMID), halfWidth(w / 2.0f), height(h) {}
-};
\ No newline at end of file
+        // About the centre of mass
+        float iy = (1.0f / 10.0f) * w * w;
+        float ixz = (1.0f / 20.0f) * w * w + (3.0f / 80.0f) * h * h;
+        unitInertia = Vector3(ixz, iy, ixz);
+        boundingRadius = std::max(apex, std::sqrt(2.0f * halfWidth * halfWidth + base * base));
+    }
+};
@@ -1,17 +1,31 @@
 #pragma once
+#include "../core/Vector3.h"
+#include <cstdint>
 
 enum ShapeType {
     SPHERE,
     BOX,
     PLANE,
     CYLINDER,
-    PYRAMID
+    PYRAMID,
+    MESH,
+    COMPOUND,
+    CAPSULE,
+    HULL
 };
 
+// Immutable shape definition shared by every body that uses it. Shapes are interned
+// by ShapeRegistry, so anything derived from the dimensions is computed once here
+// instead of per body or per collision test.
 class Shape {
 public:
     ShapeType type;
+    // Registry index
+    uint32_t id = 0;
+    // Diagonal of the local inertia tensor for a unit mass
+    Vector3 unitInertia;
+    // Radius of the bounding sphere around the body origin
+    float boundingRadius = 0.0f;
 
     Shape(ShapeType t) : type(t) {}
-    virtual ~Shape() {}
-};
\ No newline at end of file
+};
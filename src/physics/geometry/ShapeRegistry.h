@@ -0,0 +1,216 @@
+#pragma once
+#include "../core/Pool.h"
+#include "Box.h"
+#include "Capsule.h"
+#include "Compound.h"
+#include "ConvexHull.h"
+#include "Cylinder.h"
+#include "Pyramid.h"
+#include "Sphere.h"
+#include "TriangleMesh.h"
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Interns shape definitions so every body with the same dimensions shares one
+// immutable Shape. Definitions are reference counted by the bodies using them and live
+// in per-type pools; a released definition's memory and registry index are recycled.
+class ShapeRegistry
+{
+public:
+    ShapeRegistry() = default;
+    ShapeRegistry(const ShapeRegistry&) = delete;
+    ShapeRegistry& operator=(const ShapeRegistry&) = delete;
+
+    ~ShapeRegistry() { clear(); }
+
+    const Shape* sphere(float radius)
+    {
+        return intern(Key{SPHERE, bits(radius), 0, 0}, [&] { return spheres.create(radius); });
+    }
+
+    const Shape* box(float w, float h, float d)
+    {
+        return intern(Key{BOX, bits(w), bits(h), bits(d)}, [&] { return boxes.create(w, h, d); });
+    }
+
+    const Shape* cylinder(float radius, float height)
+    {
+        return intern(Key{CYLINDER, bits(radius), bits(height), 0},
+                      [&] { return cylinders.create(radius, height); });
+    }
+
+    const Shape* capsule(float radius, float length)
+    {
+        return intern(Key{CAPSULE, bits(radius), bits(length), 0},
+                      [&] { return capsules.create(radius, length); });
+    }
+
+    const Shape* pyramid(float w, float h)
+    {
+        return intern(Key{PYRAMID, bits(w), bits(h), 0}, [&] { return pyramids.create(w, h); });
+    }
+
+    // Meshes are not interned by content: every call registers a new definition, which
+    // bodies share through retain()
+    template <typename... Args>
+    const Shape* mesh(Args&&... args)
+    {
+        return intern(Key{MESH, nextUniqueKey++, 0, 0},
+                      [&] { return meshes.create(std::forward<Args>(args)...); });
+    }
+
+    // Compounds are not interned either. The compound takes over the caller's reference to
+    // each child shape and releases them when it is freed.
+    const Shape* compound(const Compound::Child* children, int count)
+    {
+        return intern(Key{COMPOUND, nextUniqueKey++, 0, 0},
+                      [&] { return compounds.create(children, count); });
+    }
+
+    // Hulls are not interned by content either. Check isValid() on the result; an invalid
+    // hull should be released straight away.
+    const Shape* hull(const float* points, int count)
+    {
+        return intern(Key{HULL, nextUniqueKey++, 0, 0},
+                      [&] { return hulls.create(points, count); });
+    }
+
+    // Takes one more reference to a shape that is already registered
+    void retain(const Shape* shape) { entries[shape->id].refs++; }
+
+    // Drops one reference; the definition is freed when no body uses it any more
+    void release(const Shape* shape)
+    {
+        Entry& e = entries[shape->id];
+        if (--e.refs > 0)
+            return;
+        lookup.erase(e.key);
+        freeIds.push_back(shape->id);
+        Shape* dead = e.shape;
+        e.shape = nullptr;
+        if (dead->type == COMPOUND)
+        {
+            for (const Compound::Child& child : ((Compound*)dead)->getChildren())
+                release(child.shape);
+        }
+        destroy(dead);
+    }
+
+    const Shape* get(uint32_t id) const { return id < entries.size() ? entries[id].shape : nullptr; }
+
+    size_t size() const { return lookup.size(); }
+
+    void clear()
+    {
+        for (Entry& e : entries)
+        {
+            if (e.shape)
+                destroy(e.shape);
+        }
+        entries.clear();
+        freeIds.clear();
+        lookup.clear();
+    }
+
+private:
+    struct Key
+    {
+        ShapeType type;
+        uint32_t a, b, c;
+
+        bool operator==(const Key& o) const
+        {
+            return type == o.type && a == o.a && b == o.b && c == o.c;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const
+        {
+            size_t h = (size_t)k.type;
+            h = h * 0x9E3779B1u ^ k.a;
+            h = h * 0x9E3779B1u ^ k.b;
+            h = h * 0x9E3779B1u ^ k.c;
+            return h;
+        }
+    };
+
+    struct Entry
+    {
+        Shape* shape;
+        uint32_t refs;
+        Key key;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeIds;
+    std::unordered_map<Key, uint32_t, KeyHash> lookup;
+
+    Pool<Sphere> spheres;
+    Pool<Box> boxes;
+    Pool<Cylinder> cylinders;
+    Pool<Pyramid> pyramids;
+    Pool<Capsule> capsules;
+    Pool<TriangleMesh, 16> meshes;
+    Pool<Compound, 64> compounds;
+    Pool<ConvexHull, 64> hulls;
+    // Key for definitions that are never shared by content
+    uint32_t nextUniqueKey = 0;
+
+    static uint32_t bits(float f)
+    {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    template <typename Create>
+    const Shape* intern(const Key& key, Create create)
+    {
+        auto it = lookup.find(key);
+        if (it != lookup.end())
+        {
+            entries[it->second].refs++;
+            return entries[it->second].shape;
+        }
+
+        Shape* shape = create();
+        uint32_t id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+            entries[id] = Entry{shape, 1, key};
+        }
+        else
+        {
+            id = (uint32_t)entries.size();
+            entries.push_back(Entry{shape, 1, key});
+        }
+        shape->id = id;
+        lookup.emplace(key, id);
+        return shape;
+    }
+
+    void destroy(Shape* shape)
+    {
+        if (shape->type == SPHERE)
+            spheres.destroy((Sphere*)shape);
+        else if (shape->type == BOX)
+            boxes.destroy((Box*)shape);
+        else if (shape->type == CYLINDER)
+            cylinders.destroy((Cylinder*)shape);
+        else if (shape->type == PYRAMID)
+            pyramids.destroy((Pyramid*)shape);
+        else if (shape->type == CAPSULE)
+            capsules.destroy((Capsule*)shape);
+        else if (shape->type == MESH)
+            meshes.destroy((TriangleMesh*)shape);
+        else if (shape->type == COMPOUND)
+            compounds.destroy((Compound*)shape);
+        else if (shape->type == HULL)
+            hulls.destroy((ConvexHull*)shape);
+    }
+};
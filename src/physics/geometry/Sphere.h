@@ -5,5 +5,10 @@ class Sphere : public Shape {
 public:
     float radius;
 
-    Sphere(float r) : Shape(SPHERE), radius(r) {}
-};
\ No newline at end of file
+    Sphere(float r) : Shape(SPHERE), radius(r)
+    {
+        float coeff = 0.4f * r * r;
+        unitInertia = Vector3(coeff, coeff, coeff);
+        boundingRadius = r;
+    }
+};
@@ -0,0 +1,431 @@
+#pragma once
+#include "../core/AABB.h"
+#include "Shape.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Static triangle soup with a bounding volume hierarchy, for level geometry.
+//
+// Everything lives in one flat blob that doubles as the serialized form:
+//
+//   Header | nodes[nodeCount] | vertices[vertexCount * 3] | indices[triangleCount * 3]
+//
+// Node bounds are quantized to 16 bits per axis relative to the mesh bounds (rounded
+// outwards, so they stay conservative) and nodes are stored depth-first: a node's left
+// child is the next node and internal nodes store the index just past their subtree, so
+// traversal is a forward walk without a stack. Triangles are reordered at build time so
+// each leaf covers a contiguous run. A blob saved with data()/size() is loaded by
+// pointing at it: no parsing or rebuild, just a header check.
+class TriangleMesh : public Shape
+{
+public:
+    static const uint32_t MAGIC = 0x4853454D; // "MESH"
+    static const uint32_t VERSION = 1;
+    static const uint32_t LEAF_SIZE = 4;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexCount;
+        uint32_t triangleCount;
+        uint32_t nodeCount;
+        uint32_t reserved;
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    struct Node
+    {
+        uint16_t min[3];
+        uint16_t max[3];
+        // Leaf: LEAF_BIT | count << 24 | first triangle. Internal: index past the subtree.
+        uint32_t data;
+    };
+
+    static_assert(sizeof(Header) == 48, "Header layout is part of the file format");
+    static_assert(sizeof(Node) == 16, "Node layout is part of the file format");
+
+    // Builds the hierarchy from packed xyz vertices and three indices per triangle
+    TriangleMesh(const float* vertices, uint32_t vertexCount, const uint32_t* indices,
+                 uint32_t triangleCount)
+        : Shape(MESH)
+    {
+        build(vertices, vertexCount, indices, triangleCount);
+        attach(storage.data());
+    }
+
+    // Takes ownership of a serialized blob; check it with validate() first
+    explicit TriangleMesh(std::vector<uint8_t>&& blob) : Shape(MESH), storage(std::move(blob))
+    {
+        attach(storage.data());
+    }
+
+    // Uses a serialized blob in place (e.g. a mapped file); it must outlive the mesh. The
+    // size is only for validate(), which the caller has already run.
+    TriangleMesh(const uint8_t* blob, size_t size) : Shape(MESH)
+    {
+        (void)size;
+        attach(blob);
+    }
+
+    // Whether size bytes at blob hold a complete, well-formed mesh of the current version
+    static bool validate(const uint8_t* blob, size_t size)
+    {
+        if (size < sizeof(Header) || ((uintptr_t)blob & 3) != 0)
+            return false;
+        Header h;
+        std::memcpy(&h, blob, sizeof(h));
+        if (h.magic != MAGIC || h.version != VERSION || h.nodeCount == 0 ||
+            h.triangleCount >= (1u << 24))
+            return false;
+        if (size != blobSize(h.vertexCount, h.triangleCount, h.nodeCount))
+            return false;
+
+        // Every index and link must stay inside the blob; one linear pass
+        const Node* n = (const Node*)(blob + sizeof(Header));
+        for (uint32_t i = 0; i < h.nodeCount; i++)
+        {
+            uint32_t d = n[i].data;
+            if (d & LEAF_BIT)
+            {
+                if ((d & FIRST_MASK) + ((d >> COUNT_SHIFT) & COUNT_MASK) > h.triangleCount)
+                    return false;
+            }
+            else if (d <= i + 1 || d > h.nodeCount)
+            {
+                return false;
+            }
+        }
+        const uint32_t* idx =
+            (const uint32_t*)((const float*)(n + h.nodeCount) + (size_t)h.vertexCount * 3);
+        for (size_t i = 0; i < (size_t)h.triangleCount * 3; i++)
+        {
+            if (idx[i] >= h.vertexCount)
+                return false;
+        }
+        return true;
+    }
+
+    const uint8_t* data() const { return blob; }
+    size_t size() const
+    {
+        return blobSize(header->vertexCount, header->triangleCount, header->nodeCount);
+    }
+
+    uint32_t getTriangleCount() const { return header->triangleCount; }
+    uint32_t getNodeCount() const { return header->nodeCount; }
+    const AABB& getBounds() const { return bounds; }
+
+    void triangle(uint32_t t, Vector3 out[3]) const
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const float* v = &vertices[indices[t * 3 + k] * 3];
+            out[k] = Vector3(v[0], v[1], v[2]);
+        }
+    }
+
+    // Calls visit(triangle) for every triangle whose leaf overlaps box (mesh space)
+    template <typename Visit>
+    void query(const AABB& box, Visit visit) const
+    {
+        if (!box.overlaps(bounds))
+            return;
+        uint16_t qmin[3], qmax[3];
+        const float lo[3] = {box.min.x, box.min.y, box.min.z};
+        const float hi[3] = {box.max.x, box.max.y, box.max.z};
+        for (int a = 0; a < 3; a++)
+        {
+            qmin[a] = quantize(lo[a], a, false);
+            qmax[a] = quantize(hi[a], a, true);
+        }
+
+        uint32_t i = 0;
+        while (i < header->nodeCount)
+        {
+            const Node& n = nodes[i];
+            bool hit = n.min[0] <= qmax[0] && n.max[0] >= qmin[0] && n.min[1] <= qmax[1] &&
+                       n.max[1] >= qmin[1] && n.min[2] <= qmax[2] && n.max[2] >= qmin[2];
+            if (n.data & LEAF_BIT)
+            {
+                if (hit)
+                {
+                    uint32_t first = n.data & FIRST_MASK;
+                    uint32_t count = (n.data >> COUNT_SHIFT) & COUNT_MASK;
+                    for (uint32_t t = first; t < first + count; t++)
+                        visit(t);
+                }
+                i++;
+            }
+            else
+            {
+                i = hit ? i + 1 : n.data;
+            }
+        }
+    }
+
+    // Closest two-sided triangle hit along a ray in mesh space; dir must be normalized.
+    // The normal faces the ray origin.
+    bool raycast(const Vector3& origin, const Vector3& dir, float maxT, float& t,
+                 Vector3& normal) const
+    {
+        Vector3 invDir = AABB::inverseDirection(dir);
+        float best = maxT;
+        bool found = false;
+        uint32_t i = 0;
+        while (i < header->nodeCount)
+        {
+            const Node& n = nodes[i];
+            float entry = nodeBounds(n).raycast(origin, invDir, best);
+            bool hit = entry >= 0.0f;
+            if (n.data & LEAF_BIT)
+            {
+                if (hit)
+                {
+                    uint32_t first = n.data & FIRST_MASK;
+                    uint32_t count = (n.data >> COUNT_SHIFT) & COUNT_MASK;
+                    for (uint32_t k = first; k < first + count; k++)
+                    {
+                        Vector3 tri[3];
+                        triangle(k, tri);
+                        float tk;
+                        if (rayTriangle(origin, dir, tri, best, tk))
+                        {
+                            best = tk;
+                            normal = (tri[1] - tri[0]).cross(tri[2] - tri[0]);
+                            found = true;
+                        }
+                    }
+                }
+                i++;
+            }
+            else
+            {
+                i = hit ? i + 1 : n.data;
+            }
+        }
+        if (!found)
+            return false;
+        normal.normalize();
+        if (normal.dot(dir) > 0.0f)
+            normal.invert();
+        t = best;
+        return true;
+    }
+
+private:
+    static const uint32_t LEAF_BIT = 1u << 31;
+    static const uint32_t COUNT_SHIFT = 24;
+    static const uint32_t COUNT_MASK = 0x7F;
+    static const uint32_t FIRST_MASK = (1u << 24) - 1;
+
+    std::vector<uint8_t> storage; // empty when the blob is borrowed
+    const uint8_t* blob = nullptr;
+    const Header* header = nullptr;
+    const Node* nodes = nullptr;
+    const float* vertices = nullptr;
+    const uint32_t* indices = nullptr;
+    AABB bounds;
+    float quantScale[3];   // mesh units to quantized units
+    float dequantScale[3]; // and back
+
+    static size_t blobSize(uint32_t vertexCount, uint32_t triangleCount, uint32_t nodeCount)
+    {
+        return sizeof(Header) + (size_t)nodeCount * sizeof(Node) +
+               (size_t)vertexCount * 3 * sizeof(float) +
+               (size_t)triangleCount * 3 * sizeof(uint32_t);
+    }
+
+    void attach(const uint8_t* data)
+    {
+        blob = data;
+        header = (const Header*)data;
+        nodes = (const Node*)(data + sizeof(Header));
+        vertices = (const float*)(nodes + header->nodeCount);
+        indices = (const uint32_t*)(vertices + (size_t)header->vertexCount * 3);
+
+        bounds = AABB(Vector3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]),
+                      Vector3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]));
+        for (int a = 0; a < 3; a++)
+        {
+            float extent = header->boundsMax[a] - header->boundsMin[a];
+            quantScale[a] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+            dequantScale[a] = extent / 65535.0f;
+        }
+
+        // Static only: no inertia. The bounding sphere is taken around the body origin.
+        unitInertia = Vector3(0, 0, 0);
+        float r2 = 0.0f;
+        for (uint32_t v = 0; v < header->vertexCount; v++)
+        {
+            const float* p = &vertices[v * 3];
+            r2 = std::max(r2, p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        }
+        boundingRadius = std::sqrt(r2);
+    }
+
+    uint16_t quantize(float value, int axis, bool roundUp) const
+    {
+        float q = (value - header->boundsMin[axis]) * quantScale[axis];
+        q = roundUp ? std::ceil(q) : std::floor(q);
+        return (uint16_t)std::max(0.0f, std::min(q, 65535.0f));
+    }
+
+    AABB nodeBounds(const Node& n) const
+    {
+        const float* o = header->boundsMin;
+        return AABB(Vector3(o[0] + n.min[0] * dequantScale[0], o[1] + n.min[1] * dequantScale[1],
+                            o[2] + n.min[2] * dequantScale[2]),
+                    Vector3(o[0] + n.max[0] * dequantScale[0], o[1] + n.max[1] * dequantScale[1],
+                            o[2] + n.max[2] * dequantScale[2]));
+    }
+
+    // Moller-Trumbore, both sides
+    static bool rayTriangle(const Vector3& o, const Vector3& d, const Vector3 tri[3],
+                            float maxT, float& t)
+    {
+        Vector3 e1 = tri[1] - tri[0];
+        Vector3 e2 = tri[2] - tri[0];
+        Vector3 p = d.cross(e2);
+        float det = e1.dot(p);
+        if (std::abs(det) < 1e-12f)
+            return false;
+        float inv = 1.0f / det;
+        Vector3 s = o - tri[0];
+        float u = s.dot(p) * inv;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        Vector3 q = s.cross(e1);
+        float v = d.dot(q) * inv;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        t = e2.dot(q) * inv;
+        return t >= 0.0f && t < maxT;
+    }
+
+    struct BuildRef
+    {
+        AABB box;
+        Vector3 centroid;
+        uint32_t triangle;
+    };
+
+    struct BuildNode
+    {
+        AABB box;
+        uint32_t data;
+    };
+
+    // Top-down median split on the longest centroid axis, emitting nodes depth-first
+    void build(const float* vertexData, uint32_t vertexCount, const uint32_t* indexData,
+               uint32_t triangleCount)
+    {
+        std::vector<BuildRef> refs;
+        refs.reserve(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            const uint32_t* tri = &indexData[t * 3];
+            if (tri[0] >= vertexCount || tri[1] >= vertexCount || tri[2] >= vertexCount)
+                continue;
+            Vector3 p[3];
+            for (int k = 0; k < 3; k++)
+                p[k] = Vector3(vertexData[tri[k] * 3], vertexData[tri[k] * 3 + 1],
+                               vertexData[tri[k] * 3 + 2]);
+            AABB box(p[0], p[0]);
+            box = box.merged(AABB(p[1], p[1])).merged(AABB(p[2], p[2]));
+            refs.push_back(BuildRef{box, box.center(), t});
+        }
+        // At most 2^24 triangles fit the leaf encoding
+        if (refs.size() >= (1u << 24))
+            refs.resize((1u << 24) - 1);
+
+        std::vector<BuildNode> built;
+        built.reserve(refs.size() / 2 + 1);
+        if (refs.empty())
+            built.push_back(BuildNode{AABB(), LEAF_BIT});
+        else
+            buildRange(refs, 0, (uint32_t)refs.size(), built);
+
+        uint32_t count = (uint32_t)refs.size();
+        storage.assign(blobSize(vertexCount, count, (uint32_t)built.size()), 0);
+        Header h = {};
+        h.magic = MAGIC;
+        h.version = VERSION;
+        h.vertexCount = vertexCount;
+        h.triangleCount = count;
+        h.nodeCount = (uint32_t)built.size();
+        AABB all = built[0].box;
+        const float lo[3] = {all.min.x, all.min.y, all.min.z};
+        const float hi[3] = {all.max.x, all.max.y, all.max.z};
+        std::memcpy(h.boundsMin, lo, sizeof(lo));
+        std::memcpy(h.boundsMax, hi, sizeof(hi));
+        std::memcpy(storage.data(), &h, sizeof(h));
+
+        // Quantize against the header written above
+        header = (const Header*)storage.data();
+        for (int a = 0; a < 3; a++)
+        {
+            float extent = hi[a] - lo[a];
+            quantScale[a] = extent > 0.0f ? 65535.0f / extent : 0.0f;
+        }
+        Node* outNodes = (Node*)(storage.data() + sizeof(Header));
+        for (size_t i = 0; i < built.size(); i++)
+        {
+            const AABB& b = built[i].box;
+            const float bmin[3] = {b.min.x, b.min.y, b.min.z};
+            const float bmax[3] = {b.max.x, b.max.y, b.max.z};
+            for (int a = 0; a < 3; a++)
+            {
+                outNodes[i].min[a] = quantize(bmin[a], a, false);
+                outNodes[i].max[a] = quantize(bmax[a], a, true);
+            }
+            outNodes[i].data = built[i].data;
+        }
+
+        float* outVertices = (float*)(outNodes + built.size());
+        std::memcpy(outVertices, vertexData, (size_t)vertexCount * 3 * sizeof(float));
+        uint32_t* outIndices = (uint32_t*)(outVertices + (size_t)vertexCount * 3);
+        for (uint32_t i = 0; i < count; i++)
+            std::memcpy(&outIndices[i * 3], &indexData[refs[i].triangle * 3],
+                        3 * sizeof(uint32_t));
+    }
+
+    void buildRange(std::vector<BuildRef>& refs, uint32_t begin, uint32_t end,
+                    std::vector<BuildNode>& built)
+    {
+        AABB box = refs[begin].box;
+        AABB centroids(refs[begin].centroid, refs[begin].centroid);
+        for (uint32_t i = begin + 1; i < end; i++)
+        {
+            box = box.merged(refs[i].box);
+            centroids = centroids.merged(AABB(refs[i].centroid, refs[i].centroid));
+        }
+
+        size_t index = built.size();
+        built.push_back(BuildNode{box, 0});
+        uint32_t count = end - begin;
+        if (count <= LEAF_SIZE)
+        {
+            built[index].data = LEAF_BIT | (count << COUNT_SHIFT) | begin;
+            return;
+        }
+
+        Vector3 extent = centroids.max - centroids.min;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                   : extent.y >= extent.z                     ? 1
+                                                              : 2;
+        auto key = [axis](const BuildRef& r)
+        { return axis == 0 ? r.centroid.x : (axis == 1 ? r.centroid.y : r.centroid.z); };
+        uint32_t mid = begin + count / 2;
+        std::nth_element(refs.begin() + begin, refs.begin() + mid, refs.begin() + end,
+                         [&](const BuildRef& a, const BuildRef& b) { return key(a) < key(b); });
+
+        buildRange(refs, begin, mid, built);
+        buildRange(refs, mid, end, built);
+        built[index].data = (uint32_t)built.size();
+    }
+};
@@ -8,6 +8,98 @@ export interface BodyData {
   rot: { w: number; x: number; y: number; z: number };
 }
 
+export interface RayHit {
+  handle: number;
+  distance: number;
+  point: Vector3;
+  normal: Vector3;
+}
+
+export const StepDegradation = {
+  Iterations: 1 << 0,
+  Substeps: 1 << 1,
+  SleepCheck: 1 << 2,
+  SpatialSort: 1 << 3,
+} as const;
+export type StepDegradation = (typeof StepDegradation)[keyof typeof StepDegradation];
+
+export const StepPhase = {
+  Setup: 0,
+  Integrate: 1,
+  Floor: 2,
+  Constraints: 3,
+  Broadphase: 4,
+  Narrowphase: 5,
+  Particles: 6,
+  Sensors: 7,
+} as const;
+export type StepPhase = (typeof StepPhase)[keyof typeof StepPhase];
+
+export const SolverStat = {
+  ContactIterations: 0,
+  ContactError: 1, // m/s
+  ContactImpulse: 2, // N s
+  ConstraintIterations: 3,
+  ConstraintError: 4, // m
+  ConstraintImpulse: 5, // N s
+} as const;
+export type SolverStat = (typeof SolverStat)[keyof typeof SolverStat];
+
+export const CONTACT_EVENT_STRIDE = 10;
+export const ContactEventType = {
+  Begin: 0,
+  Persist: 1,
+  End: 2,
+} as const;
+export type ContactEventType = (typeof ContactEventType)[keyof typeof ContactEventType];
+
+export const SENSOR_EVENT_STRIDE = 3;
+export const SensorEventType = {
+  Enter: 0,
+  Exit: 1,
+} as const;
+export type SensorEventType = (typeof SensorEventType)[keyof typeof SensorEventType];
+
+export const DebugDrawFlag = {
+  Contacts: 1 << 0,
+  Aabbs: 1 << 1,
+  Constraints: 1 << 2,
+  Sleep: 1 << 3,
+  Islands: 1 << 4,
+} as const;
+export type DebugDrawFlag = (typeof DebugDrawFlag)[keyof typeof DebugDrawFlag];
+
+// Debug vertices: DEBUG_VERTEX_STRIDE floats each, [x, y, z, r, g, b]
+export const DEBUG_VERTEX_STRIDE = 6;
+
+// Command ring records: COMMAND_STRIDE words each, [type, handle, x, y, z] with type and
+// handle as uint32 and x, y, z as float32
+export const COMMAND_HEADER_WORDS = 4;
+export const COMMAND_STRIDE = 5;
+export const BodyCommandType = {
+  Force: 0, // x, y, z
+  Impulse: 1, // x, y, z
+  Torque: 2, // x, y, z
+  Velocity: 3, // x, y, z
+  AngularVelocity: 4, // x, y, z
+  Friction: 5, // x
+  Restitution: 6, // x
+  Wake: 7,
+  Sleep: 8,
+} as const;
+export type BodyCommandType = (typeof BodyCommandType)[keyof typeof BodyCommandType];
+
+// Compound children: COMPOUND_CHILD_STRIDE floats each,
+// [type, a, b, c, offsetX, offsetY, offsetZ, qw, qx, qy, qz]
+export const COMPOUND_CHILD_STRIDE = 11;
+export const CompoundChildType = {
+  Sphere: 0, // a = radius
+  Box: 1, // a, b, c = width, height, depth
+  Cylinder: 3, // a = radius, b = height
+  Capsule: 7, // a = radius, b = length
+} as const;
+export type CompoundChildType = (typeof CompoundChildType)[keyof typeof CompoundChildType];
+
 export interface PhysicsWorldInstance {
   addSphere(
     x: number,
@@ -15,7 +107,7 @@ export interface PhysicsWorldInstance {
     z: number,
     radius: number,
     mass: number,
-  ): void;
+  ): number;
   addBox(
     x: number,
     y: number,
@@ -24,7 +116,7 @@ export interface PhysicsWorldInstance {
     h: number,
     d: number,
     mass: number,
-  ): void;
+  ): number;
   addCylinder(
     x: number,
     y: number,
@@ -32,8 +124,129 @@ export interface PhysicsWorldInstance {
     radius: number,
     height: number,
     mass: number,
-  ): void;
+  ): number;
+  // length: distance between the cap centres (three.js CapsuleGeometry)
+  addCapsule(
+    x: number,
+    y: number,
+    z: number,
+    radius: number,
+    length: number,
+    mass: number,
+  ): number;
+  // The body's position is the centre of mass, height / 4 above the base
+  addPyramid(
+    x: number,
+    y: number,
+    z: number,
+    width: number,
+    height: number,
+    mass: number,
+  ): number;
   step(dt: number): void;
+  // budgetUs: soft time limit in microseconds (0 = none)
+  stepWithBudget(dt: number, budgetUs: number): void;
+  // Far bodies step every 2nd/4th/8th frame based on distance to the focus points
+  setRateTiersEnabled(enabled: boolean): void;
+  setRateTierDistances(near: number, mid: number, far: number): void;
+  // Packed [x, y, z] triples
+  setRateFocus(points: Float32Array): void;
+  // 0-3, or -1 for distance-based
+  setBodyRateTier(handle: number, tier: number): void;
+  getBodyRateTier(handle: number): number;
+  // Granular particles (one radius and mass for all), stepped after the bodies. About
+  // 30k grains step in real time at 60 Hz on one core (2 iterations); 100k take 30-60 ms
+  // per step natively, and longer in WASM.
+  setParticleProperties(radius: number, mass: number, friction: number): void;
+  // 0 none, 1 bodies push particles, 2 both ways
+  setParticleCoupling(mode: number): void;
+  setParticleIterations(iterations: number): void;
+  addParticle(
+    x: number,
+    y: number,
+    z: number,
+    vx: number,
+    vy: number,
+    vz: number,
+  ): void;
+  // nx * ny * nz grains on a lattice; keep the total near 30k for 60 Hz
+  addParticleBlock(
+    x: number,
+    y: number,
+    z: number,
+    nx: number,
+    ny: number,
+    nz: number,
+    spacing: number,
+  ): void;
+  clearParticles(): void;
+  getParticleCount(): number;
+  // Interleaved xyz, valid until the next step; order changes between steps
+  getParticlePositions(): Float32Array;
+  // One body from several primitives; returns a body handle, or 0 on bad input
+  addCompound(
+    x: number,
+    y: number,
+    z: number,
+    children: Float32Array,
+    mass: number,
+  ): number;
+  // Centre of mass relative to (x, y, z) of addCompound; the body's position is there
+  getCompoundCenter(handle: number): Vector3 | null;
+  // Convex hull of packed xyz points (at most 64 hull vertices); returns a body handle,
+  // or 0 for flat or oversized point sets
+  addConvexHull(
+    x: number,
+    y: number,
+    z: number,
+    points: Float32Array,
+    mass: number,
+  ): number;
+  // Centre of mass relative to (x, y, z) of addConvexHull; the body's position is there
+  getConvexHullCenter(handle: number): Vector3 | null;
+  // Static level geometry; all return a body handle, or 0 on bad input. Triangles are
+  // two-sided, so their winding does not matter.
+  addMesh(
+    x: number,
+    y: number,
+    z: number,
+    vertices: Float32Array,
+    indices: Uint32Array,
+  ): number;
+  // Blob from getMeshBlob (e.g. fetched as an ArrayBuffer); loaded without a rebuild
+  addMeshBlob(x: number, y: number, z: number, blob: Uint8Array): number;
+  addMeshInstance(meshHandle: number, x: number, y: number, z: number): number;
+  getMeshBlob(handle: number): Uint8Array | null;
+  // Appends a scene file from saveScene (e.g. a fetched level) and takes over its gravity.
+  // Bodies keep their saved sleep state and follow the existing ones in dense order.
+  // Returns the number of bodies added, or -1 for a corrupt or incompatible file.
+  loadScene(bytes: Uint8Array): number;
+  // Every body and constraint as a scene file; valid until the next saveScene
+  saveScene(): Uint8Array;
+  // Replaces the y = 0 floor; heights are row-major with x varying fastest.
+  // quantize stores samples as int16 (2 bytes each).
+  setHeightfield(
+    heights: Float32Array,
+    columns: number,
+    rows: number,
+    cellSize: number,
+    originX: number,
+    originZ: number,
+    quantize: boolean,
+  ): void;
+  clearHeightfield(): void;
+  getTerrainHeight(x: number, z: number): number;
+  getTerrainBytes(): number;
+  // StepDegradation bits applied by the last step
+  getStepDegradations(): number;
+  getStepTimeUs(): number;
+  getPhaseTimeUs(phase: StepPhase): number;
+  getPhaseTimes(): Float32Array;
+  getSolverStat(stat: SolverStat): number;
+  getSolverStats(): Float32Array;
+  setContactIterations(iterations: number): void;
+  setContactTolerances(velocity: number, impulse: number): void;
+  setConstraintImpulseTolerance(tolerance: number): void;
   getBodyPosition(index: number): BodyData | null;
   getBodyCount(): number;
   setGravity(g: number): void;
@@ -41,12 +254,134 @@ export interface PhysicsWorldInstance {
   setFriction(f: number): void;
   setVelocity(index: number, x: number, y: number, z: number): void;
   applyForce(index: number, x: number, y: number, z: number): void;
+  // Command ring shared with the engine (see CommandWriter): a [head, tail, capacity, 0]
+  // header, then capacity records of COMMAND_STRIDE words. Queued commands are applied at
+  // the start of the next step, or now through applyCommands.
+  getCommandRing(): Uint32Array;
+  applyCommands(): void;
+  getPendingCommandCount(): number;
+  getCommandCapacity(): number;
+  // Rounded up to a power of two; fetch the ring view again afterwards
+  setCommandCapacity(capacity: number): void;
   reset(): void;
+  removeBody(handle: number): boolean;
+  getBodyHandle(index: number): number;
+  getBodyIndex(handle: number): number;
+  // A pair collides when (categoryA & maskB) && (categoryB & maskA)
+  setCollisionFilter(handle: number, category: number, mask: number): void;
+  ignoreCollision(handleA: number, handleB: number): void;
+  restoreCollision(handleA: number, handleB: number): void;
+  setContactEventsEnabled(enabled: boolean): void;
+  setContactEventThresholds(beginImpulse: number, persistImpulse: number): void;
+  // CONTACT_EVENT_STRIDE floats per event: [type, handleA, handleB, px, py, pz, nx, ny, nz,
+  // impulse]. type and handles are uint32 bits; read them through a Uint32Array over the
+  // same buffer. Valid until the next step.
+  getContactEvents(): Float32Array;
+  getContactEventCount(): number;
+  // Sensors never collide; they report dynamic bodies entering and leaving them
+  setBodySensor(handle: number, sensor: boolean): void;
+  isBodySensor(handle: number): boolean;
+  // SENSOR_EVENT_STRIDE uint32 per event: [type, sensorHandle, bodyHandle]. Valid until
+  // the next step.
+  getSensorEvents(): Uint32Array;
+  getSensorEventCount(): number;
+  // Transform stream for remote viewers. Positions are quantized to positionBits (8-24)
+  // per axis inside the bound; changing it makes the next packets full frames.
+  setStreamBounds(
+    minX: number,
+    minY: number,
+    minZ: number,
+    maxX: number,
+    maxY: number,
+    maxZ: number,
+    positionBits: number,
+  ): void;
+  // Snapshots the transforms (usually once per step); returns the snapshot's sequence
+  captureTransforms(): number;
+  // Encodes the last snapshot against the newest sequence the viewer acknowledged (0 for
+  // a full frame); returns the packet size. Read it with getTransformPacket().
+  encodeTransforms(baseline: number): number;
+  // Valid until the next encodeTransforms
+  getTransformPacket(): Uint8Array;
+  // DebugDrawFlag bits; 0 turns debug drawing off
+  setDebugDrawFlags(flags: number): void;
+  getDebugDrawFlags(): number;
+  // The last step's debug geometry: getDebugLineVertexCount() line vertices (pairs), then
+  // getDebugPointCount() points. Valid until the next step.
+  getDebugVertices(): Float32Array;
+  getDebugLineVertexCount(): number;
+  getDebugPointCount(): number;
+  raycast?(
+    ox: number,
+    oy: number,
+    oz: number,
+    dx: number,
+    dy: number,
+    dz: number,
+    maxDistance: number,
+  ): RayHit | null;
+  // rays: [ox, oy, oz, dx, dy, dz, maxDistance] per ray. Result: 8 floats per ray,
+  // [handle, distance, px, py, pz, nx, ny, nz]; read the handle word through a Uint32Array
+  // (0 = miss). The view is only valid until the next call into the world.
+  raycastBatch?(rays: Float32Array): Float32Array;
+  overlapSphere?(x: number, y: number, z: number, radius: number): Uint32Array;
+  overlapBox?(
+    cx: number,
+    cy: number,
+    cz: number,
+    hx: number,
+    hy: number,
+    hz: number,
+  ): Uint32Array;
+  delete(): void;
+}
+
+// BODY_STATE_STRIDE floats per body in WorldBatch.getStates():
+// [px, py, pz, qw, qx, qy, qz, vx, vy, vz, wx, wy, wz]
+export const BODY_STATE_STRIDE = 13;
+
+// Independent copies of one seed world, stepped in parallel (physics-mt build) or in
+// turn (single-threaded build)
+export interface WorldBatchInstance {
+  // Build the scene to copy here. Owned by the batch: do not delete() it.
+  getSeed(): PhysicsWorldInstance;
+  // Replaces the batch with count copies of the seed
+  clone(count: number): void;
+  resetWorld(index: number): void;
+  // Owned by the batch like the seed; null when out of range
+  getWorld(index: number): PhysicsWorldInstance | null;
+  getWorldCount(): number;
+  getBodiesPerWorld(): number;
+  setThreadCount(threads: number): void;
+  getThreadCount(): number;
+  step(dt: number, frames: number): void;
+  // getWorldCount() blocks of getBodiesPerWorld() bodies, bodies in dense order. Valid
+  // until the next call.
+  getStates(): Float32Array;
+  delete(): void;
+}
+
+// TRANSFORM_STATE_STRIDE floats per body in TransformDecoder.getStates():
+// [handle, px, py, pz, qw, qx, qy, qz]; handle is uint32 bits
+export const TRANSFORM_STATE_STRIDE = 8;
+
+// Viewer side of the transform stream
+export interface TransformDecoderInstance {
+  // Returns the sequence to acknowledge to the sender, or 0 if the packet is malformed or
+  // refers to a baseline this decoder no longer holds
+  decode(packet: Uint8Array): number;
+  latest(): number;
+  getBodyCount(): number;
+  // Valid until the next decode
+  getStates(): Float32Array;
   delete(): void;
 }
 
 export interface PhysicsModule {
   PhysicsWorld: new () => PhysicsWorldInstance;
+  // threads counts the calling thread; 0 uses every core
+  WorldBatch: new (threads: number) => WorldBatchInstance;
+  TransformDecoder: new () => TransformDecoderInstance;
 }
 
 export type TextureType = "wood" | "metal" | "bricks" | "grid";